@@ -0,0 +1,66 @@
+/**
+ * OutputParserFuzzer.cpp
+ *
+ * libFuzzer target for the framing and parsing of the onedrive client's output.
+ *
+ * The input is treated as a stretch of the client's output. It is framed into lines with Process::takeLines() and each
+ * line is parsed with the grammar for every client release. The framer's guarantees are checked on the way, so a
+ * violation is reported as a crash.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <QtCore/QByteArray>
+#include <QtCore/QVersionNumber>
+#include "../src/OutputGrammar.h"
+#include "../src/Process.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    void parseLines(QByteArray & buffer, bool & discarding)
+    {
+        static const auto & grammar24 = OutputGrammar::forVersion({});
+        static const auto & grammar25 = OutputGrammar::forVersion(QVersionNumber(2, 5));
+
+        for (const auto & line : Process::takeLines(buffer, discarding)) {
+            if (Process::MaximumLineLength < line.size() || line.contains('\n')) {
+                std::abort();
+            }
+
+            static_cast<void>(grammar24.parse(line));
+            static_cast<void>(grammar25.parse(line));
+        }
+
+        if (Process::MaximumLineLength < buffer.size() || buffer.contains('\n')) {
+            std::abort();
+        }
+    }
+}
+
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t * data, std::size_t size)
+{
+    if (0 == size) {
+        return 0;
+    }
+
+    // the output arrives in reads that can split it anywhere, so the first byte chooses where to split the rest
+    const auto * text = reinterpret_cast<const char *>(data + 1);
+    const auto length = static_cast<int>(size - 1);
+    const auto split = (0 == length ? 0 : data[0] * length / 255);
+    QByteArray buffer;
+    bool discarding = false;
+
+    buffer.append(text, split);
+    parseLines(buffer, discarding);
+    buffer.append(text + split, length - split);
+    parseLines(buffer, discarding);
+
+    // the end of the output, as when the client exits
+    buffer.append('\n');
+    parseLines(buffer, discarding);
+    return 0;
+}
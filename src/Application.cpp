@@ -4,195 +4,107 @@
  * Implementation of Application class.
  */
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <QtCore/QDateTime>
 #include <QtCore/QLatin1String>
 #include <QtCore/QLocale>
-#include <QtCore/QCommandLineParser>
-#include <QtCore/QSettings>
-#include <QtCore/QLibraryInfo>
-#include <QtCore/QRegularExpression>
-#include <QtCore/QStandardPaths>
-#include <QtCore/QDir>
 #include <QtWidgets/QSystemTrayIcon>
 #include <QtWidgets/QMessageBox>
 #include <QtWidgets/QMenu>
 #include "Application.h"
+#include "Formatting.h"
+#include "Logger.h"
+#include "OneDriveConfig.h"
 #include "Process.h"
 #include "SettingsWidget.h"
+#include "Startup.h"
 
 using namespace OneDrive;
 
 namespace
 {
-    const QString DefaultOneDriveConfigFile = QStringLiteral("/onedrive/config");
-    const QString DefaultOneDrivePath = QStringLiteral("/usr/bin/onedrive");
-    const QStringList FixedOneDriveArguments = {"--verbose", "--monitor"};
     const QString DefaultIcon = QStringLiteral(":/tray-icon-mono");
 }
 
 
 Application::Application(int & argc, char ** argv)
         : QApplication(argc, argv),
-          m_oneDrivePath(),
-          m_oneDriveArguments(FixedOneDriveArguments),
-          m_oneDriveProcess(),
-          m_messagesWindow(m_oneDriveProcess),
+          m_service(),
+          m_messagesWindow(m_service.process(), m_service.eventBus()),
           m_trayIcon(QIcon(DefaultIcon)),
+          m_notificationFallback(m_trayIcon),
+          m_notifyTransfersAction(tr("&Notify about transfers")),
+          m_adaptiveMonitorIntervalAction(tr("&Adapt check interval to activity")),
           m_trayIconMenu(),
-          m_statusAction(tr("Not started")),
+          m_statusAction(m_service.status()),
           m_freeSpaceAction(tr("Free space: ")),
-          m_suspendAction(tr("&Suspend synchronization")),
+          m_latencyAction(),
+          m_localTotalsAction(),
+          m_errorsAction(),
+          m_throttlingAction(),
+          m_suspendAction(tr("&Stop synchronization")),
+          m_pauseAction(tr("&Pause synchronization")),
+          m_timedPauseAction(tr("Pause for 1 &hour")),
+          m_resumeAction(tr("Resu&me synchronization")),
           m_restartAction(tr("&Restart synchronization")),
-          m_settings(),
           m_qtTranslator(),
-          m_appTranslator()
+          m_appTranslator(),
+          m_debug(false),
+          m_instanceLock(),
+          m_alreadyRunning(false),
+          m_intents()
 {
-    installTranslators();
+    installTranslators(m_qtTranslator, m_appTranslator);
 
     setAttribute(Qt::AA_UseHighDpiPixmaps);
-    setOrganizationDomain(QLatin1String("dev.equit"));
-    setOrganizationName(QLatin1String("Équit"));
     setApplicationDisplayName(tr("OneDrive synchronisation app"));
-    setApplicationVersion(QLatin1String("3.0"));
     QApplication::setWindowIcon(QIcon(":window-icon"));
 
-    // read command-line args
-    QCommandLineParser parser;
-    parser.setApplicationDescription(tr("Synchronise your OneDrive from the system tray."));
-    parser.addHelpOption();
-    parser.addVersionOption();
-
-    parser.addOption(QCommandLineOption(
-            {"p" , "onedrive-path"},
-            "Path to the OneDrive program.",
-            "path",
-            DefaultOneDrivePath
-    ));
-
-    parser.addOption(QCommandLineOption(
-            {"a", "onedrive-args"},
-            "Custom arguments to pass to the onedrive client. The arguments --verbose and --monitor are always passed",
-            "args"
-    ));
-
-    parser.addOption(QCommandLineOption(
-            {"s", "silent-fail"},
-            tr("Silently quit if no system tray is available rather than showing a notification first.")
-    ));
+    const auto options = parseCommandLine(*this, tr("Synchronise your OneDrive from the system tray."));
+    m_service.setOneDrivePath(options.oneDrivePath);
+    m_service.setOneDriveArgs(options.oneDriveArguments);
+    m_intents = options.intents;
 
-    parser.addOption(QCommandLineOption(
-            {"d", "debug"},
-            tr("Output more information to stdout while running.")
-    ));
-
-    parser.process(*this);
+    if (!m_instanceLock.acquire(m_service.instanceKey())) {
+        // nothing else is needed to forward the intents, which exec() does
+        m_alreadyRunning = true;
+        return;
+    }
 
     if (!QSystemTrayIcon::isSystemTrayAvailable()) {
-        if (!parser.isSet(QLatin1String("silent-fail"))) {
-            showNotification(tr("No system tray is available."));
+        if (!options.silentFail) {
+            // nothing else is running yet, so there's no harm in blocking here
+            QMessageBox::critical(nullptr, applicationDisplayName(), tr("No system tray is available."));
         }
 
         throw RuntimeException("No system tray.");
     }
 
-#if defined(NDEBUG)
-    m_debug = parser.isSet(QLatin1String("debug"));
-#else
-    m_debug = true;
-#endif
-
-    m_oneDrivePath = parser.value(QLatin1String("p"));
-
-    if (m_oneDrivePath.isEmpty()) {
-        m_oneDrivePath = DefaultOneDrivePath;
-    }
-
-    if (const auto args = parser.value(QLatin1String("a")); !args.isEmpty()) {
-        m_oneDriveArguments.append(args.split(QRegularExpression(QLatin1String(" +")), Qt::SplitBehaviorFlags::SkipEmptyParts));
-    }
+    m_debug = options.debug;
+    startLogging(options);
 
+    m_service.notifier().setFallback(&m_notificationFallback);
+    m_service.notifier().setDisplayName(applicationDisplayName());
     loadSettings();
 
     setupTrayIconMenu();
     connect(&m_trayIcon, &QSystemTrayIcon::activated, this, &Application::trayIconActivated);
     setQuitOnLastWindowClosed(false);
 
+    showLastSession();
     connectProcess();
+    connect(&m_instanceLock, &InstanceLock::intentReceived, this, &Application::onIntentReceived);
 }
 
 
 Application::~Application() noexcept
 {
-    m_oneDriveProcess.disconnect(this);
-    m_oneDriveProcess.terminate();
-    int giveUp = 5;
-
-    while (QProcess::ProcessState::Running == m_oneDriveProcess.state() && 0 < giveUp) {
-        if (m_oneDriveProcess.waitForFinished(1000)) {
-            break;
-        }
-
-        std::cerr << "waited 1s for onedrive process to finish.\n";
-        --giveUp;
-    }
-
-    if (0 == giveUp) {
-        std::cerr << "onedrive process did not terminate cleanly.\n";
-    }
-}
-
-
-void Application::installTranslators()
-{
-    if (m_qtTranslator.load("qt_" + QLocale::system().name(), QLibraryInfo::location(QLibraryInfo::TranslationsPath))) {
-        installTranslator(&m_qtTranslator);
-    }
-
-    // Loads path + filename + prefix + ui language name + suffix (".qm" if the suffix is not specified)
-    if (m_appTranslator.load(QLocale(), applicationName(), "_", applicationDirPath())) {
-        installTranslator(&m_appTranslator);
-    } else {
-        std::cerr <<
-            "Translation not found for " <<
-            qPrintable(QLocale::languageToString(QLocale::system().language())) <<
-            " language (" <<
-            qPrintable(std::reduce(
-                    QLocale::system().uiLanguages().cbegin(),
-                    QLocale::system().uiLanguages().cend(),
-                    QString(),
-                    [](QString init, const QString & isoLanguage) -> QString {
-                        if (!init.isNull()) {
-                            init += ", ";
-                        }
-
-                        init += isoLanguage;
-                        return init;
-                    }
-            ))
-            << ")\n";
-    }
-}
-
-
-void Application::showNotification(const QString & message, int timeout, OneDrive::Application::NotificationType type) const
-{
-    QMessageBox::StandardButton (* messageFunction)(QWidget *, const QString &, const QString &, QMessageBox::StandardButtons, QMessageBox::StandardButton);
-
-    switch (type) {
-        case NotificationType::Message:
-            messageFunction = QMessageBox::information;
-            break;
-
-        case NotificationType::Warning:
-            messageFunction = QMessageBox::warning;
-            break;
-
-        case NotificationType::Error:
-            messageFunction = QMessageBox::critical;
-            break;
-    }
-
-    messageFunction(nullptr, applicationDisplayName(), message, QMessageBox::Ok, QMessageBox::NoButton);
+    m_service.process().disconnect(this);
+    m_service.disconnect(this);
+    m_service.shutDown();
+    Logger::stop();
 }
 
 
@@ -227,16 +139,39 @@ void Application::showSettingsWindow()
 
         connect(settingsWidget, &SettingsWidget::changed, [this]() {
             auto * settingsWidget = m_settingsWindow->settingsWidget();
-            m_settings.setStartOwnOneDrive(settingsWidget->startOwnOneDrive());
-            m_settings.setUseCustomOneDrive(settingsWidget->useCustomOneDrive());
-            m_settings.setCustomOneDrivePath(settingsWidget->customOneDrivePath().toStdString());
-            m_settings.setUseCustomSocket(settingsWidget->useCustomSocket());
-            m_settings.setCustomSocketPath(settingsWidget->customSocketPath().toStdString());
-            m_settings.setUseCustomSocket(settingsWidget->useCustomSocket());
-            m_settings.setUseCustomSocket(settingsWidget->useCustomSocket());
-            m_settings.setUseCustomSocket(settingsWidget->useCustomSocket());
+            auto & settings = m_service.settings();
+            settings.setStartOwnOneDrive(settingsWidget->startOwnOneDrive());
+            settings.setUseCustomOneDrive(settingsWidget->useCustomOneDrive());
+            settings.setCustomOneDrivePath(settingsWidget->customOneDrivePath().toStdString());
+            settings.setUseCustomSocket(settingsWidget->useCustomSocket());
+            settings.setCustomSocketPath(settingsWidget->customSocketPath().toStdString());
+            settings.setUseCustomSocket(settingsWidget->useCustomSocket());
+            settings.setUseCustomSocket(settingsWidget->useCustomSocket());
+            settings.setUseCustomSocket(settingsWidget->useCustomSocket());
             saveSettings();
         });
+
+        connect(settingsWidget, &SettingsWidget::performanceSettingsApplied, [this](const PerformanceSettings & performanceSettings) {
+            QString error;
+
+            if (!m_service.applyPerformanceSettings(performanceSettings, error)) {
+                QMessageBox::warning(&*m_settingsWindow, tr("Performance settings"), error);
+            } else if (m_service.settings().adaptiveMonitorInterval()) {
+                // while the interval is adapted these are the intervals to return to, not the ones to use now
+                auto & settings = m_service.settings();
+                settings.setUserMonitorInterval(performanceSettings.monitorInterval);
+                settings.setUserMonitorFullscanFrequency(performanceSettings.monitorFullscanFrequency);
+                saveSettings();
+            }
+        });
+    }
+
+    OneDriveConfig config(m_service.configDirectory() + QStringLiteral("/config"));
+
+    if (config.load()) {
+        m_settingsWindow->settingsWidget()->setPerformanceSettings(config.performanceSettings());
+    } else {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("could not read %1: %2").arg(config.path(), config.errorString()));
     }
 
     m_settingsWindow->show();
@@ -250,9 +185,24 @@ void Application::setupTrayIconMenu()
     // these are just labels, they're not really actions
     m_freeSpaceAction.setDisabled(true);
     m_statusAction.setDisabled(true);
+    m_latencyAction.setDisabled(true);
+    m_latencyAction.setVisible(false);
+    m_localTotalsAction.setDisabled(true);
+    m_localTotalsAction.setVisible(false);
+    m_errorsAction.setDisabled(true);
+    m_errorsAction.setVisible(false);
+    m_throttlingAction.setDisabled(true);
+    m_throttlingAction.setVisible(false);
 
     m_trayIconMenu.addAction(&m_freeSpaceAction);
     m_trayIconMenu.addAction(&m_statusAction);
+    m_trayIconMenu.addAction(&m_latencyAction);
+    m_trayIconMenu.addAction(&m_localTotalsAction);
+    m_trayIconMenu.addAction(&m_errorsAction);
+    m_trayIconMenu.addAction(&m_throttlingAction);
+
+    // the error counts are for the last hour, so they go down without any new errors being reported
+    connect(&m_trayIconMenu, &QMenu::aboutToShow, this, &Application::onErrorStatisticsChanged);
 
     m_trayIconMenu.addSeparator();
 
@@ -264,21 +214,28 @@ void Application::setupTrayIconMenu()
     connect(action, &QAction::triggered, this, &Application::openLocalDirectory);
     m_trayIconMenu.addAction(action);
 
-    connect(&m_restartAction, &QAction::triggered, &m_oneDriveProcess, [this] () {
-        assert(!m_oneDriveProcess.isRunning());
-        oneDriveProcess().start();
+    connect(&m_restartAction, &QAction::triggered, this, [this] () {
+        assert(!oneDriveProcess().isRunning());
+        m_service.restart();
     });
 
     m_restartAction.setVisible(false);
 
     connect(&m_suspendAction, &QAction::triggered, this, [this] () {
-        if (!oneDriveProcess().isRunning()) {
-            return;
-        }
+        m_service.stop();
+    });
 
-        oneDriveProcess().terminate();
+    connect(&m_pauseAction, &QAction::triggered, this, [this] () {
+        pauseSynchronisation();
     });
 
+    connect(&m_timedPauseAction, &QAction::triggered, this, [this] () {
+        pauseSynchronisation(SynchronisationService::TimedPauseDuration);
+    });
+
+    connect(&m_resumeAction, &QAction::triggered, this, &Application::resumeSynchronisation);
+    updateProcessActions();
+
     auto * iconColorGroup = new QActionGroup(this);
 
     action = iconColorGroup->addAction(QIcon(":/tray-icon-mono"), tr("Monochrome"));
@@ -302,13 +259,70 @@ void Application::setupTrayIconMenu()
     auto * colourMenu = m_trayIconMenu.addMenu(tr("Icon style"));
     colourMenu->addActions(iconColorGroup->actions());
 
+    auto * priorityGroup = new QActionGroup(this);
+    const auto & limits = settings().resourceLimits();
+
+    const auto addPriority = [this, priorityGroup, &limits](const QString & label, int niceValue, IoPriorityClass ioClass, int ioLevel) {
+        auto * action = priorityGroup->addAction(label);
+        action->setCheckable(true);
+        action->setChecked(niceValue == limits.niceValue && ioClass == limits.ioPriorityClass && (IoPriorityClass::BestEffort != ioClass || ioLevel == limits.ioPriorityLevel));
+
+        connect(action, &QAction::triggered, [this, niceValue, ioClass, ioLevel] {
+            m_service.setOneDrivePriority(niceValue, ioClass, ioLevel);
+        });
+    };
+
+    addPriority(tr("Normal"), 0, IoPriorityClass::Default, 4);
+    addPriority(tr("Reduced"), 10, IoPriorityClass::BestEffort, ResourceLimits::MaximumIoPriorityLevel);
+    addPriority(tr("Background"), ResourceLimits::MaximumNiceValue, IoPriorityClass::Idle, ResourceLimits::MaximumIoPriorityLevel);
+
+    auto * priorityMenu = m_trayIconMenu.addMenu(tr("Synchronization priority"));
+    priorityMenu->addActions(priorityGroup->actions());
+
+    auto * batteryPolicyGroup = new QActionGroup(this);
+
+    const auto addBatteryPolicy = [this, batteryPolicyGroup](const QString & label, BatteryPolicy policy) {
+        auto * action = batteryPolicyGroup->addAction(label);
+        action->setCheckable(true);
+        action->setChecked(policy == settings().batteryPolicy());
+
+        connect(action, &QAction::triggered, [this, policy] {
+            m_service.setBatteryPolicy(policy);
+        });
+    };
+
+    addBatteryPolicy(tr("Keep synchronizing"), BatteryPolicy::None);
+    addBatteryPolicy(tr("Lower the priority"), BatteryPolicy::Deprioritise);
+    addBatteryPolicy(tr("Pause synchronization"), BatteryPolicy::Pause);
+
+    auto * batteryPolicyMenu = m_trayIconMenu.addMenu(tr("On battery"));
+    batteryPolicyMenu->addActions(batteryPolicyGroup->actions());
+
     m_trayIconMenu.addSeparator();
 
     m_trayIconMenu.addAction(&m_restartAction);
+    m_trayIconMenu.addAction(&m_pauseAction);
+    m_trayIconMenu.addAction(&m_timedPauseAction);
+    m_trayIconMenu.addAction(&m_resumeAction);
     m_trayIconMenu.addAction(&m_suspendAction);
 
     m_trayIconMenu.addSeparator();
 
+    m_notifyTransfersAction.setCheckable(true);
+    m_notifyTransfersAction.setChecked(settings().notifyTransfers());
+
+    connect(&m_notifyTransfersAction, &QAction::toggled, &m_service, &SynchronisationService::setNotifyTransfers);
+
+    m_trayIconMenu.addAction(&m_notifyTransfersAction);
+
+    m_adaptiveMonitorIntervalAction.setCheckable(true);
+    m_adaptiveMonitorIntervalAction.setChecked(settings().adaptiveMonitorInterval());
+    m_adaptiveMonitorIntervalAction.setToolTip(tr("Check for remote changes often while files are changing, and less often when nothing has changed for a while. onedrive is restarted when the interval changes."));
+
+    connect(&m_adaptiveMonitorIntervalAction, &QAction::toggled, &m_service, &SynchronisationService::setAdaptiveMonitorInterval);
+
+    m_trayIconMenu.addAction(&m_adaptiveMonitorIntervalAction);
+
     action = new QAction(tr("&Settings"), this);
     connect(action, &QAction::triggered, this, &Application::showSettingsWindow);
     m_trayIconMenu.addAction(action);
@@ -326,64 +340,27 @@ void Application::setupTrayIconMenu()
 
 void Application::setTrayIconStyle(IconStyle style)
 {
-    m_settings.setIconStyle(style);
+    m_service.settings().setIconStyle(style);
     saveSettings();
     refreshTrayIcon();
 }
 
-
-void Application::saveSettings() const
-{
-    QSettings settingsStore;
-    settingsStore.beginGroup(QLatin1String("Application"));
-    settingsStore.setValue("iconStyle", static_cast<int>(m_settings.iconStyle()));
-    settingsStore.setValue("startOwnOneDrive", m_settings.startOwnOneDrive());
-    settingsStore.setValue("useCustomOneDrive", m_settings.useCustomOneDrive());
-    settingsStore.setValue("customOneDrivePath", QString::fromStdString(m_settings.customOneDrivePath()));
-    settingsStore.setValue("useCustomSocket", m_settings.useCustomSocket());
-    settingsStore.setValue("customSocketPath", QString::fromStdString(m_settings.customSocketPath()));
-    settingsStore.endGroup();
-}
-
-
-void Application::loadSettings()
-{
-    QSettings settingsStore;
-    settingsStore.beginGroup(QLatin1String("Application"));
-
-    switch (settingsStore.value("iconStyle", 0).value<int>()) {
-        default:
-            std::cerr << "unexpected icon style " << settingsStore.value("iconStyle", 0).value<int>() << " in m_settings file - defaulting to 'colourful'\n";
-            [[fallthrough]];
-        case static_cast<int>(IconStyle::colourful):
-            m_settings.setIconStyle(IconStyle::colourful);
-            break;
-
-        case static_cast<int>(IconStyle::monochrome):
-            m_settings.setIconStyle(IconStyle::monochrome);
-            break;
-    }
-
-    m_settings.setStartOwnOneDrive(settingsStore.value("startOwnOneDrive", true).value<bool>());
-    m_settings.setUseCustomOneDrive(settingsStore.value("useCustomOneDrive", true).value<bool>());
-    m_settings.setCustomOneDrivePath(settingsStore.value("customOneDrivePath", "").value<QString>().toStdString());
-    m_settings.setUseCustomSocket(settingsStore.value("useCustomSocket", true).value<bool>());
-    m_settings.setCustomSocketPath(settingsStore.value("customSocketPath", "").value<QString>().toStdString());
-    settingsStore.endGroup();
-}
-
-
 void Application::refreshTrayIcon()
 {
     // do not change the tray icon if is currently syncing and continue to sync
     QString iconName = ":/tray-icon";
 
-    switch (m_oneDriveProcess.synchronisationState()) {
+    switch (oneDriveProcess().synchronisationState()) {
         case Process::SynchronisationState::Idle:
+        case Process::SynchronisationState::Stopped:
             // no suffix when idle
             break;
 
-        case Process::SynchronisationState::Syncing:
+        case Process::SynchronisationState::Starting:
+        case Process::SynchronisationState::ScanningLocal:
+        case Process::SynchronisationState::FetchingRemote:
+        case Process::SynchronisationState::Transferring:
+        case Process::SynchronisationState::Error:
             iconName += "-sync";
             break;
 
@@ -391,7 +368,7 @@ void Application::refreshTrayIcon()
             throw std::logic_error("Unhandled sync state in Application::refreshTrayIcon()");
     }
 
-    switch (m_settings.iconStyle()) {
+    switch (settings().iconStyle()) {
         case IconStyle::colourful:
             iconName += "-colour";
             break;
@@ -407,34 +384,9 @@ void Application::refreshTrayIcon()
     m_trayIcon.setIcon(QIcon(iconName));
 }
 
-const QString & Application::oneDriveConfigFile() const
-{
-    static QString path = locateOneDriveConfigFile();
-    return path;
-}
-
-
-QString Application::locateOneDriveConfigFile() const
+void Application::openLocalDirectory()
 {
-    QStringList args = oneDriveArgs();
-    auto it = std::find(args.cbegin(), args.cend(), QStringLiteral("--confdir"));
-    QString path;
-
-    if (it == args.cend()) {
-        path = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + DefaultOneDriveConfigFile;
-    } else {
-        ++it;
-        path = expandHomeShortcut(*it);
-    }
-
-    QSettings oneDriveConfig(path, QSettings::IniFormat);
-    return expandHomeShortcut(oneDriveConfig.value("sync_dir", QDir::homePath() + "/OneDrive").toString());
-}
-
-
-void Application::openLocalDirectory() const
-{
-    static QString path = oneDriveConfigFile();
+    const auto & path = m_service.syncDirectory();
 
     if (path.isEmpty()) {
         showNotification(tr("The path for the local OneDrive directory is not defined."));
@@ -449,28 +401,43 @@ void Application::openLocalDirectory() const
 
 int Application::exec()
 {
+    if (m_alreadyRunning) {
+        // a plain second launch most likely means the user is looking for the window
+        if (m_instanceLock.forward(m_intents.isEmpty() ? QList<InstanceLock::Intent>{InstanceLock::Intent::ShowMessages} : m_intents)) {
+            return 0;
+        }
+
+        std::cerr << "onedrive-tray is already running for this OneDrive configuration but did not respond\n";
+        return 1;
+    }
+
     m_trayIcon.show();
     refreshTrayIcon();
+    m_service.start();
 
-    m_oneDriveProcess.setProgram(oneDrivePath());
-    m_oneDriveProcess.setArguments(oneDriveArgs());
-    m_oneDriveProcess.start();
+    for (const auto intent : m_intents) {
+        onIntentReceived(intent);
+    }
 
     return QApplication::exec();
 }
 
 
-QString Application::expandHomeShortcut(const QString & path)
+void Application::onIntentReceived(InstanceLock::Intent intent)
 {
-    if (path.startsWith(QLatin1String("~/"))) {
-        return QString(path).replace(0, 1, QDir::homePath());
-    } else if (path.startsWith(QLatin1String("$HOME/"))) {
-        QString(path).replace(0, 5, QDir::homePath());
-    } else if (path.startsWith(QLatin1String("${HOME}/"))) {
-        QString(path).replace(0, 7, QDir::homePath());
-    }
+    switch (intent) {
+        case InstanceLock::Intent::ShowMessages:
+            showWindow();
+            break;
+
+        case InstanceLock::Intent::Pause:
+            pauseSynchronisation();
+            break;
 
-    return path;
+        case InstanceLock::Intent::OpenFolder:
+            openLocalDirectory();
+            break;
+    }
 }
 
 
@@ -492,7 +459,7 @@ void Application::trayIconActivated(QSystemTrayIcon::ActivationReason reason)
 
         case QSystemTrayIcon::MiddleClick:
             if (oneDriveProcess().isRunning()) {
-                showNotification(tr("OneDrive is running with the PID %1.").arg(m_oneDriveProcess.processId()));
+                showNotification(tr("OneDrive is running with the PID %1.").arg(oneDriveProcess().processId()));
             } else {
                 showNotification(tr("OneDrive is not running. Please restart the program."));
             }
@@ -517,89 +484,141 @@ void Application::hideWindow()
 
 void Application::connectProcess()
 {
-    connect(&m_oneDriveProcess, &Process::started, this, &Application::onProcessStarted);
-    connect(&m_oneDriveProcess, &Process::stopped, this, &Application::onProcessStopped);
-    connect(&m_oneDriveProcess, &Process::freeSpaceUpdated, this, &Application::onFreeSpaceUpdated);
-    connect(&m_oneDriveProcess, &Process::synchronisationComplete, this, &Application::onSynchronisationComplete);
-    connect(&m_oneDriveProcess, &Process::localRootDirectoryRemoved, this, &Application::onLocalRootDirectoryRemoved);
-    connect(&m_oneDriveProcess, &Process::localDirectoryCreated, this, &Application::onLocalDirectoryCreated);
-    connect(&m_oneDriveProcess, &Process::remoteDirectoryCreated, this, &Application::onRemoteDirectoryCreated);
-    connect(&m_oneDriveProcess, &Process::fileRenamed, this, &Application::onFileRenamed);
-    connect(&m_oneDriveProcess, &Process::fileDeleted, this, &Application::onFileDeleted);
-    connect(&m_oneDriveProcess, &Process::fileUploaded, this, &Application::onFileUploaded);
-    connect(&m_oneDriveProcess, &Process::fileDownloaded, this, &Application::onFileDownloaded);
-}
+    connect(&m_service, &SynchronisationService::stateChanged, this, &Application::onProcessStateChanged);
+    connect(&m_service, &SynchronisationService::statusChanged, &m_statusAction, &QAction::setText);
+    connect(&m_service.resourceMonitor(), &ResourceMonitor::usageUpdated, this, &Application::onResourceUsageUpdated);
+    connect(&m_service.latencyTracker(), &ChangeLatencyTracker::statisticsChanged, this, &Application::onLatencyStatisticsChanged);
+    connect(&m_service.directoryScanner(), &SyncDirectoryScanner::totalsChanged, this, &Application::onLocalTotalsChanged);
+    connect(&m_service.errorClassifier(), &ErrorClassifier::statisticsChanged, this, &Application::onErrorStatisticsChanged);
+    connect(&m_service.throttleMonitor(), &ThrottleMonitor::statisticsChanged, this, &Application::onThrottleStatisticsChanged);
 
+    connect(&m_service.errorClassifier(), &ErrorClassifier::errorReported, this, [this](ErrorClass errorClass, const QString & message, quint64 repeats, const Process::Timestamp & time) {
+        auto error = ErrorClassifier::className(errorClass) + ": " + message;
 
-void Application::onProcessStarted()
-{
-    m_restartAction.setVisible(true);
-    m_suspendAction.setVisible(false);
-    m_statusAction.setText(tr("Synchronization suspended"));
-    refreshTrayIcon();
-}
+        if (1 < repeats) {
+            error += " " + tr("(%n time(s) since the last report)", nullptr, static_cast<int>(std::min<quint64>(repeats, std::numeric_limits<int>::max())));
+        }
 
+        m_messagesWindow.addErrorMessage(error, time);
+    });
 
-void Application::onProcessStopped()
-{
-    m_suspendAction.setVisible(true);
-    m_restartAction.setVisible(false);
-    m_statusAction.setText(tr("Idle"));
-    refreshTrayIcon();
+    m_service.eventBus().subscribe(this, EventBus::typeMask(EventBus::EventType::FreeSpaceUpdated), {}, [this](const EventBus::Batch & events) {
+        // only the latest figure is shown
+        onFreeSpaceUpdated(events.last().size);
+    });
 }
 
 
-void Application::onFreeSpaceUpdated(quint64 space)
+void Application::showLastSession()
 {
-    m_freeSpaceAction.setText(tr("Free space: %1").arg( QLocale::system().formattedDataSize(static_cast<qint64>(space), 2, QLocale::DataSizeTraditionalFormat)));
+    const auto & lastSession = m_service.lastSession();
+
+    if (!lastSession) {
+        return;
+    }
+
+    const auto & status = lastSession->status;
+    const auto locale = QLocale::system();
+    const auto time = locale.toString(QDateTime::fromMSecsSinceEpoch(status.updated), QLocale::ShortFormat);
+    const auto statusText = QString::fromUtf8(status.status);
+
+    if (!statusText.isEmpty()) {
+        m_statusAction.setText(tr("%1 (last session, %2)").arg(statusText, time));
+    }
+
+    if (0 <= status.freeSpace) {
+        m_freeSpaceAction.setText(tr("Free space: %1 (last session, %2)").arg(locale.formattedDataSize(status.freeSpace, 2, QLocale::DataSizeTraditionalFormat), time));
+    }
+
+    m_messagesWindow.addLastSessionEvents(lastSession->events);
 }
 
 
-void Application::onSynchronisationComplete()
+void Application::updateProcessActions()
 {
-    m_statusAction.setText(tr("Sync complete"));
-    refreshTrayIcon();
+    const auto & process = oneDriveProcess();
+    const auto running = process.isRunning();
+    const auto paused = running && process.isPaused();
+    m_restartAction.setVisible(!running);
+    m_pauseAction.setVisible(running && !paused);
+    m_timedPauseAction.setVisible(running && !paused);
+    m_resumeAction.setVisible(paused);
+    m_suspendAction.setVisible(running);
 }
 
 
-void Application::onLocalRootDirectoryRemoved()
+void Application::onProcessStateChanged()
 {
-    m_statusAction.setText(tr("Sync complete"));
+    updateProcessActions();
     refreshTrayIcon();
 }
 
 
-void Application::onLocalDirectoryCreated(const QString &directoryName)
+void Application::onResourceUsageUpdated(const ResourceUsage & usage)
 {
-    m_statusAction.setText(tr("Local directory %1 created").arg(directoryName));
+    if (!m_service.resourceMonitor().hasUsage()) {
+        m_trayIcon.setToolTip(applicationDisplayName());
+        m_messagesWindow.setResourceUsage(QString());
+        return;
+    }
+
+    const auto description = ResourceMonitor::describe(usage);
+    m_trayIcon.setToolTip(applicationDisplayName() + "\n" + description);
+    m_messagesWindow.setResourceUsage(description);
 }
 
 
-void Application::onRemoteDirectoryCreated(const QString &directoryName)
+void Application::onLatencyStatisticsChanged()
 {
-    m_statusAction.setText(tr("Remote directory %1 created").arg(directoryName));
+    const auto & latencyTracker = m_service.latencyTracker();
+    const auto pending = latencyTracker.pendingChanges();
+
+    if (0 == latencyTracker.sampleCount()) {
+        m_latencyAction.setText(tr("%n local change(s) waiting to upload", nullptr, pending));
+    } else {
+        m_latencyAction.setText(tr("Upload delay: median %1, 99th percentile %2, %n change(s) waiting", nullptr, pending).arg(
+                formatDuration(latencyTracker.latencyPercentile(50)),
+                formatDuration(latencyTracker.latencyPercentile(99))
+        ));
+    }
+
+    m_latencyAction.setVisible(true);
 }
 
 
-void Application::onFileDeleted(const QString &fileName)
+void Application::onLocalTotalsChanged()
 {
-    m_statusAction.setText(tr("File %1 deleted").arg(fileName));
+    const auto locale = QLocale::system();
+    const auto & scanner = m_service.directoryScanner();
+
+    m_localTotalsAction.setText(tr("Local folder: %1 files in %2 folders, %3").arg(
+            locale.toString(scanner.fileCount()),
+            locale.toString(scanner.directoryCount()),
+            locale.formattedDataSize(static_cast<qint64>(scanner.totalBytes()), 2, QLocale::DataSizeTraditionalFormat)
+    ));
+
+    m_localTotalsAction.setVisible(true);
 }
 
 
-void Application::onFileRenamed(const QString &from, const QString &to)
+void Application::onErrorStatisticsChanged()
 {
-    m_statusAction.setText(tr("File %1 renamed as %2").arg(from, to));
+    const auto summary = m_service.errorClassifier().summary();
+    m_errorsAction.setText(summary);
+    m_errorsAction.setVisible(!summary.isEmpty());
 }
 
 
-void Application::onFileUploaded(const QString &fileName)
+void Application::onThrottleStatisticsChanged()
 {
-    m_statusAction.setText(tr("Uploading %1 ...").arg(fileName));
+    const auto summary = m_service.throttleMonitor().summary();
+    m_throttlingAction.setText(summary);
+    m_throttlingAction.setVisible(!summary.isEmpty());
 }
 
 
-void Application::onFileDownloaded(const QString &fileName)
+void Application::onFreeSpaceUpdated(quint64 space)
 {
-    m_statusAction.setText(tr("Downloading %1 ...").arg(fileName));
+    m_freeSpaceAction.setText(tr("Free space: %1").arg( QLocale::system().formattedDataSize(static_cast<qint64>(space), 2, QLocale::DataSizeTraditionalFormat)));
 }
+
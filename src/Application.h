@@ -9,16 +9,18 @@
 
 #include <memory>
 #include <stdexcept>
+#include <QtCore/QTimer>
 #include <QtCore/QTranslator>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QSystemTrayIcon>
 #include <QtWidgets/QMenu>
 #include <QtWidgets/QAction>
 #include "IconStyle.h"
-#include "Settings.h"
-#include "Process.h"
+#include "InstanceLock.h"
+#include "SynchronisationService.h"
 #include "MessagesWindow.h"
 #include "SettingsWindow.h"
+#include "TrayNotificationFallback.h"
 
 #define oneDriveApp (dynamic_cast<OneDrive::Application *>(QApplication::instance()))
 
@@ -35,9 +37,8 @@ namespace OneDrive
     /**
      * The application class.
      *
-     * The class is a singleton. It reads the m_settings and sets up the UI, starts the onedrive process and waits for
-     * user input and messages from the client. It emits signals when the client indicates something of note has
-     * happened.
+     * The class is a singleton. It sets up the UI on top of the synchronisation service, which runs the onedrive
+     * process, and waits for user input and messages from the client.
      */
     class Application
             : public QApplication
@@ -45,16 +46,10 @@ namespace OneDrive
     Q_OBJECT
 
     public:
-        /** Enumeration of the types of notification the app can display. */
-        enum class NotificationType
-        {
-            Message,
-            Warning,
-            Error,
-        };
+        using NotificationType = SynchronisationService::NotificationType;
 
         /** The defualt duration (in ms) for which notifications will be displayed.*/
-        static const int DefaultNotificationTimeout = 5000;
+        static const int DefaultNotificationTimeout = SynchronisationService::DefaultNotificationTimeout;
 
         /** Use this to specify that a notification should not time out. */
         static const int NoNotificationTimeout = 0;
@@ -73,13 +68,19 @@ namespace OneDrive
         /** Fetch the path to the onedrive client. */
         [[nodiscard]] inline const QString & oneDrivePath() const
         {
-            return m_oneDrivePath;
+            return m_service.oneDrivePath();
         }
 
         /** Fetch the arguments used to start the onedrive client. */
         [[nodiscard]] inline const QStringList & oneDriveArgs() const
         {
-            return m_oneDriveArguments;
+            return m_service.oneDriveArgs();
+        }
+
+        /** Fetch the service that runs the onedrive client. */
+        [[nodiscard]] inline SynchronisationService & synchronisationService()
+        {
+            return m_service;
         }
 
         /** Show the application about dialogue. */
@@ -91,11 +92,17 @@ namespace OneDrive
         /**
          * Show a notification to the user.
          *
+         * The notification is shown asynchronously. Notifications of the same type that arrive in quick succession
+         * replace each other.
+         *
          * @param message The message to show.
          * @param timeout How many ms to show the notification for.
          * @param type The notification type.
          */
-        void showNotification(const QString & message, int timeout = DefaultNotificationTimeout, NotificationType type = NotificationType::Message) const;
+        inline void showNotification(const QString & message, int timeout = DefaultNotificationTimeout, NotificationType type = NotificationType::Message)
+        {
+            m_service.showNotification(message, timeout, type);
+        }
 
         /**
          * Show a notification to the user.
@@ -103,7 +110,7 @@ namespace OneDrive
          * @param message The message to show.
          * @param type The notification type.
          */
-        inline void showNotification(const QString & message, NotificationType type) const
+        inline void showNotification(const QString & message, NotificationType type)
         {
             showNotification(message, DefaultNotificationTimeout, type);
         }
@@ -144,7 +151,7 @@ namespace OneDrive
          */
         inline const Process & oneDriveProcess() const
         {
-            return m_oneDriveProcess;
+            return m_service.process();
         }
 
         /**
@@ -153,12 +160,12 @@ namespace OneDrive
          */
         inline Process & oneDriveProcess()
         {
-            return m_oneDriveProcess;
+            return m_service.process();
         }
 
         [[nodiscard]] inline const Settings & settings() const
         {
-            return m_settings;
+            return m_service.settings();
         }
 
         /** Fetch the user's preferred icon style. */
@@ -171,17 +178,16 @@ namespace OneDrive
         void setTrayIconStyle(IconStyle style);
 
         /** Load the application m_settings. */
-        void loadSettings();
+        inline void loadSettings()
+        {
+            m_service.loadSettings();
+        }
 
         /** Save the current application m_settings. */
-        void saveSettings() const;
-
-        /**
-         * Fetch the path to the onedrive client's current config file.
-         *
-         * @return The path.
-         */
-        [[nodiscard]] const QString & oneDriveConfigFile() const;
+        inline void saveSettings() const
+        {
+            m_service.saveSettings();
+        }
 
         /** Show the messages window. */
         void showWindow();
@@ -190,13 +196,32 @@ namespace OneDrive
         void hideWindow();
 
         /** Open the local directory in the user's file manager. */
-        void openLocalDirectory() const;
+        void openLocalDirectory();
+
+        /**
+         * Pause synchronisation without stopping the onedrive client.
+         *
+         * @param duration How long to pause for (ms), or 0 to pause until resumeSynchronisation() is called.
+         */
+        inline void pauseSynchronisation(int duration = 0)
+        {
+            m_service.pauseSynchronisation(duration);
+        }
+
+        /** Resume synchronisation after pauseSynchronisation(). */
+        inline void resumeSynchronisation()
+        {
+            m_service.resumeSynchronisation();
+        }
 
         /**
          * Run the application.
          *
          * Show the icon, start the onedrive client process, and wait for it to send output.
          *
+         * If another instance is already running for the same onedrive config directory, the intents from the command
+         * line are forwarded to it instead and this returns immediately.
+         *
          * @return The exit code.
          */
         int exec();
@@ -204,60 +229,28 @@ namespace OneDrive
     Q_SIGNALS:
 
     protected:
-        /** Receiver for when the process indicates it has started running. */
-        void onProcessStarted();
-
-        /** Receiver for when the process indicates it has stopped running */
-        void onProcessStopped();
-
-        /** Receiver for when the process indicates the free space. */
-        void onFreeSpaceUpdated(quint64 space);
-
-        /** Receiver for when the process indicates synchronisation has finished. */
-        void onSynchronisationComplete();
-
-        /** Receiver for when the process indicates the local root directory has been removed. */
-        void onLocalRootDirectoryRemoved();
+        /** Receiver for when the process starts, stops, is paused or is resumed. */
+        void onProcessStateChanged();
 
-        /** Receiver for when the process indicates a local directory has been created. */
-        void onLocalDirectoryCreated(const QString & directoryName);
+        /** Receiver for when a new sample of the process's resource usage is available. */
+        void onResourceUsageUpdated(const ResourceUsage & usage);
 
-        /** Receiver for when the process indicates a remote directory has been created. */
-        void onRemoteDirectoryCreated(const QString & directoryName);
+        /** Receiver for when the change-to-upload latency or the local change backlog changes. */
+        void onLatencyStatisticsChanged();
 
-        /** Receiver for when the process indicates a file has been deleted. */
-        void onFileDeleted(const QString & fileName);
+        /** Receiver for when the file, directory or byte count of the local sync directory changes. */
+        void onLocalTotalsChanged();
 
-        /** Receiver for when the process indicates a file has been renamed. */
-        void onFileRenamed(const QString & from, const QString & to);
+        /** Receiver for when the counts of the errors reported by the process change. */
+        void onErrorStatisticsChanged();
 
-        /** Receiver for when the process indicates a file has been uploaded. */
-        void onFileUploaded(const QString & fileName);
+        /** Receiver for when the throttling statistics change. */
+        void onThrottleStatisticsChanged();
 
-        /** Receiver for when the process indicates a file has been downloaded. */
-        void onFileDownloaded(const QString & fileName);
+        /** Receiver for when the process indicates the free space. */
+        void onFreeSpaceUpdated(quint64 space);
 
     private:
-
-        /**
-         * Helper to expand ~ and $HOME in a path to the full home path.
-         *
-         * @param path The path to expand.
-         *
-         * @return The expanded path.
-         */
-        static QString expandHomeShortcut(const QString & path);
-
-        /** Helper to install the translators. */
-        void installTranslators();
-
-        /**
-         * Helper to locate the config file onedrive is using.
-         *
-         * @return The path to the config file.
-         */
-        [[nodiscard]] QString locateOneDriveConfigFile() const;
-
         /**
          * Slot for when the tray icon is activated.
          *
@@ -271,17 +264,25 @@ namespace OneDrive
         /** Helper to populate the tray icon menu. */
         void setupTrayIconMenu();
 
-        /** Helper to connect to signals on the onedrive process. */
+        /** Helper to connect to signals on the synchronisation service and the onedrive process. */
         void connectProcess();
 
-        /** The path to the onedrive client. */
-        QString m_oneDrivePath;
+        /**
+         * Show the status saved by the last session until the client reports afresh.
+         *
+         * Everything shown is marked as being from the last session. It is replaced as the service and the client
+         * report the current status.
+         */
+        void showLastSession();
 
-        /** The args for the onedrive client. */
-        QStringList m_oneDriveArguments;
+        /** Helper to show the process control actions appropriate to the process's current state. */
+        void updateProcessActions();
 
-        /** The onedrive process. */
-        Process m_oneDriveProcess;
+        /** Carry out an intent from the command line or from a later launch. */
+        void onIntentReceived(InstanceLock::Intent intent);
+
+        /** Runs the onedrive client. */
+        SynchronisationService m_service;
 
         /** The messages window. */
         MessagesWindow m_messagesWindow;
@@ -292,6 +293,15 @@ namespace OneDrive
         /** The tray icon. */
         QSystemTrayIcon m_trayIcon;
 
+        /** Shows notifications on the tray icon when the notification service isn't available. */
+        TrayNotificationFallback m_notificationFallback;
+
+        /** The action to turn notifications of transfers on and off. */
+        QAction m_notifyTransfersAction;
+
+        /** The action to turn the adapting of the client's check interval on and off. */
+        QAction m_adaptiveMonitorIntervalAction;
+
         /**
          * The tray icon menu.
          *
@@ -305,15 +315,33 @@ namespace OneDrive
         /** The action displaying the free OneDrive space. */
         QAction m_freeSpaceAction;
 
-        /** The action to suspend synchronisation. */
+        /** The action displaying the change-to-upload latency and the local change backlog. */
+        QAction m_latencyAction;
+
+        /** The action displaying the number of files and directories in the local sync directory and their size. */
+        QAction m_localTotalsAction;
+
+        /** The action summarising the errors the process has reported recently. */
+        QAction m_errorsAction;
+
+        /** The action summarising how much the server has throttled the process. */
+        QAction m_throttlingAction;
+
+        /** The action to stop synchronisation by terminating the process. */
         QAction m_suspendAction;
 
+        /** The action to pause synchronisation without terminating the process. */
+        QAction m_pauseAction;
+
+        /** The action to pause synchronisation for TimedPauseDuration. */
+        QAction m_timedPauseAction;
+
+        /** The action to resume paused synchronisation. */
+        QAction m_resumeAction;
+
         /** The action to restart synchronisation. */
         QAction m_restartAction;
 
-        /** The application settings. */
-        Settings m_settings;
-
         /** The translator for Qt strings. */
         QTranslator m_qtTranslator;
 
@@ -322,6 +350,15 @@ namespace OneDrive
 
         /** Whether the application is in debug mode. */
         bool m_debug;
+
+        /** Stops a second instance running for the same onedrive config directory. */
+        InstanceLock m_instanceLock;
+
+        /** Whether another instance is already running, in which case this one only forwards its intents. */
+        bool m_alreadyRunning;
+
+        /** The intents given on the command line. */
+        QList<InstanceLock::Intent> m_intents;
     };
 } // OneDrive
 
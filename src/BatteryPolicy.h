@@ -0,0 +1,21 @@
+/**
+ * BatteryPolicy.h
+ *
+ * Declaration of BatteryPolicy enumeration.
+ */
+
+#ifndef ONEDRIVETRAY_BATTERYPOLICY_H
+#define ONEDRIVETRAY_BATTERYPOLICY_H
+
+namespace OneDrive
+{
+    /** What to do with the onedrive client when running on battery below the configured charge level. */
+    enum class BatteryPolicy
+    {
+        None = 0,
+        Deprioritise,
+        Pause,
+    };
+}
+
+#endif //ONEDRIVETRAY_BATTERYPOLICY_H
@@ -0,0 +1,201 @@
+/**
+ * CGroup.cpp
+ *
+ * Implementation of CGroup class.
+ */
+
+#include <algorithm>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include "CGroup.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    const QString CGroupRoot = QStringLiteral("/sys/fs/cgroup");
+
+    /** The leaf the tray moves itself into so that controllers can be enabled for its cgroup's children. */
+    const QString TrayLeaf = QStringLiteral("tray");
+
+    /** The controllers the client's cgroup uses, if available. */
+    const QStringList WantedControllers = {QStringLiteral("cpu"), QStringLiteral("io"), QStringLiteral("memory")};
+
+    /** The period used for cpu.max (µs). */
+    constexpr const int CpuMaxPeriod = 100000;
+
+    /** The kernel's default cpu.weight. */
+    constexpr const int DefaultCpuWeight = 100;
+
+    QByteArray readFile(const QString & path)
+    {
+        QFile file(path);
+
+        if (!file.open(QIODevice::ReadOnly)) {
+            return {};
+        }
+
+        return file.readAll();
+    }
+
+    bool writeFile(const QString & path, const QByteArray & content)
+    {
+        QFile file(path);
+
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+
+        // cgroupfs reports errors from the write itself, so it must be flushed here rather than on close
+        return content.size() == file.write(content) && file.flush();
+    }
+
+    /** Read a space-separated controller list (cgroup.controllers, cgroup.subtree_control). */
+    QStringList readControllers(const QString & path)
+    {
+        return QString::fromLatin1(readFile(path)).simplified().split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    }
+}
+
+
+CGroup::CGroup(QString path, QStringList controllers)
+        : m_path(std::move(path)),
+          m_controllers(std::move(controllers))
+{
+}
+
+
+std::optional<CGroup> CGroup::create(const QString & name)
+{
+    // in a pure cgroup v2 hierarchy there is a single "0::<path>" entry
+    QString relativePath;
+
+    for (const auto & line : readFile(QStringLiteral("/proc/self/cgroup")).split('\n')) {
+        if (line.startsWith("0::")) {
+            relativePath = QString::fromUtf8(line.mid(3));
+            break;
+        }
+    }
+
+    if (relativePath.isEmpty()) {
+        return {};
+    }
+
+    const QDir base(CGroupRoot + relativePath);
+
+    if (!QFileInfo(base.filePath(QStringLiteral("cgroup.subtree_control"))).isWritable()) {
+        return {};
+    }
+
+    const auto available = readControllers(base.filePath(QStringLiteral("cgroup.controllers")));
+    const auto enabled = readControllers(base.filePath(QStringLiteral("cgroup.subtree_control")));
+    QByteArray toEnable;
+
+    for (const auto & controller : WantedControllers) {
+        if (available.contains(controller) && !enabled.contains(controller)) {
+            toEnable += " +" + controller.toLatin1();
+        }
+    }
+
+    if (!toEnable.isEmpty()) {
+        // controllers can't be enabled for children while the cgroup itself contains processes
+        if (!base.exists(TrayLeaf) && !base.mkdir(TrayLeaf)) {
+            return {};
+        }
+
+        const auto trayProcs = base.filePath(TrayLeaf + QStringLiteral("/cgroup.procs"));
+
+        for (const auto & pid : readFile(base.filePath(QStringLiteral("cgroup.procs"))).split('\n')) {
+            if (!pid.isEmpty() && !writeFile(trayProcs, pid)) {
+                return {};
+            }
+        }
+
+        if (!writeFile(base.filePath(QStringLiteral("cgroup.subtree_control")), toEnable.trimmed())) {
+            return {};
+        }
+    }
+
+    if (!base.exists(name) && !base.mkdir(name)) {
+        return {};
+    }
+
+    const auto path = base.filePath(name);
+    return CGroup(path, readControllers(path + QStringLiteral("/cgroup.controllers")));
+}
+
+
+bool CGroup::writeFile(const QString & file, const QByteArray & content) const
+{
+    return ::writeFile(m_path + QLatin1Char('/') + file, content);
+}
+
+
+bool CGroup::addProcess(qint64 pid) const
+{
+    return writeFile(QStringLiteral("cgroup.procs"), QByteArray::number(pid));
+}
+
+
+bool CGroup::setCpuMax(int percent) const
+{
+    if (!hasController(QStringLiteral("cpu"))) {
+        return 0 >= percent;
+    }
+
+    if (0 >= percent) {
+        return writeFile(QStringLiteral("cpu.max"), "max " + QByteArray::number(CpuMaxPeriod));
+    }
+
+    return writeFile(QStringLiteral("cpu.max"), QByteArray::number(static_cast<qint64>(percent) * CpuMaxPeriod / 100) + ' ' + QByteArray::number(CpuMaxPeriod));
+}
+
+
+bool CGroup::setCpuWeight(int weight) const
+{
+    if (!hasController(QStringLiteral("cpu"))) {
+        return DefaultCpuWeight == weight;
+    }
+
+    return writeFile(QStringLiteral("cpu.weight"), QByteArray::number(std::clamp(weight, 1, 10000)));
+}
+
+
+bool CGroup::setMemoryHigh(uint64_t bytes) const
+{
+    if (!hasController(QStringLiteral("memory"))) {
+        return 0 == bytes;
+    }
+
+    return writeFile(QStringLiteral("memory.high"), 0 == bytes ? QByteArray("max") : QByteArray::number(static_cast<qulonglong>(bytes)));
+}
+
+
+bool CGroup::setIoMax(const QString & limits) const
+{
+    if (!hasController(QStringLiteral("io"))) {
+        return limits.trimmed().isEmpty();
+    }
+
+    // io.max is per-device and only changes the keys written, so clear each existing entry first
+    for (const auto & line : ::readFile(m_path + QStringLiteral("/io.max")).split('\n')) {
+        if (const auto device = line.left(line.indexOf(' ')); !device.isEmpty()) {
+            writeFile(QStringLiteral("io.max"), device + " rbps=max wbps=max riops=max wiops=max");
+        }
+    }
+
+    bool success = true;
+
+    for (const auto & line : limits.split(QLatin1Char('\n'), Qt::SkipEmptyParts)) {
+        success = writeFile(QStringLiteral("io.max"), line.trimmed().toLatin1()) && success;
+    }
+
+    return success;
+}
+
+
+bool CGroup::setFrozen(bool frozen) const
+{
+    return writeFile(QStringLiteral("cgroup.freeze"), frozen ? "1" : "0");
+}
@@ -0,0 +1,95 @@
+/**
+ * CGroup.h
+ *
+ * Declaration of CGroup class.
+ */
+
+#ifndef ONEDRIVETRAY_CGROUP_H
+#define ONEDRIVETRAY_CGROUP_H
+
+#include <optional>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+namespace OneDrive
+{
+    /**
+     * A cgroup (v2) created for the onedrive client under the cgroup the tray is running in.
+     *
+     * This is only possible if the tray's cgroup has been delegated to the user (e.g. a systemd user service or scope
+     * with Delegate=yes). Because cgroup v2 does not allow processes in inner nodes once controllers are enabled for
+     * their children, the tray moves itself into a "tray" leaf alongside the client's cgroup.
+     *
+     * The setters return false if the limit could not be applied, including when its controller is not available.
+     * Removing a limit is always successful when the controller is not available.
+     */
+    class CGroup
+    {
+    public:
+        /**
+         * Create (or reuse) a child cgroup of the tray's own cgroup.
+         *
+         * @param name The name of the child cgroup.
+         *
+         * @return The cgroup, or nothing if the tray's cgroup is not delegated or cgroup v2 is not available.
+         */
+        [[nodiscard]] static std::optional<CGroup> create(const QString & name);
+
+        /** The full path to the cgroup directory. */
+        [[nodiscard]] inline const QString & path() const
+        {
+            return m_path;
+        }
+
+        /** Whether a controller (e.g. "cpu", "io", "memory") is enabled for the cgroup. */
+        [[nodiscard]] inline bool hasController(const QString & controller) const
+        {
+            return m_controllers.contains(controller);
+        }
+
+        /** Move a process (and all its threads) into the cgroup. */
+        bool addProcess(qint64 pid) const;
+
+        /**
+         * Set the CPU limit.
+         *
+         * @param percent The limit as a percentage of one CPU, 0 for no limit.
+         */
+        bool setCpuMax(int percent) const;
+
+        /**
+         * Set the CPU weight, the cgroup's share of the CPU when it competes with its siblings.
+         *
+         * @param weight The weight, 1 to 10000. 100 is the default.
+         */
+        bool setCpuWeight(int weight) const;
+
+        /**
+         * Set the memory throttling threshold.
+         *
+         * @param bytes The threshold, 0 for no limit.
+         */
+        bool setMemoryHigh(uint64_t bytes) const;
+
+        /**
+         * Set the I/O limits.
+         *
+         * @param limits One "MAJ:MIN key=value ..." line per device. Empty to remove all limits.
+         */
+        bool setIoMax(const QString & limits) const;
+
+        /** Freeze or thaw all processes in the cgroup. */
+        bool setFrozen(bool frozen) const;
+
+    private:
+        CGroup(QString path, QStringList controllers);
+
+        /** Write to one of the cgroup's interface files. */
+        bool writeFile(const QString & file, const QByteArray & content) const;
+
+        QString m_path;
+        QStringList m_controllers;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_CGROUP_H
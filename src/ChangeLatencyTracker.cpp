@@ -0,0 +1,334 @@
+/**
+ * ChangeLatencyTracker.cpp
+ *
+ * Implementation of ChangeLatencyTracker class.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QSocketNotifier>
+#include "ChangeLatencyTracker.h"
+#include "EventBus.h"
+#include "Process.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /** The events that indicate a local change, or that the set of watched directories needs updating. */
+    constexpr const uint32_t WatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+    /** The number of directories watched in each pass of the event loop while setting up. */
+    constexpr const int DirectoriesPerBatch = 256;
+
+    /** How long the client's own writes to a file it has downloaded are ignored for (ms). */
+    constexpr const qint64 DownloadGracePeriod = 60000;
+
+    /** Files onedrive skips by default (its skip_file default), which will never be uploaded. */
+    const QRegularExpression SkippedFiles(QStringLiteral(R"(^(~.*|\.~.*|.*\.tmp|.*\.swp|.*\.partial)$)"));
+}
+
+
+ChangeLatencyTracker::ChangeLatencyTracker(const Process & process, QObject * parent)
+        : QObject(parent),
+          m_process(process),
+          m_root(),
+          m_inotifyFd(-1),
+          m_notifier(nullptr),
+          m_watches(),
+          m_directoryQueue(),
+          m_directoryTimer(),
+          m_watchLimitReached(false),
+          m_clock(),
+          m_pending(),
+          m_recentDownloads(),
+          m_samples(),
+          m_nextSample(0)
+{
+    m_clock.start();
+    m_samples.reserve(SampleCapacity);
+    m_directoryTimer.setInterval(0);
+    connect(&m_directoryTimer, &QTimer::timeout, this, &ChangeLatencyTracker::watchQueuedDirectories);
+    connect(&process, &Process::fileUploaded, this, &ChangeLatencyTracker::onFileUploaded);
+    connect(&process, &Process::fileDownloaded, this, &ChangeLatencyTracker::onFileDownloaded);
+}
+
+
+ChangeLatencyTracker::~ChangeLatencyTracker()
+{
+    reset();
+}
+
+
+void ChangeLatencyTracker::reset()
+{
+    m_directoryTimer.stop();
+    delete m_notifier;
+    m_notifier = nullptr;
+
+    if (0 <= m_inotifyFd) {
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+    }
+
+    m_watches.clear();
+    m_directoryQueue.clear();
+    m_watchLimitReached = false;
+    m_pending.clear();
+    m_recentDownloads.clear();
+}
+
+
+void ChangeLatencyTracker::setRoot(const QString & root)
+{
+    reset();
+    m_root = QDir::cleanPath(root);
+
+    if (m_root.isEmpty() || !QDir(m_root).exists()) {
+        return;
+    }
+
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (0 > m_inotifyFd) {
+        return;
+    }
+
+    m_notifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &ChangeLatencyTracker::readEvents);
+    m_directoryQueue.enqueue(QString());
+    m_directoryTimer.start();
+    Q_EMIT statisticsChanged();
+}
+
+
+void ChangeLatencyTracker::watchQueuedDirectories()
+{
+    for (int count = 0; count < DirectoriesPerBatch && !m_directoryQueue.isEmpty(); ++count) {
+        const auto relativeDir = m_directoryQueue.dequeue();
+        const auto absoluteDir = relativeDir.isEmpty() ? m_root : m_root + QLatin1Char('/') + relativeDir;
+        const auto wd = inotify_add_watch(m_inotifyFd, QFile::encodeName(absoluteDir).constData(), WatchMask);
+
+        if (0 > wd) {
+            if (ENOSPC == errno) {
+                // the rest of the tree can't be watched either
+                m_watchLimitReached = true;
+                m_directoryQueue.clear();
+                break;
+            }
+
+            continue;
+        }
+
+        m_watches.insert(wd, relativeDir);
+        const auto prefix = relativeDir.isEmpty() ? QString() : relativeDir + QLatin1Char('/');
+
+        for (const auto & subdir : QDir(absoluteDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::NoSymLinks)) {
+            m_directoryQueue.enqueue(prefix + subdir);
+        }
+    }
+
+    if (m_directoryQueue.isEmpty()) {
+        m_directoryTimer.stop();
+    }
+}
+
+
+void ChangeLatencyTracker::readEvents()
+{
+    alignas(inotify_event) std::array<char, 64 * 1024> buffer;
+    bool changed = false;
+
+    while (true) {
+        const auto bytes = ::read(m_inotifyFd, buffer.data(), buffer.size());
+
+        if (0 >= bytes) {
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < bytes;) {
+            const auto * event = reinterpret_cast<const inotify_event *>(buffer.data() + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            if (event->mask & IN_IGNORED) {
+                m_watches.remove(event->wd);
+                continue;
+            }
+
+            const auto dirIt = m_watches.constFind(event->wd);
+
+            if (dirIt == m_watches.cend() || 0 == event->len) {
+                continue;
+            }
+
+            const auto name = QFile::decodeName(event->name);
+            const auto path = dirIt->isEmpty() ? name : *dirIt + QLatin1Char('/') + name;
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    m_directoryQueue.enqueue(path);
+
+                    if (!m_directoryTimer.isActive()) {
+                        m_directoryTimer.start();
+                    }
+                } else if (event->mask & IN_MOVED_FROM) {
+                    // the watches for the moved tree have stale paths; they're re-added if it's moved within the root
+                    forgetDirectory(path);
+                    changed = true;
+                }
+
+                continue;
+            }
+
+            if (SkippedFiles.match(name).hasMatch()) {
+                continue;
+            }
+
+            if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                recordChange(path);
+                changed = true;
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                // the client will delete or move the remote item rather than upload it
+                forgetChange(path);
+                changed = true;
+            }
+        }
+    }
+
+    if (changed) {
+        Q_EMIT statisticsChanged();
+    }
+}
+
+
+void ChangeLatencyTracker::recordChange(const QString & path)
+{
+    const auto now = m_clock.elapsed();
+
+    if (const auto downloadIt = m_recentDownloads.find(path); downloadIt != m_recentDownloads.end()) {
+        if (DownloadGracePeriod > now - *downloadIt) {
+            return;
+        }
+
+        m_recentDownloads.erase(downloadIt);
+    }
+
+    // the latency is measured from the first change the client hasn't yet picked up
+    if (!m_pending.contains(path) && MaximumPendingChanges > m_pending.size()) {
+        m_pending.insert(path, now);
+    }
+}
+
+
+void ChangeLatencyTracker::forgetChange(const QString & path)
+{
+    m_pending.remove(path);
+}
+
+
+void ChangeLatencyTracker::forgetDirectory(const QString & path)
+{
+    const auto prefix = path + QLatin1Char('/');
+
+    for (auto it = m_watches.begin(); it != m_watches.end();) {
+        if (*it == path || it->startsWith(prefix)) {
+            inotify_rm_watch(m_inotifyFd, it.key());
+            it = m_watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = m_pending.begin(); it != m_pending.end();) {
+        if (it.key().startsWith(prefix)) {
+            it = m_pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+void ChangeLatencyTracker::onFileUploaded(const QString & path)
+{
+    const auto it = m_pending.find(relativePath(path));
+
+    if (it == m_pending.end()) {
+        return;
+    }
+
+    // the time the client reported the upload, not when this got round to handling it
+    const auto latency = outputTime() - *it;
+    m_pending.erase(it);
+
+    if (SampleCapacity > m_samples.size()) {
+        m_samples.append(latency);
+    } else {
+        m_samples[m_nextSample] = latency;
+        m_nextSample = (m_nextSample + 1) % SampleCapacity;
+    }
+
+    Q_EMIT statisticsChanged();
+}
+
+
+void ChangeLatencyTracker::onFileDownloaded(const QString & path)
+{
+    const auto now = outputTime();
+    const auto relative = relativePath(path);
+    m_recentDownloads.insert(relative, now);
+
+    // expire old entries occasionally so the set stays small during large downloads
+    if (0 == m_recentDownloads.size() % 1024) {
+        for (auto it = m_recentDownloads.begin(); it != m_recentDownloads.end();) {
+            if (DownloadGracePeriod <= now - *it) {
+                it = m_recentDownloads.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    if (m_pending.remove(relative)) {
+        Q_EMIT statisticsChanged();
+    }
+}
+
+
+QString ChangeLatencyTracker::relativePath(const QString & path) const
+{
+    // normalised as the events are, so that a name with spaces at either end still matches the change recorded for it
+    auto relative = EventBus::normalisePath(path);
+
+    if (relative.startsWith(m_root + QLatin1Char('/'))) {
+        relative.remove(0, m_root.size() + 1);
+    }
+
+    return relative;
+}
+
+
+qint64 ChangeLatencyTracker::latencyPercentile(double percentile) const
+{
+    if (m_samples.isEmpty()) {
+        return -1;
+    }
+
+    auto samples = m_samples;
+    const auto index = std::clamp(static_cast<int>(std::ceil(percentile / 100.0 * samples.size())) - 1, 0, samples.size() - 1);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+
+qint64 ChangeLatencyTracker::outputTime() const
+{
+    return m_process.outputTimestamp().monotonicTime - m_clock.msecsSinceReference();
+}
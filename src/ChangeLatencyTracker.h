@@ -0,0 +1,149 @@
+/**
+ * ChangeLatencyTracker.h
+ *
+ * Declaration of ChangeLatencyTracker class.
+ */
+
+#ifndef ONEDRIVETRAY_CHANGELATENCYTRACKER_H
+#define ONEDRIVETRAY_CHANGELATENCYTRACKER_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QQueue>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+
+QT_BEGIN_NAMESPACE
+class QSocketNotifier;
+QT_END_NAMESPACE
+
+namespace OneDrive
+{
+    class Process;
+
+    /**
+     * Measures the time between a file being changed locally and the onedrive client uploading it.
+     *
+     * The local sync directory is watched with inotify and the time of each local modification is recorded until the
+     * client reports that it has uploaded the file. The files that have been changed but not yet uploaded are the
+     * backlog. Files the client has just downloaded are ignored so that its own writes aren't counted as local changes.
+     */
+    class ChangeLatencyTracker
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** The number of recent latencies kept for calculating percentiles. */
+        static constexpr const int SampleCapacity = 1024;
+
+        /** The maximum number of unsynchronised local changes that are tracked. */
+        static constexpr const int MaximumPendingChanges = 100000;
+
+        explicit ChangeLatencyTracker(const Process & process, QObject * parent = nullptr);
+
+        ~ChangeLatencyTracker() override;
+
+        /**
+         * Start watching a local sync directory.
+         *
+         * Any existing watches and pending changes are discarded. The directory tree is watched incrementally from the
+         * event loop so that a large tree doesn't block the UI.
+         *
+         * @param root The local sync directory.
+         */
+        void setRoot(const QString & root);
+
+        /** The number of local changes that have not yet been uploaded. */
+        [[nodiscard]] inline int pendingChanges() const
+        {
+            return m_pending.size();
+        }
+
+        /** The number of latency samples available. */
+        [[nodiscard]] inline int sampleCount() const
+        {
+            return m_samples.size();
+        }
+
+        /**
+         * Calculate a percentile of the recent change-to-upload latencies.
+         *
+         * @param percentile The percentile, 0 to 100.
+         *
+         * @return The latency (ms), or -1 if there are no samples.
+         */
+        [[nodiscard]] qint64 latencyPercentile(double percentile) const;
+
+        /** Whether the inotify watch limit stopped part of the tree from being watched. */
+        [[nodiscard]] inline bool watchLimitReached() const
+        {
+            return m_watchLimitReached;
+        }
+
+    Q_SIGNALS:
+        /** Emitted when the pending change count or latency samples change. */
+        void statisticsChanged();
+
+    private:
+        /** Close the inotify instance and forget all watches and changes. */
+        void reset();
+
+        /** Add watches for a batch of queued directories, rescheduling if there are more. */
+        void watchQueuedDirectories();
+
+        /** Read and handle the available inotify events. */
+        void readEvents();
+
+        /** Record a local change to a file (path relative to the root). */
+        void recordChange(const QString & path);
+
+        /** Forget a pending change to a file (path relative to the root). */
+        void forgetChange(const QString & path);
+
+        /** Stop watching a directory tree that has been moved away, and forget its pending changes. */
+        void forgetDirectory(const QString & path);
+
+        /** Handle the client reporting an upload. */
+        void onFileUploaded(const QString & path);
+
+        /** Handle the client reporting a download. */
+        void onFileDownloaded(const QString & path);
+
+        /** Normalise a path reported by the client to be relative to the root. */
+        [[nodiscard]] QString relativePath(const QString & path) const;
+
+        /** The time (on m_clock) at which the client's output currently being handled was read. */
+        [[nodiscard]] qint64 outputTime() const;
+
+        const Process & m_process;
+        QString m_root;
+        int m_inotifyFd;
+        QSocketNotifier * m_notifier;
+
+        /** The directory (relative to the root) for each watch descriptor. */
+        QHash<int, QString> m_watches;
+
+        /** Directories (relative to the root) yet to be watched. */
+        QQueue<QString> m_directoryQueue;
+        QTimer m_directoryTimer;
+        bool m_watchLimitReached;
+
+        /** Monotonic clock used to timestamp changes. */
+        QElapsedTimer m_clock;
+
+        /** The time (on m_clock) of the first unsynchronised change to each file. */
+        QHash<QString, qint64> m_pending;
+
+        /** The time (on m_clock) at which the client last downloaded each recently downloaded file. */
+        QHash<QString, qint64> m_recentDownloads;
+
+        /** Ring buffer of recent latencies (ms). */
+        QVector<qint64> m_samples;
+        int m_nextSample;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_CHANGELATENCYTRACKER_H
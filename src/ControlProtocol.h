@@ -0,0 +1,130 @@
+/**
+ * ControlProtocol.h
+ *
+ * Definitions shared by the control server in the tray and the onedrive-tray-ctl client.
+ *
+ * This header doesn't use Qt so that the client can be built without it.
+ *
+ * The protocol is line based. The client sends one command line, terminated by '\n'. The server replies with zero or
+ * more lines of output followed by a line that is either "OK" or "ERROR <message>". The exception is "watch", whose
+ * output continues until the client disconnects. Newlines, tabs and backslashes in values are escaped as "\n", "\t"
+ * and "\\".
+ */
+
+#ifndef ONEDRIVETRAY_CONTROLPROTOCOL_H
+#define ONEDRIVETRAY_CONTROLPROTOCOL_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+namespace OneDrive::ControlProtocol
+{
+    /** The longest command line the server accepts, in bytes. */
+    constexpr const int MaximumCommandLength = 4096;
+
+    /** Show the state, status, free space and whether the client is running or paused. */
+    constexpr const char * const StatusCommand = "status";
+
+    /** Stream the events and status changes as they happen. */
+    constexpr const char * const WatchCommand = "watch";
+
+    /** Pause synchronisation, optionally followed by a number of seconds. */
+    constexpr const char * const PauseCommand = "pause";
+
+    /** Resume paused synchronisation. */
+    constexpr const char * const ResumeCommand = "resume";
+
+    /** Show the recent events for a path, which follows the command. */
+    constexpr const char * const HistoryCommand = "history";
+
+    /** Show the transfer, error, latency and local folder statistics. */
+    constexpr const char * const StatsCommand = "stats";
+
+    constexpr const char * const OkResponse = "OK";
+    constexpr const char * const ErrorResponse = "ERROR";
+
+    /**
+     * The directory containing the control socket.
+     *
+     * This is in the user's runtime directory, or a per-user directory in /tmp if there isn't one.
+     */
+    inline std::string socketDirectory()
+    {
+        if (const auto * runtimeDirectory = std::getenv("XDG_RUNTIME_DIR"); runtimeDirectory && *runtimeDirectory) {
+            return std::string(runtimeDirectory) + "/onedrive-tray";
+        }
+
+        return "/tmp/onedrive-tray-" + std::to_string(::getuid());
+    }
+
+    /** The onedrive client's default config directory. */
+    inline std::string defaultConfigDirectory()
+    {
+        if (const auto * configHome = std::getenv("XDG_CONFIG_HOME"); configHome && '/' == *configHome) {
+            return std::string(configHome) + "/onedrive";
+        }
+
+        if (const auto * home = std::getenv("HOME"); home) {
+            return std::string(home) + "/.config/onedrive";
+        }
+
+        return {};
+    }
+
+    /**
+     * Identify the instance of the tray for a onedrive config directory.
+     *
+     * The instance's control socket, status page, session snapshot and D-Bus name are all named with the key, so that
+     * instances for different config directories don't collide. The key for the client's default config directory is
+     * empty, so that readers that know nothing about config directories still find that instance. Any other directory's
+     * key is a hash of its canonical path.
+     */
+    inline std::string instanceKey(const std::string & configDirectory, const std::string & defaultDirectory = defaultConfigDirectory())
+    {
+        // the same directory can be named in many ways, and it might not exist yet
+        const auto canonical = [](const std::string & path) -> std::string {
+            if (auto * resolved = ::realpath(path.c_str(), nullptr)) {
+                std::string result(resolved);
+                std::free(resolved);
+                return result;
+            }
+
+            auto result = path;
+
+            while (1 < result.size() && '/' == result.back()) {
+                result.pop_back();
+            }
+
+            return result;
+        };
+
+        const auto directory = canonical(configDirectory);
+
+        if (directory == canonical(defaultDirectory)) {
+            return {};
+        }
+
+        // FNV-1a, which is plenty to tell apart the few config directories one user has
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+
+        for (const auto byte : directory) {
+            hash ^= static_cast<unsigned char>(byte);
+            hash *= 0x100000001b3ull;
+        }
+
+        char key[17];
+        std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+        return key;
+    }
+
+    /** The path of the control socket for an instance. */
+    inline std::string socketPath(const std::string & instanceKey = {})
+    {
+        return socketDirectory() + "/control" + (instanceKey.empty() ? std::string() : "-" + instanceKey);
+    }
+}
+
+#endif //ONEDRIVETRAY_CONTROLPROTOCOL_H
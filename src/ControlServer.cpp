@@ -0,0 +1,377 @@
+/**
+ * ControlServer.cpp
+ *
+ * Implementation of ControlServer class.
+ */
+
+#include <cmath>
+#include <limits>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtNetwork/QLocalSocket>
+#include "ControlServer.h"
+#include "ControlProtocol.h"
+#include "SynchronisationService.h"
+#include "Logger.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /** How long to wait when checking whether another instance is listening on the socket (ms). */
+    constexpr const int ProbeTimeout = 100;
+
+    /** Escape a value so that it can't break the line structure of a response. */
+    QByteArray escape(const QString & value)
+    {
+        auto escaped = value.toUtf8();
+        escaped.replace('\\', "\\\\");
+        escaped.replace('\n', "\\n");
+        escaped.replace('\t', "\\t");
+        return escaped;
+    }
+
+    QByteArray field(const char * name, const QString & value)
+    {
+        return QByteArray(name) + '=' + escape(value) + '\n';
+    }
+
+    QByteArray field(const char * name, qint64 value)
+    {
+        return QByteArray(name) + '=' + QByteArray::number(value) + '\n';
+    }
+
+    QByteArray field(const char * name, quint64 value)
+    {
+        return QByteArray(name) + '=' + QByteArray::number(value) + '\n';
+    }
+
+    QByteArray field(const char * name, bool value)
+    {
+        return QByteArray(name) + '=' + (value ? "1" : "0") + '\n';
+    }
+
+    /** Format an event as a tab-separated line: time, type, path and detail. */
+    QByteArray formatEvent(const EventBus::Event & event)
+    {
+        return QDateTime::fromMSecsSinceEpoch(event.time).toString(Qt::ISODateWithMs).toUtf8()
+               + '\t' + EventBus::typeName(event.type).toUtf8()
+               + '\t' + escape(event.path)
+               + '\t' + escape(event.detail)
+               + '\n';
+    }
+}
+
+
+ControlServer::ControlServer(SynchronisationService & service, QObject * parent)
+        : QObject(parent),
+          m_service(service),
+          m_server(),
+          m_buffers(),
+          m_watchers()
+{
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+    connect(&m_server, &QLocalServer::newConnection, this, &ControlServer::onNewConnection);
+    connect(&m_service, &SynchronisationService::statusChanged, this, &ControlServer::onStatusChanged);
+
+    m_service.eventBus().subscribe(this, EventHistory::RecordedEventTypes, {}, [this](const EventBus::Batch & events) {
+        onEventsPublished(events);
+    });
+}
+
+
+ControlServer::~ControlServer() = default;
+
+
+bool ControlServer::listen()
+{
+    if (m_server.isListening()) {
+        return true;
+    }
+
+    const auto directory = QString::fromStdString(ControlProtocol::socketDirectory());
+
+    if (!QDir().mkpath(directory)) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to create the control socket directory %1").arg(directory));
+        return false;
+    }
+
+    QFile::setPermissions(directory, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    const auto path = QString::fromStdString(ControlProtocol::socketPath(m_service.instanceKey().toStdString()));
+
+    // the instance lock keeps out other instances for the same config directory, but one that predates it might be here
+    QLocalSocket probe;
+    probe.connectToServer(path);
+
+    if (probe.waitForConnected(ProbeTimeout)) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("another instance is listening on the control socket %1").arg(path));
+        return false;
+    }
+
+    // a socket left behind by an instance that crashed would otherwise stop the server listening
+    QLocalServer::removeServer(path);
+
+    if (!m_server.listen(path)) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to listen on the control socket %1: %2").arg(path, m_server.errorString()));
+        return false;
+    }
+
+    return true;
+}
+
+
+void ControlServer::onNewConnection()
+{
+    while (auto * socket = m_server.nextPendingConnection()) {
+        m_buffers.insert(socket, {});
+
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            onReadyRead(socket);
+        });
+
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            m_buffers.remove(socket);
+            m_watchers.removeOne(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+
+void ControlServer::onReadyRead(QLocalSocket * socket)
+{
+    auto buffer = m_buffers.find(socket);
+
+    if (buffer == m_buffers.end()) {
+        // already answered - anything else the client sends is ignored
+        socket->readAll();
+        return;
+    }
+
+    buffer->append(socket->readAll());
+    const auto end = buffer->indexOf('\n');
+
+    if (0 > end) {
+        if (ControlProtocol::MaximumCommandLength < buffer->size()) {
+            m_buffers.erase(buffer);
+            fail(socket, QStringLiteral("command too long"));
+        }
+
+        return;
+    }
+
+    // not trimmed, because the path given to "history" can end with a space
+    const auto command = QString::fromUtf8(buffer->left(end));
+    m_buffers.erase(buffer);
+    handleCommand(socket, command);
+}
+
+
+void ControlServer::handleCommand(QLocalSocket * socket, const QString & command)
+{
+    const auto separator = command.indexOf(QLatin1Char(' '));
+    const auto name = (0 > separator ? command : command.left(separator)).trimmed();
+    const auto argument = (0 > separator ? QString() : command.mid(separator + 1));
+
+    if (ControlProtocol::StatusCommand == name) {
+        writeStatus(socket);
+        finish(socket);
+    } else if (ControlProtocol::StatsCommand == name) {
+        writeStatistics(socket);
+        finish(socket);
+    } else if (ControlProtocol::HistoryCommand == name) {
+        writeHistory(socket, argument);
+        finish(socket);
+    } else if (ControlProtocol::WatchCommand == name) {
+        socket->write("status\t" + escape(m_service.status()) + '\n');
+        m_watchers.append(socket);
+    } else if (ControlProtocol::PauseCommand == name) {
+        const auto duration = argument.trimmed();
+        auto seconds = 0u;
+
+        if (!duration.isEmpty()) {
+            bool ok;
+            seconds = duration.toUInt(&ok);
+
+            if (!ok || 0 == seconds || static_cast<uint>(std::numeric_limits<int>::max() / 1000) < seconds) {
+                fail(socket, QStringLiteral("invalid duration %1").arg(duration));
+                return;
+            }
+        }
+
+        if (!m_service.process().isRunning()) {
+            fail(socket, QStringLiteral("onedrive is not running"));
+            return;
+        }
+
+        m_service.pauseSynchronisation(static_cast<int>(seconds * 1000));
+
+        if (!m_service.process().isPaused()) {
+            fail(socket, QStringLiteral("onedrive could not be paused"));
+            return;
+        }
+
+        finish(socket);
+    } else if (ControlProtocol::ResumeCommand == name) {
+        m_service.resumeSynchronisation();
+
+        if (m_service.process().isPaused()) {
+            fail(socket, QStringLiteral("onedrive could not be resumed"));
+            return;
+        }
+
+        finish(socket);
+    } else {
+        fail(socket, QStringLiteral("unknown command %1").arg(name));
+    }
+}
+
+
+void ControlServer::writeStatus(QLocalSocket * socket) const
+{
+    const auto & process = m_service.process();
+    QByteArray response;
+    response += field("state", m_service.stateName());
+    response += field("status", m_service.status());
+    response += field("running", process.isRunning());
+    response += field("paused", process.isRunning() && process.isPaused());
+    response += field("free-space", m_service.freeSpace());
+
+    if (const auto resumeTime = m_service.resumeTime(); resumeTime.isValid()) {
+        response += field("paused-until", resumeTime.toString(Qt::ISODate));
+    }
+
+    socket->write(response);
+}
+
+
+void ControlServer::writeStatistics(QLocalSocket * socket) const
+{
+    const auto & errors = m_service.errorClassifier();
+    const auto & latency = m_service.latencyTracker();
+    const auto & scanner = m_service.directoryScanner();
+    const auto & throttle = m_service.throttleMonitor();
+    quint64 totalErrors = 0;
+    quint64 recentErrors = 0;
+
+    for (int index = 0; index < ErrorClassifier::ErrorClassCount; ++index) {
+        totalErrors += errors.totalCount(static_cast<ErrorClass>(index));
+        recentErrors += errors.recentCount(static_cast<ErrorClass>(index));
+    }
+
+    QByteArray response;
+    response += field("uploaded", m_service.uploadCount());
+    response += field("downloaded", m_service.downloadCount());
+    response += field("deleted", m_service.deleteCount());
+    response += field("errors", totalErrors);
+    response += field("recent-errors", recentErrors);
+    response += field("pending-changes", static_cast<qint64>(latency.pendingChanges()));
+    response += field("latency-median-ms", latency.latencyPercentile(50));
+    response += field("latency-p99-ms", latency.latencyPercentile(99));
+    response += field("throttled", throttle.totals().throttleCount);
+    response += field("retries", throttle.totals().retryCount);
+    response += field("backoff-ms", throttle.totals().backoffTime);
+    response += field("last-cycle-backoff-ms", throttle.lastCycle().backoffTime);
+    response += field("last-cycle-throughput-loss-percent", static_cast<qint64>(std::lround(ThrottleMonitor::throughputLoss(throttle.lastCycle()) * 100.0)));
+
+    if (const auto & resources = m_service.resourceMonitor(); resources.hasUsage()) {
+        const auto & usage = resources.usage();
+        response += field("cpu-percent", QString::number(usage.cpuPercent, 'f', 1));
+        response += field("resident-bytes", usage.residentBytes);
+        response += field("threads", static_cast<qint64>(usage.threadCount));
+        response += field("read-bytes", usage.readBytes);
+        response += field("written-bytes", usage.writtenBytes);
+    }
+
+    if (scanner.hasTotals()) {
+        response += field("local-files", static_cast<quint64>(scanner.fileCount()));
+        response += field("local-directories", static_cast<quint64>(scanner.directoryCount()));
+        response += field("local-bytes", static_cast<quint64>(scanner.totalBytes()));
+    }
+
+    socket->write(response);
+}
+
+
+void ControlServer::writeHistory(QLocalSocket * socket, const QString & path) const
+{
+    auto relativePath = path;
+    const auto & root = m_service.syncDirectory();
+
+    // accept absolute paths inside the sync directory as well as the relative paths the client reports
+    if (!root.isEmpty() && (relativePath == root || relativePath.startsWith(root + QLatin1Char('/')))) {
+        relativePath = relativePath.mid(root.size() + 1);
+    }
+
+    QByteArray response;
+
+    for (const auto & event : m_service.eventHistory().eventsFor(relativePath)) {
+        response += formatEvent(event);
+    }
+
+    socket->write(response);
+}
+
+
+void ControlServer::onEventsPublished(const EventBus::Batch & events)
+{
+    if (m_watchers.isEmpty()) {
+        return;
+    }
+
+    QByteArray lines;
+
+    for (const auto & event : events) {
+        lines += "event\t" + formatEvent(event);
+    }
+
+    writeToWatchers(lines);
+}
+
+
+void ControlServer::onStatusChanged(const QString & status)
+{
+    if (m_watchers.isEmpty()) {
+        return;
+    }
+
+    writeToWatchers("status\t" + escape(status) + '\n');
+}
+
+
+void ControlServer::writeToWatchers(const QByteArray & line)
+{
+    QList<QLocalSocket *> stalled;
+
+    for (auto * socket : m_watchers) {
+        if (MaximumWatchBacklog < socket->bytesToWrite()) {
+            stalled.append(socket);
+            continue;
+        }
+
+        socket->write(line);
+    }
+
+    // a watcher that has stopped reading would otherwise make the tray's memory grow without limit
+    for (auto * socket : stalled) {
+        m_watchers.removeOne(socket);
+        socket->abort();
+    }
+}
+
+
+void ControlServer::finish(QLocalSocket * socket)
+{
+    socket->write(ControlProtocol::OkResponse);
+    socket->write("\n");
+    socket->disconnectFromServer();
+}
+
+
+void ControlServer::fail(QLocalSocket * socket, const QString & message)
+{
+    socket->write(ControlProtocol::ErrorResponse);
+    socket->write(" " + escape(message) + '\n');
+    socket->disconnectFromServer();
+}
@@ -0,0 +1,91 @@
+/**
+ * ControlServer.h
+ *
+ * Declaration of ControlServer class.
+ */
+
+#ifndef ONEDRIVETRAY_CONTROLSERVER_H
+#define ONEDRIVETRAY_CONTROLSERVER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtNetwork/QLocalServer>
+#include "EventHistory.h"
+
+QT_BEGIN_NAMESPACE
+class QLocalSocket;
+QT_END_NAMESPACE
+
+namespace OneDrive
+{
+    class SynchronisationService;
+
+    /**
+     * Answers onedrive-tray-ctl over a local socket.
+     *
+     * Every answer is built from state the service already holds, so a query never waits for the onedrive client. See
+     * ControlProtocol.h for the protocol.
+     */
+    class ControlServer
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** A watcher that has this much output waiting to be read is disconnected. */
+        static constexpr const qint64 MaximumWatchBacklog = 1024 * 1024;
+
+        explicit ControlServer(SynchronisationService & service, QObject * parent = nullptr);
+
+        ~ControlServer() override;
+
+        /**
+         * Start listening on the control socket.
+         *
+         * @return false if the socket can't be created, in which case the reason is logged.
+         */
+        bool listen();
+
+    private:
+        /** Accept the waiting connections. */
+        void onNewConnection();
+
+        /** Read from a client and answer its command once it is complete. */
+        void onReadyRead(QLocalSocket * socket);
+
+        /** Answer a command. */
+        void handleCommand(QLocalSocket * socket, const QString & command);
+
+        void writeStatus(QLocalSocket * socket) const;
+        void writeStatistics(QLocalSocket * socket) const;
+        void writeHistory(QLocalSocket * socket, const QString & path) const;
+
+        /** Send a batch of events to the watchers. */
+        void onEventsPublished(const EventBus::Batch & events);
+
+        /** Send the status to the watchers. */
+        void onStatusChanged(const QString & status);
+
+        /** Send a line to the watchers, dropping any that aren't keeping up. */
+        void writeToWatchers(const QByteArray & line);
+
+        /** Finish a response with OK and close the connection. */
+        static void finish(QLocalSocket * socket);
+
+        /** Finish a response with an error and close the connection. */
+        static void fail(QLocalSocket * socket, const QString & message);
+
+        SynchronisationService & m_service;
+        QLocalServer m_server;
+
+        /** The partial command lines received from the clients. */
+        QHash<QLocalSocket *, QByteArray> m_buffers;
+
+        /** The clients running "watch". */
+        QList<QLocalSocket *> m_watchers;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_CONTROLSERVER_H
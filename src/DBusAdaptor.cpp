@@ -0,0 +1,319 @@
+/**
+ * DBusAdaptor.cpp
+ *
+ * Implementation of DBusAdaptor class.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <QtCore/QVariantMap>
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusError>
+#include <QtDBus/QDBusMessage>
+#include "DBusAdaptor.h"
+#include "SynchronisationService.h"
+#include "Logger.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    const QString PropertiesInterface = QStringLiteral("org.freedesktop.DBus.Properties");
+    const QString Interface = QStringLiteral("dev.equit.OneDriveTray");
+
+    /** The properties that change when the process starts, stops, pauses, resumes or changes phase. */
+    const QStringList ProcessStateProperties = {
+            QStringLiteral("State"),
+            QStringLiteral("StateDescription"),
+            QStringLiteral("Running"),
+            QStringLiteral("Paused"),
+    };
+}
+
+
+const QString DBusAdaptor::ServiceName = QStringLiteral("dev.equit.OneDriveTray");
+const QString DBusAdaptor::ObjectPath = QStringLiteral("/dev/equit/OneDriveTray");
+
+
+DBusAdaptor::DBusAdaptor(SynchronisationService * service)
+        : QDBusAbstractAdaptor(service),
+          m_service(*service),
+          m_registered(false),
+          m_changedProperties(),
+          m_propertiesChangedTimer()
+{
+    m_propertiesChangedTimer.setSingleShot(true);
+    m_propertiesChangedTimer.setInterval(PropertiesChangedDelay);
+    connect(&m_propertiesChangedTimer, &QTimer::timeout, this, &DBusAdaptor::emitPropertiesChanged);
+
+    connect(&m_service, &SynchronisationService::stateChanged, this, &DBusAdaptor::markProcessStateChanged);
+
+    connect(&m_service, &SynchronisationService::statusChanged, this, [this]() {
+        markChanged(QStringLiteral("Status"));
+    });
+
+    connect(&m_service, &SynchronisationService::statisticsChanged, this, [this]() {
+        // cheap to send, so there's no need to track which of them actually changed
+        markChanged(QStringLiteral("FreeSpace"));
+        markChanged(QStringLiteral("FilesUploaded"));
+        markChanged(QStringLiteral("FilesDownloaded"));
+        markChanged(QStringLiteral("ItemsDeleted"));
+    });
+
+    connect(&m_service.errorClassifier(), &ErrorClassifier::statisticsChanged, this, [this]() {
+        markChanged(QStringLiteral("Errors"));
+    });
+
+    connect(&m_service.throttleMonitor(), &ThrottleMonitor::statisticsChanged, this, [this]() {
+        markChanged(QStringLiteral("ThrottledResponses"));
+        markChanged(QStringLiteral("Retries"));
+        markChanged(QStringLiteral("BackoffTime"));
+        markChanged(QStringLiteral("LastCycleThroughputLoss"));
+    });
+
+    connect(&m_service.resourceMonitor(), &ResourceMonitor::usageUpdated, this, [this]() {
+        markChanged(QStringLiteral("CpuUsage"));
+        markChanged(QStringLiteral("ResidentMemory"));
+        markChanged(QStringLiteral("Threads"));
+        markChanged(QStringLiteral("BytesRead"));
+        markChanged(QStringLiteral("BytesWritten"));
+    });
+}
+
+
+DBusAdaptor::~DBusAdaptor() = default;
+
+
+bool DBusAdaptor::registerOnSessionBus()
+{
+    if (m_registered) {
+        return true;
+    }
+
+    auto bus = QDBusConnection::sessionBus();
+
+    if (!bus.isConnected()) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("no session bus, the D-Bus interface is not available: %1").arg(bus.lastError().message()));
+        return false;
+    }
+
+    if (!bus.registerObject(ObjectPath, parent(), QDBusConnection::ExportAdaptors)) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to register the D-Bus object: %1").arg(bus.lastError().message()));
+        return false;
+    }
+
+    const auto name = serviceName(m_service.instanceKey());
+
+    if (!bus.registerService(name)) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to register the D-Bus service %1: %2").arg(name, bus.lastError().message()));
+        bus.unregisterObject(ObjectPath);
+        return false;
+    }
+
+    m_registered = true;
+    return true;
+}
+
+
+QString DBusAdaptor::serviceName(const QString & instanceKey)
+{
+    // an element of a bus name can't start with a digit, which the hex key might
+    return instanceKey.isEmpty() ? ServiceName : ServiceName + QStringLiteral(".Instance") + instanceKey;
+}
+
+
+QString DBusAdaptor::state() const
+{
+    return m_service.stateName();
+}
+
+
+QString DBusAdaptor::stateDescription() const
+{
+    const auto & process = m_service.process();
+    return Process::synchronisationStateName(process.isRunning() ? process.synchronisationState() : Process::SynchronisationState::Stopped);
+}
+
+
+QString DBusAdaptor::status() const
+{
+    return m_service.status();
+}
+
+
+bool DBusAdaptor::isRunning() const
+{
+    return m_service.process().isRunning();
+}
+
+
+bool DBusAdaptor::isPaused() const
+{
+    const auto & process = m_service.process();
+    return process.isRunning() && process.isPaused();
+}
+
+
+qlonglong DBusAdaptor::freeSpace() const
+{
+    return m_service.freeSpace();
+}
+
+
+qulonglong DBusAdaptor::filesUploaded() const
+{
+    return m_service.uploadCount();
+}
+
+
+qulonglong DBusAdaptor::filesDownloaded() const
+{
+    return m_service.downloadCount();
+}
+
+
+qulonglong DBusAdaptor::itemsDeleted() const
+{
+    return m_service.deleteCount();
+}
+
+
+qulonglong DBusAdaptor::errors() const
+{
+    return m_service.errorClassifier().totalCount();
+}
+
+
+qulonglong DBusAdaptor::throttledResponses() const
+{
+    return m_service.throttleMonitor().totals().throttleCount;
+}
+
+
+qulonglong DBusAdaptor::retries() const
+{
+    return m_service.throttleMonitor().totals().retryCount;
+}
+
+
+qlonglong DBusAdaptor::backoffTime() const
+{
+    return m_service.throttleMonitor().totals().backoffTime;
+}
+
+
+uint DBusAdaptor::lastCycleThroughputLoss() const
+{
+    return static_cast<uint>(std::lround(ThrottleMonitor::throughputLoss(m_service.throttleMonitor().lastCycle()) * 100.0));
+}
+
+
+double DBusAdaptor::cpuUsage() const
+{
+    return m_service.resourceMonitor().usage().cpuPercent;
+}
+
+
+qulonglong DBusAdaptor::residentMemory() const
+{
+    return m_service.resourceMonitor().usage().residentBytes;
+}
+
+
+uint DBusAdaptor::threads() const
+{
+    return static_cast<uint>(m_service.resourceMonitor().usage().threadCount);
+}
+
+
+qulonglong DBusAdaptor::bytesRead() const
+{
+    return m_service.resourceMonitor().usage().readBytes;
+}
+
+
+qulonglong DBusAdaptor::bytesWritten() const
+{
+    return m_service.resourceMonitor().usage().writtenBytes;
+}
+
+
+bool DBusAdaptor::Pause()
+{
+    if (!m_service.process().isRunning()) {
+        return false;
+    }
+
+    m_service.pauseSynchronisation();
+    return m_service.process().isPaused();
+}
+
+
+bool DBusAdaptor::PauseFor(uint seconds)
+{
+    if (!m_service.process().isRunning()) {
+        return false;
+    }
+
+    const auto duration = std::min<quint64>(static_cast<quint64>(seconds) * 1000, std::numeric_limits<int>::max());
+    m_service.pauseSynchronisation(static_cast<int>(duration));
+    return m_service.process().isPaused();
+}
+
+
+void DBusAdaptor::Resume()
+{
+    m_service.resumeSynchronisation();
+}
+
+
+void DBusAdaptor::Restart()
+{
+    m_service.restart();
+}
+
+
+void DBusAdaptor::Stop()
+{
+    m_service.stop();
+}
+
+
+void DBusAdaptor::markChanged(const QString & property)
+{
+    m_changedProperties.insert(property);
+
+    // not restarted by later changes, so a steady stream of changes is still signalled every PropertiesChangedDelay
+    if (!m_propertiesChangedTimer.isActive()) {
+        m_propertiesChangedTimer.start();
+    }
+}
+
+
+void DBusAdaptor::markProcessStateChanged()
+{
+    for (const auto & property : ProcessStateProperties) {
+        markChanged(property);
+    }
+}
+
+
+void DBusAdaptor::emitPropertiesChanged()
+{
+    if (!m_registered || m_changedProperties.isEmpty()) {
+        m_changedProperties.clear();
+        return;
+    }
+
+    QVariantMap changed;
+
+    for (const auto & property : m_changedProperties) {
+        changed.insert(property, this->property(property.toLatin1().constData()));
+    }
+
+    m_changedProperties.clear();
+    auto signal = QDBusMessage::createSignal(ObjectPath, PropertiesInterface, QStringLiteral("PropertiesChanged"));
+    signal << Interface << changed << QStringList();
+    QDBusConnection::sessionBus().send(signal);
+}
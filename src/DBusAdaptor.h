@@ -0,0 +1,161 @@
+/**
+ * DBusAdaptor.h
+ *
+ * Declaration of DBusAdaptor class.
+ */
+
+#ifndef ONEDRIVETRAY_DBUSADAPTOR_H
+#define ONEDRIVETRAY_DBUSADAPTOR_H
+
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include <QtDBus/QDBusAbstractAdaptor>
+
+namespace OneDrive
+{
+    class SynchronisationService;
+
+    /**
+     * Publishes the synchronisation service on the session bus.
+     *
+     * The service is registered as dev.equit.OneDriveTray with the object at /dev/equit/OneDriveTray. Its properties
+     * describe what the onedrive client is doing, and org.freedesktop.DBus.Properties.PropertiesChanged is emitted
+     * when they change so that clients don't need to poll. Changes are collected for up to PropertiesChangedDelay
+     * and sent together, so a burst of transfers results in a few signals rather than one per file.
+     */
+    class DBusAdaptor
+            : public QDBusAbstractAdaptor
+    {
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "dev.equit.OneDriveTray")
+
+    /** The synchronisation state: stopped, idle, starting, scanning-local, fetching-remote, transferring or error. */
+    Q_PROPERTY(QString State READ state)
+
+    /** The synchronisation state, translated for display. */
+    Q_PROPERTY(QString StateDescription READ stateDescription)
+
+    /** A one-line, translated description of what the client is doing. */
+    Q_PROPERTY(QString Status READ status)
+
+    Q_PROPERTY(bool Running READ isRunning)
+    Q_PROPERTY(bool Paused READ isPaused)
+
+    /** The free space in the OneDrive account in bytes, or -1 if the client hasn't reported it. */
+    Q_PROPERTY(qlonglong FreeSpace READ freeSpace)
+
+    Q_PROPERTY(qulonglong FilesUploaded READ filesUploaded)
+    Q_PROPERTY(qulonglong FilesDownloaded READ filesDownloaded)
+    Q_PROPERTY(qulonglong ItemsDeleted READ itemsDeleted)
+
+    /** The number of errors the client has reported. */
+    Q_PROPERTY(qulonglong Errors READ errors)
+
+    /** The number of HTTP 429 and 503 responses the client has reported. */
+    Q_PROPERTY(qulonglong ThrottledResponses READ throttledResponses)
+
+    /** The number of requests the client has reported retrying. */
+    Q_PROPERTY(qulonglong Retries READ retries)
+
+    /** The total time the server has told the client to wait before retrying, in ms. */
+    Q_PROPERTY(qlonglong BackoffTime READ backoffTime)
+
+    /** The percentage of the last synchronisation cycle spent waiting to retry. */
+    Q_PROPERTY(uint LastCycleThroughputLoss READ lastCycleThroughputLoss)
+
+    /** The client's CPU usage over the last sample, as a percentage of one core. 0 while it isn't running. */
+    Q_PROPERTY(double CpuUsage READ cpuUsage)
+
+    /** The client's resident set size in bytes. */
+    Q_PROPERTY(qulonglong ResidentMemory READ residentMemory)
+
+    Q_PROPERTY(uint Threads READ threads)
+
+    /** The bytes the client has read from storage. */
+    Q_PROPERTY(qulonglong BytesRead READ bytesRead)
+
+    /** The bytes the client has written to storage. */
+    Q_PROPERTY(qulonglong BytesWritten READ bytesWritten)
+
+    public:
+        /** The well-known name the service is registered as by the instance for the default config directory. */
+        static const QString ServiceName;
+
+        /** The path of the published object. */
+        static const QString ObjectPath;
+
+        /** The longest a property change is held back before it is signalled (ms). */
+        static constexpr const int PropertiesChangedDelay = 250;
+
+        explicit DBusAdaptor(SynchronisationService * service);
+
+        ~DBusAdaptor() override;
+
+        /**
+         * Register the service and its object on the session bus.
+         *
+         * The instance for the default config directory is registered as ServiceName, any other instance as
+         * serviceName() for its instance key.
+         *
+         * @return false if there is no session bus or the name is already taken, in which case the reason is logged.
+         */
+        bool registerOnSessionBus();
+
+        /** The well-known name of the instance with a given key, from SynchronisationService::instanceKey(). */
+        [[nodiscard]] static QString serviceName(const QString & instanceKey);
+
+        [[nodiscard]] QString state() const;
+        [[nodiscard]] QString stateDescription() const;
+        [[nodiscard]] QString status() const;
+        [[nodiscard]] bool isRunning() const;
+        [[nodiscard]] bool isPaused() const;
+        [[nodiscard]] qlonglong freeSpace() const;
+        [[nodiscard]] qulonglong filesUploaded() const;
+        [[nodiscard]] qulonglong filesDownloaded() const;
+        [[nodiscard]] qulonglong itemsDeleted() const;
+        [[nodiscard]] qulonglong errors() const;
+        [[nodiscard]] qulonglong throttledResponses() const;
+        [[nodiscard]] qulonglong retries() const;
+        [[nodiscard]] qlonglong backoffTime() const;
+        [[nodiscard]] uint lastCycleThroughputLoss() const;
+        [[nodiscard]] double cpuUsage() const;
+        [[nodiscard]] qulonglong residentMemory() const;
+        [[nodiscard]] uint threads() const;
+        [[nodiscard]] qulonglong bytesRead() const;
+        [[nodiscard]] qulonglong bytesWritten() const;
+
+    public Q_SLOTS:
+        /** Pause synchronisation until Resume() is called. Returns false if the client isn't running. */
+        bool Pause();
+
+        /** Pause synchronisation for a number of seconds. Returns false if the client isn't running. */
+        bool PauseFor(uint seconds);
+
+        /** Resume paused synchronisation. */
+        void Resume();
+
+        /** Restart the onedrive client, starting it if it's not running. */
+        void Restart();
+
+        /** Stop the onedrive client. */
+        void Stop();
+
+    private:
+        /** Record that a property has changed, to be included in the next PropertiesChanged signal. */
+        void markChanged(const QString & property);
+
+        /** Record that the properties describing the process's state have changed. */
+        void markProcessStateChanged();
+
+        /** Emit PropertiesChanged for the properties that have changed since it was last emitted. */
+        void emitPropertiesChanged();
+
+        SynchronisationService & m_service;
+        bool m_registered;
+        QSet<QString> m_changedProperties;
+        QTimer m_propertiesChangedTimer;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_DBUSADAPTOR_H
@@ -0,0 +1,252 @@
+/**
+ * ErrorClassifier.cpp
+ *
+ * Implementation of ErrorClassifier class.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <QtCore/QLatin1String>
+#include <QtCore/QLocale>
+#include <QtCore/QStringList>
+#include "ErrorClassifier.h"
+#include "Process.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /** How long the statisticsChanged() signal is held back to coalesce changes (ms). */
+    constexpr const int ChangeNotificationDelay = 1000;
+
+    /** Stored messages are truncated to this length. */
+    constexpr const int MaximumMessageLength = 500;
+
+    struct ClassPattern
+    {
+        ErrorClass errorClass;
+        std::vector<QLatin1String> needles;
+    };
+
+    /**
+     * The text that identifies each class of error, matched case-insensitively, checked in order.
+     *
+     * More specific classes come first, so that e.g. a permission error that mentions a network call isn't counted as a
+     * network error.
+     */
+    const std::vector<ClassPattern> ClassPatterns = {
+            {ErrorClass::DatabaseLocked, {QLatin1String("database is locked"), QLatin1String("database locked"), QLatin1String("sqlite_busy")}},
+            {ErrorClass::PathTooLong, {QLatin1String("path too long"), QLatin1String("name too long"), QLatin1String("path length"), QLatin1String("maximum length"), QLatin1String("enametoolong")}},
+            {ErrorClass::QuotaExceeded, {QLatin1String("quota"), QLatin1String("insufficient space"), QLatin1String("not enough space"), QLatin1String("insufficient storage"), QLatin1String("507")}},
+            {ErrorClass::AuthenticationFailure, {QLatin1String("authentication"), QLatin1String("unauthorized"), QLatin1String("invalid_grant"), QLatin1String("refresh token"), QLatin1String("access token"), QLatin1String("aadsts"), QLatin1String("401")}},
+            {ErrorClass::PermissionDenied, {QLatin1String("permission denied"), QLatin1String("access denied"), QLatin1String("accessdenied"), QLatin1String("forbidden"), QLatin1String("read-only file system"), QLatin1String("403")}},
+            {ErrorClass::NetworkUnreachable, {QLatin1String("network is unreachable"), QLatin1String("could not connect"), QLatin1String("couldn't connect"), QLatin1String("couldn't resolve"), QLatin1String("could not resolve"), QLatin1String("timeout was reached"), QLatin1String("timed out"), QLatin1String("no internet"), QLatin1String("connection reset"), QLatin1String("connection refused"), QLatin1String("curl")}},
+    };
+}
+
+
+ErrorClassifier::ErrorClassifier(const Process & process, QObject * parent)
+        : QObject(parent),
+          m_clock(),
+          m_statistics(),
+          m_changeTimer(),
+          m_reportTimer()
+{
+    m_clock.start();
+    m_changeTimer.setSingleShot(true);
+    m_changeTimer.setInterval(ChangeNotificationDelay);
+    connect(&m_changeTimer, &QTimer::timeout, this, &ErrorClassifier::statisticsChanged);
+
+    m_reportTimer.setSingleShot(true);
+    connect(&m_reportTimer, &QTimer::timeout, this, &ErrorClassifier::reportHeldErrors);
+
+    connect(&process, &Process::errorReported, this, [this, &process](const QString & message) {
+        addError(message, process.outputTimestamp());
+    });
+}
+
+
+ErrorClassifier::~ErrorClassifier() = default;
+
+
+ErrorClass ErrorClassifier::classify(const QString & message)
+{
+    for (const auto & pattern : ClassPatterns) {
+        for (const auto & needle : pattern.needles) {
+            if (message.contains(needle, Qt::CaseInsensitive)) {
+                return pattern.errorClass;
+            }
+        }
+    }
+
+    return ErrorClass::Other;
+}
+
+
+QString ErrorClassifier::className(ErrorClass errorClass)
+{
+    switch (errorClass) {
+        case ErrorClass::AuthenticationFailure:
+            return tr("Authentication failure");
+
+        case ErrorClass::PermissionDenied:
+            return tr("Permission denied");
+
+        case ErrorClass::PathTooLong:
+            return tr("Path too long");
+
+        case ErrorClass::QuotaExceeded:
+            return tr("Quota exceeded");
+
+        case ErrorClass::DatabaseLocked:
+            return tr("Database locked");
+
+        case ErrorClass::NetworkUnreachable:
+            return tr("Network unreachable");
+
+        case ErrorClass::Other:
+            return tr("Other error");
+    }
+
+    throw std::logic_error("Unhandled error class in ErrorClassifier::className()");
+}
+
+
+void ErrorClassifier::addError(const QString & message, const Process::Timestamp & time)
+{
+    const auto trimmed = message.trimmed();
+
+    if (trimmed.isEmpty()) {
+        return;
+    }
+
+    const auto errorClass = classify(trimmed);
+    auto & statistics = m_statistics[static_cast<int>(errorClass)];
+    const auto minute = currentMinute();
+
+    // clear the buckets for the minutes that have passed since the last error of this class
+    if (RateWindow <= minute - statistics.currentMinute) {
+        statistics.minuteCounts.fill(0);
+    } else {
+        for (auto passed = statistics.currentMinute + 1; passed <= minute; ++passed) {
+            statistics.minuteCounts[passed % RateWindow] = 0;
+        }
+    }
+
+    statistics.currentMinute = minute;
+    ++statistics.minuteCounts[minute % RateWindow];
+    ++statistics.total;
+    ++statistics.unreported;
+    statistics.lastMessage = trimmed.left(MaximumMessageLength);
+    statistics.lastTime = time;
+
+    const auto now = m_clock.elapsed();
+
+    if (0 > statistics.lastReported || ReportInterval <= now - statistics.lastReported) {
+        report(errorClass, now);
+    } else if (!m_reportTimer.isActive()) {
+        m_reportTimer.start(static_cast<int>(ReportInterval - (now - statistics.lastReported)));
+    }
+
+    if (!m_changeTimer.isActive()) {
+        m_changeTimer.start();
+    }
+}
+
+
+void ErrorClassifier::report(ErrorClass errorClass, qint64 now)
+{
+    auto & statistics = m_statistics[static_cast<int>(errorClass)];
+    const auto repeats = statistics.unreported;
+    statistics.unreported = 0;
+    statistics.lastReported = now;
+    Q_EMIT errorReported(errorClass, statistics.lastMessage, repeats, statistics.lastTime);
+}
+
+
+void ErrorClassifier::reportHeldErrors()
+{
+    const auto now = m_clock.elapsed();
+    qint64 nextReport = -1;
+
+    for (int index = 0; index < ErrorClassCount; ++index) {
+        const auto & statistics = m_statistics[index];
+
+        if (0 == statistics.unreported) {
+            continue;
+        }
+
+        if (ReportInterval <= now - statistics.lastReported) {
+            report(static_cast<ErrorClass>(index), now);
+        } else {
+            const auto due = statistics.lastReported + ReportInterval - now;
+            nextReport = (0 > nextReport ? due : std::min(nextReport, due));
+        }
+    }
+
+    if (0 <= nextReport) {
+        m_reportTimer.start(static_cast<int>(nextReport));
+    }
+}
+
+
+quint64 ErrorClassifier::totalCount() const
+{
+    quint64 total = 0;
+
+    for (const auto & statistics : m_statistics) {
+        total += statistics.total;
+    }
+
+    return total;
+}
+
+
+quint64 ErrorClassifier::recentCount(ErrorClass errorClass) const
+{
+    const auto & statistics = m_statistics[static_cast<int>(errorClass)];
+    const auto elapsed = currentMinute() - statistics.currentMinute;
+
+    if (RateWindow <= elapsed) {
+        return 0;
+    }
+
+    // the buckets for the oldest minutes have expired but won't be cleared until the next error of this class
+    quint64 count = 0;
+
+    for (auto minute = statistics.currentMinute - (RateWindow - 1 - elapsed); minute <= statistics.currentMinute; ++minute) {
+        count += statistics.minuteCounts[((minute % RateWindow) + RateWindow) % RateWindow];
+    }
+
+    return count;
+}
+
+
+QString ErrorClassifier::summary() const
+{
+    std::vector<std::pair<quint64, ErrorClass>> counts;
+
+    for (int index = 0; index < ErrorClassCount; ++index) {
+        if (const auto count = recentCount(static_cast<ErrorClass>(index)); 0 < count) {
+            counts.emplace_back(count, static_cast<ErrorClass>(index));
+        }
+    }
+
+    if (counts.empty()) {
+        return {};
+    }
+
+    std::sort(counts.begin(), counts.end(), [](const auto & first, const auto & second) -> bool {
+        return first.first > second.first;
+    });
+
+    const auto locale = QLocale::system();
+    QStringList parts;
+
+    for (const auto & [count, errorClass] : counts) {
+        parts.append(tr("%1 × %2").arg(className(errorClass), locale.toString(count)));
+    }
+
+    return tr("Errors in the last hour: %1").arg(parts.join(QStringLiteral(", ")));
+}
@@ -0,0 +1,154 @@
+/**
+ * ErrorClassifier.h
+ *
+ * Declaration of ErrorClassifier class.
+ */
+
+#ifndef ONEDRIVETRAY_ERRORCLASSIFIER_H
+#define ONEDRIVETRAY_ERRORCLASSIFIER_H
+
+#include <array>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include "Process.h"
+
+namespace OneDrive
+{
+    class Process;
+
+    /** Enumeration of the kinds of error the onedrive client reports. */
+    enum class ErrorClass
+    {
+        AuthenticationFailure = 0,
+        PermissionDenied,
+        PathTooLong,
+        QuotaExceeded,
+        DatabaseLocked,
+        NetworkUnreachable,
+        Other,
+    };
+
+    /**
+     * Sorts the errors the onedrive client reports into classes and keeps rates for each class.
+     *
+     * The memory used doesn't depend on the number of errors: for each class there is a total, a per-minute count for
+     * the last hour, and the most recent message. Repeats of the same class of error are reported at most once per
+     * ReportInterval, with the number of repeats, so that an error storm results in a handful of reports rather than
+     * one per line.
+     */
+    class ErrorClassifier
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** The number of error classes. */
+        static constexpr const int ErrorClassCount = static_cast<int>(ErrorClass::Other) + 1;
+
+        /** The period over which recent errors are counted, in minutes. */
+        static constexpr const int RateWindow = 60;
+
+        /** The shortest time between reports of the same class of error (ms). */
+        static constexpr const int ReportInterval = 60000;
+
+        explicit ErrorClassifier(const Process & process, QObject * parent = nullptr);
+
+        ~ErrorClassifier() override;
+
+        /** Determine the class of an error message. */
+        [[nodiscard]] static ErrorClass classify(const QString & message);
+
+        /** A short description of an error class, for display. */
+        [[nodiscard]] static QString className(ErrorClass errorClass);
+
+        /** The number of errors of a class since the classifier was created. */
+        [[nodiscard]] inline quint64 totalCount(ErrorClass errorClass) const
+        {
+            return m_statistics[static_cast<int>(errorClass)].total;
+        }
+
+        /** The number of errors of all classes since the classifier was created. */
+        [[nodiscard]] quint64 totalCount() const;
+
+        /** The number of errors of a class in the last RateWindow minutes. */
+        [[nodiscard]] quint64 recentCount(ErrorClass errorClass) const;
+
+        /** The most recent message of a class, if any. */
+        [[nodiscard]] inline const QString & lastMessage(ErrorClass errorClass) const
+        {
+            return m_statistics[static_cast<int>(errorClass)].lastMessage;
+        }
+
+        /**
+         * Summarise the recent errors, most frequent first.
+         *
+         * @return The summary, or an empty string if there have been no errors in the last RateWindow minutes.
+         */
+        [[nodiscard]] QString summary() const;
+
+    Q_SIGNALS:
+        /**
+         * Emitted for the first error of a class, and then at most once per ReportInterval while it keeps recurring.
+         *
+         * @param errorClass The class of error.
+         * @param message The most recent message.
+         * @param repeats How many errors of the class have occurred since the last report, including this one.
+         * @param time When the client reported the most recent message.
+         */
+        void errorReported(OneDrive::ErrorClass errorClass, const QString & message, quint64 repeats, const OneDrive::Process::Timestamp & time);
+
+        /** Emitted (at most once a second) when the error counts change. */
+        void statisticsChanged();
+
+    private:
+        struct ErrorStatistics
+        {
+            quint64 total = 0;
+
+            /** Per-minute counts, indexed by minute modulo RateWindow. */
+            std::array<quint32, RateWindow> minuteCounts{};
+
+            /** The minute (on m_clock) of the most recent count. */
+            qint64 currentMinute = 0;
+
+            QString lastMessage;
+
+            /** When the client reported lastMessage. */
+            Process::Timestamp lastTime;
+
+            /** Errors since the last report. */
+            quint64 unreported = 0;
+
+            /** The time (on m_clock) of the last report, or -1. */
+            qint64 lastReported = -1;
+        };
+
+        /** Classify and count an error message the client reported at a given time. */
+        void addError(const QString & message, const Process::Timestamp & time);
+
+        /** Report the errors that were held back because they occurred within ReportInterval of the last report. */
+        void reportHeldErrors();
+
+        /** Report the unreported errors of a class. */
+        void report(ErrorClass errorClass, qint64 now);
+
+        /** The current minute on m_clock. */
+        [[nodiscard]] inline qint64 currentMinute() const
+        {
+            return m_clock.elapsed() / 60000;
+        }
+
+        QElapsedTimer m_clock;
+        std::array<ErrorStatistics, ErrorClassCount> m_statistics;
+
+        /** Coalesces statisticsChanged() signals. */
+        QTimer m_changeTimer;
+
+        /** Reports held-back errors once their ReportInterval has passed. */
+        QTimer m_reportTimer;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_ERRORCLASSIFIER_H
@@ -0,0 +1,278 @@
+/**
+ * EventBus.cpp
+ *
+ * Implementation of EventBus class.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <QtCore/QDir>
+#include <QtCore/QThread>
+#include <QtCore/QVarLengthArray>
+#include "EventBus.h"
+
+using namespace OneDrive;
+
+
+EventBus::EventBus(const Process & process, QObject * parent)
+        : QObject(parent),
+          m_subscribers(),
+          m_subscribersByType(),
+          m_nextSubscription(0)
+{
+    connect(&process, &Process::fileUploaded, this, [this, &process](const QString & path) {
+        publish(EventType::Uploaded, process.outputTimestamp(), path);
+    });
+
+    connect(&process, &Process::fileDownloaded, this, [this, &process](const QString & path) {
+        publish(EventType::Downloaded, process.outputTimestamp(), path);
+    });
+
+    connect(&process, &Process::fileDeleted, this, [this, &process](const QString & path) {
+        publish(EventType::Deleted, process.outputTimestamp(), path);
+    });
+
+    connect(&process, &Process::fileRenamed, this, [this, &process](const QString & from, const QString & to) {
+        publish(EventType::Renamed, process.outputTimestamp(), from, normalisePath(to));
+    });
+
+    connect(&process, &Process::localDirectoryCreated, this, [this, &process](const QString & path) {
+        publish(EventType::LocalDirectoryCreated, process.outputTimestamp(), path);
+    });
+
+    connect(&process, &Process::remoteDirectoryCreated, this, [this, &process](const QString & path) {
+        publish(EventType::RemoteDirectoryCreated, process.outputTimestamp(), path);
+    });
+
+    connect(&process, &Process::errorReported, this, [this, &process](const QString & message) {
+        publish(EventType::Error, process.outputTimestamp(), {}, message);
+    });
+
+    connect(&process, &Process::started, this, [this]() {
+        publish(EventType::Started, Process::currentTimestamp());
+    });
+
+    connect(&process, &Process::stopped, this, [this]() {
+        publish(EventType::Stopped, Process::currentTimestamp());
+    });
+
+    connect(&process, &Process::synchronisationComplete, this, [this, &process]() {
+        publish(EventType::SynchronisationComplete, process.outputTimestamp());
+    });
+
+    connect(&process, &Process::localRootDirectoryRemoved, this, [this, &process]() {
+        publish(EventType::LocalRootDirectoryRemoved, process.outputTimestamp());
+    });
+
+    connect(&process, &Process::freeSpaceUpdated, this, [this, &process](uint64_t bytes) {
+        publish(EventType::FreeSpaceUpdated, process.outputTimestamp(), {}, {}, bytes);
+    });
+}
+
+
+EventBus::~EventBus() = default;
+
+
+int EventBus::subscribe(QObject * context, EventTypes types, const QString & path, Handler handler)
+{
+    const auto subscription = m_nextSubscription++;
+    const auto normalised = normalisePath(path);
+    m_subscribers.insert(subscription, {context, types, normalised, std::move(handler), {}});
+
+    for (int type = 0; type < EventTypeCount; ++type) {
+        if (!(types & typeMask(static_cast<EventType>(type)))) {
+            continue;
+        }
+
+        if (normalised.isEmpty()) {
+            m_subscribersByType[type].unfiltered.append(subscription);
+        } else {
+            m_subscribersByType[type].byPath.insert(normalised, subscription);
+        }
+    }
+
+    connect(context, &QObject::destroyed, this, [this, subscription]() {
+        unsubscribe(subscription);
+    });
+
+    return subscription;
+}
+
+
+void EventBus::unsubscribe(int subscription)
+{
+    const auto subscriber = m_subscribers.find(subscription);
+
+    if (subscriber == m_subscribers.end()) {
+        return;
+    }
+
+    for (auto & subscribers : m_subscribersByType) {
+        if (subscriber->path.isEmpty()) {
+            subscribers.unfiltered.removeOne(subscription);
+        } else {
+            subscribers.byPath.remove(subscriber->path, subscription);
+        }
+    }
+
+    m_subscribers.erase(subscriber);
+}
+
+
+void EventBus::publish(EventType type, const Process::Timestamp & time, const QString & path, const QString & detail, quint64 size)
+{
+    const auto & subscribers = m_subscribersByType[static_cast<int>(type)];
+
+    if (subscribers.unfiltered.isEmpty() && subscribers.byPath.isEmpty()) {
+        return;
+    }
+
+    const Event event = {time.wallTime, time.monotonicTime, type, normalisePath(path), detail, size};
+
+    for (const auto subscription : subscribers.unfiltered) {
+        enqueue(subscription, event);
+    }
+
+    if (subscribers.byPath.isEmpty()) {
+        return;
+    }
+
+    if (event.path.isEmpty()) {
+        // not about an item, so every filter accepts it
+        for (const auto subscription : subscribers.byPath) {
+            enqueue(subscription, event);
+        }
+
+        return;
+    }
+
+    // a rename matches a subscriber through either path, but must only be queued for it once
+    QVarLengthArray<int, 8> matched;
+
+    const auto match = [&subscribers, &matched](const QString & itemPath) {
+        // the item itself, then each directory containing it
+        for (auto end = itemPath.size(); 0 < end; end = itemPath.lastIndexOf(QLatin1Char('/'), end - 1)) {
+            const auto directory = itemPath.left(end);
+
+            for (auto it = subscribers.byPath.constFind(directory); it != subscribers.byPath.cend() && it.key() == directory; ++it) {
+                if (std::find(matched.cbegin(), matched.cend(), it.value()) == matched.cend()) {
+                    matched.append(it.value());
+                }
+            }
+        }
+    };
+
+    match(event.path);
+
+    if (EventType::Renamed == type) {
+        match(event.detail);
+    }
+
+    for (const auto subscription : matched) {
+        enqueue(subscription, event);
+    }
+}
+
+
+void EventBus::enqueue(int subscription, const Event & event)
+{
+    auto & subscriber = m_subscribers[subscription];
+
+    // the first event queued for a subscriber schedules the delivery of the batch
+    if (subscriber.pending.isEmpty()) {
+        QMetaObject::invokeMethod(this, [this, subscription]() {
+            flush(subscription);
+        }, Qt::QueuedConnection);
+    }
+
+    subscriber.pending.append(event);
+}
+
+
+void EventBus::flush(int subscription)
+{
+    const auto subscriber = m_subscribers.find(subscription);
+
+    if (subscriber == m_subscribers.end() || subscriber->pending.isEmpty() || !subscriber->context) {
+        return;
+    }
+
+    auto batch = std::move(subscriber->pending);
+    subscriber->pending = {};
+
+    // the handler is copied so that it survives the subscription ending while it runs, or before a queued batch arrives
+    auto handler = subscriber->handler;
+
+    if (subscriber->context->thread() == thread()) {
+        handler(batch);
+        return;
+    }
+
+    QMetaObject::invokeMethod(subscriber->context, [handler = std::move(handler), batch = std::move(batch)]() {
+        handler(batch);
+    }, Qt::QueuedConnection);
+}
+
+
+QString EventBus::typeName(EventType type)
+{
+    switch (type) {
+        case EventType::Uploaded:
+            return QStringLiteral("uploaded");
+
+        case EventType::Downloaded:
+            return QStringLiteral("downloaded");
+
+        case EventType::Deleted:
+            return QStringLiteral("deleted");
+
+        case EventType::Renamed:
+            return QStringLiteral("renamed");
+
+        case EventType::LocalDirectoryCreated:
+            return QStringLiteral("local-directory-created");
+
+        case EventType::RemoteDirectoryCreated:
+            return QStringLiteral("remote-directory-created");
+
+        case EventType::Error:
+            return QStringLiteral("error");
+
+        case EventType::Started:
+            return QStringLiteral("started");
+
+        case EventType::Stopped:
+            return QStringLiteral("stopped");
+
+        case EventType::SynchronisationComplete:
+            return QStringLiteral("synchronisation-complete");
+
+        case EventType::LocalRootDirectoryRemoved:
+            return QStringLiteral("local-root-directory-removed");
+
+        case EventType::FreeSpaceUpdated:
+            return QStringLiteral("free-space-updated");
+    }
+
+    throw std::logic_error("Unhandled event type in EventBus::typeName()");
+}
+
+
+QString EventBus::normalisePath(const QString & path)
+{
+    // spaces are legal at either end of a name, so the path must not be trimmed
+    auto normalised = QDir::cleanPath(path);
+
+    while (normalised.endsWith(QLatin1Char('/'))) {
+        normalised.chop(1);
+    }
+
+    return normalised;
+}
+
+
+bool EventBus::isWithin(const QString & path, const QString & directory)
+{
+    return path.startsWith(directory) && (path.size() == directory.size() || QLatin1Char('/') == path[directory.size()]);
+}
@@ -0,0 +1,173 @@
+/**
+ * EventBus.h
+ *
+ * Declaration of EventBus class.
+ */
+
+#ifndef ONEDRIVETRAY_EVENTBUS_H
+#define ONEDRIVETRAY_EVENTBUS_H
+
+#include <array>
+#include <functional>
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include "Process.h"
+
+namespace OneDrive
+{
+    /**
+     * Carries the onedrive client's events to the parts of the application that consume them.
+     *
+     * The bus connects once to each of the process's event signals, turns what it reports into a compact Event and
+     * hands it to the subscribers whose filters accept it. Consumers of the events subscribe here rather than
+     * connecting to the process themselves; only the service's own bookkeeping and the monitors that must see an event
+     * the moment it is reported stay connected to the process. Subscribers are indexed by event type, and those
+     * filtered by path by the path, so publishing an item event visits only the unfiltered subscribers to its type and
+     * looks up the item and each directory containing it, rather than checking every subscriber's filter. Events not
+     * about an item still visit all the subscribers to their type. Each subscriber's events are queued and delivered as
+     * a batch in the thread of the subscriber's context object, once control returns to the event loop, so a burst of
+     * output from the client costs each subscriber one call rather than one per line.
+     */
+    class EventBus
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** Enumeration of the kinds of event. */
+        enum class EventType
+        {
+            Uploaded = 0,
+            Downloaded,
+            Deleted,
+            Renamed,
+            LocalDirectoryCreated,
+            RemoteDirectoryCreated,
+            Error,
+            Started,
+            Stopped,
+            SynchronisationComplete,
+            LocalRootDirectoryRemoved,
+            FreeSpaceUpdated,
+        };
+
+        static constexpr const int EventTypeCount = static_cast<int>(EventType::FreeSpaceUpdated) + 1;
+
+        /** A set of event types, as a mask with the bit for each type's value set. */
+        using EventTypes = quint32;
+
+        /** The mask for one event type. */
+        [[nodiscard]] static constexpr EventTypes typeMask(EventType type)
+        {
+            return EventTypes(1) << static_cast<int>(type);
+        }
+
+        static constexpr const EventTypes AllEventTypes = (EventTypes(1) << EventTypeCount) - 1;
+
+        /** The events about a file or directory in the sync directory. */
+        static constexpr const EventTypes ItemEventTypes = typeMask(EventType::Uploaded) | typeMask(EventType::Downloaded)
+                | typeMask(EventType::Deleted) | typeMask(EventType::Renamed) | typeMask(EventType::LocalDirectoryCreated)
+                | typeMask(EventType::RemoteDirectoryCreated);
+
+        struct Event
+        {
+            /** When the client reported the event, in ms since the epoch. */
+            qint64 time = 0;
+
+            /** When the client reported the event, on the monotonic clock (see Process::Timestamp). */
+            qint64 monotonicTime = 0;
+
+            EventType type = EventType::Uploaded;
+
+            /** The item the event is about, relative to the sync directory. Empty for events not about an item. */
+            QString path;
+
+            /** The new path for renames, the message for errors. */
+            QString detail;
+
+            /** The free space, for FreeSpaceUpdated. */
+            quint64 size = 0;
+        };
+
+        using Batch = QVector<Event>;
+        using Handler = std::function<void(const Batch &)>;
+
+        explicit EventBus(const Process & process, QObject * parent = nullptr);
+
+        ~EventBus() override;
+
+        /**
+         * Subscribe to events.
+         *
+         * @param context The batches are delivered in this object's thread. The subscription ends when it is
+         * destroyed.
+         * @param types The types of event to deliver.
+         * @param path Only deliver item events for this path or the items inside it (or, for renames, whose new path
+         * is). Events not about an item are always delivered. An empty path accepts all events.
+         * @param handler Called with each batch of events, oldest first.
+         *
+         * @return An ID for unsubscribe().
+         */
+        int subscribe(QObject * context, EventTypes types, const QString & path, Handler handler);
+
+        /** End a subscription. Events already queued for it are not delivered. */
+        void unsubscribe(int subscription);
+
+        /** Publish an event to the subscribers. */
+        void publish(EventType type, const Process::Timestamp & time, const QString & path = {}, const QString & detail = {}, quint64 size = 0);
+
+        /** A short, untranslated name for an event type, for scripts. */
+        [[nodiscard]] static QString typeName(EventType type);
+
+        /**
+         * Normalise a path reported by the client so it can be compared with a path given by the user.
+         *
+         * The path is cleaned, which also removes a leading "./", and any trailing '/' is removed. Whitespace is kept.
+         */
+        [[nodiscard]] static QString normalisePath(const QString & path);
+
+        /** Whether a path is another path, or is inside it. */
+        [[nodiscard]] static bool isWithin(const QString & path, const QString & directory);
+
+    private:
+        struct Subscriber
+        {
+            QPointer<QObject> context;
+            EventTypes types;
+            QString path;
+            Handler handler;
+
+            /** The events waiting to be delivered. */
+            Batch pending;
+        };
+
+        /** The IDs of the subscribers to one event type. */
+        struct TypeSubscribers
+        {
+            /** The subscribers that accept events for any path. */
+            QVector<int> unfiltered;
+
+            /** The subscribers filtered by path, keyed by the path. */
+            QMultiHash<QString, int> byPath;
+        };
+
+        /** Queue an event for a subscriber. */
+        void enqueue(int subscription, const Event & event);
+
+        /** Deliver a subscriber's pending events. */
+        void flush(int subscription);
+
+        QHash<int, Subscriber> m_subscribers;
+
+        /** For each event type, the IDs of its subscribers. */
+        std::array<TypeSubscribers, EventTypeCount> m_subscribersByType;
+
+        /** The ID for the next subscription. */
+        int m_nextSubscription;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_EVENTBUS_H
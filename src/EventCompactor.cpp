@@ -0,0 +1,175 @@
+/**
+ * EventCompactor.cpp
+ *
+ * Implementation of EventCompactor class.
+ */
+
+#include <algorithm>
+#include "EventCompactor.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /**
+     * Whether an item's folder can join a run's folder.
+     *
+     * Items at the root only join runs at the root, otherwise every run would absorb them.
+     */
+    bool sharesDirectory(const QString & runDirectory, const QString & directory)
+    {
+        if (runDirectory.isEmpty() || directory.isEmpty()) {
+            return runDirectory.isEmpty() && directory.isEmpty();
+        }
+
+        return !EventCompactor::commonDirectory(runDirectory, directory).isEmpty();
+    }
+}
+
+
+EventCompactor::EventCompactor(EventBus & bus, EventBus::EventTypes types, QObject * parent)
+        : QObject(parent),
+          m_run(),
+          m_runDirectory(),
+          m_runDestination(),
+          m_runTimer()
+{
+    m_runTimer.setSingleShot(true);
+    m_runTimer.setInterval(Window);
+    connect(&m_runTimer, &QTimer::timeout, this, &EventCompactor::onRunTimeout);
+
+    bus.subscribe(this, types, {}, [this](const EventBus::Batch & events) {
+        compact(events);
+    });
+}
+
+
+EventCompactor::~EventCompactor() = default;
+
+
+QString EventCompactor::directoryOf(const QString & path)
+{
+    const auto separator = path.lastIndexOf(QLatin1Char('/'));
+    return 0 > separator ? QString() : path.left(separator);
+}
+
+
+QString EventCompactor::commonDirectory(const QString & first, const QString & second)
+{
+    const auto length = std::min(first.size(), second.size());
+    int common = 0;
+
+    while (common < length && first[common] == second[common]) {
+        ++common;
+    }
+
+    // only whole folder names count
+    if (common == first.size() && (common == second.size() || QLatin1Char('/') == second[common])) {
+        return first;
+    }
+
+    if (common == second.size() && QLatin1Char('/') == first[common]) {
+        return second;
+    }
+
+    if (0 == common) {
+        return {};
+    }
+
+    const auto separator = first.lastIndexOf(QLatin1Char('/'), common - 1);
+    return 0 > separator ? QString() : first.left(separator);
+}
+
+
+void EventCompactor::compact(const EventBus::Batch & events)
+{
+    Entries entries;
+
+    for (const auto & event : events) {
+        if (extendRun(event)) {
+            continue;
+        }
+
+        endRun(entries);
+
+        if (EventBus::ItemEventTypes & EventBus::typeMask(event.type)) {
+            m_run.append(event);
+            m_runDirectory = directoryOf(event.path);
+            m_runDestination = (EventBus::EventType::Renamed == event.type ? directoryOf(event.detail) : QString());
+        } else {
+            entries.append({event, {}});
+        }
+    }
+
+    if (!m_run.isEmpty()) {
+        m_runTimer.start();
+    }
+
+    if (!entries.isEmpty()) {
+        Q_EMIT entriesReady(entries);
+    }
+}
+
+
+bool EventCompactor::extendRun(const EventBus::Event & event)
+{
+    if (m_run.isEmpty() || event.type != m_run.first().type || Window < event.monotonicTime - m_run.last().monotonicTime) {
+        return false;
+    }
+
+    const auto directory = directoryOf(event.path);
+
+    if (!sharesDirectory(m_runDirectory, directory)) {
+        return false;
+    }
+
+    if (EventBus::EventType::Renamed == event.type) {
+        const auto destination = directoryOf(event.detail);
+
+        if (!sharesDirectory(m_runDestination, destination)) {
+            return false;
+        }
+
+        m_runDestination = commonDirectory(m_runDestination, destination);
+    }
+
+    m_runDirectory = commonDirectory(m_runDirectory, directory);
+    m_run.append(event);
+    return true;
+}
+
+
+void EventCompactor::endRun(Entries & entries)
+{
+    m_runTimer.stop();
+
+    if (m_run.isEmpty()) {
+        return;
+    }
+
+    if (MinimumRunLength <= m_run.size()) {
+        auto summary = m_run.first();
+        summary.path = m_runDirectory;
+        summary.detail = m_runDestination;
+        entries.append({summary, std::move(m_run)});
+    } else {
+        for (const auto & event : m_run) {
+            entries.append({event, {}});
+        }
+    }
+
+    m_run = {};
+    m_runDirectory.clear();
+    m_runDestination.clear();
+}
+
+
+void EventCompactor::onRunTimeout()
+{
+    Entries entries;
+    endRun(entries);
+
+    if (!entries.isEmpty()) {
+        Q_EMIT entriesReady(entries);
+    }
+}
@@ -0,0 +1,103 @@
+/**
+ * EventCompactor.h
+ *
+ * Declaration of EventCompactor class.
+ */
+
+#ifndef ONEDRIVETRAY_EVENTCOMPACTOR_H
+#define ONEDRIVETRAY_EVENTCOMPACTOR_H
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+#include "EventBus.h"
+
+namespace OneDrive
+{
+    /**
+     * Folds bulk operations on the events from the bus into one summary per folder.
+     *
+     * Moving or deleting a folder makes the client report every item in it. The compactor holds back a run of item
+     * events of the same type whose paths share a folder (and, for moves, whose new paths also share one), as long as
+     * each follows the last within Window. When the run ends, a run of at least MinimumRunLength is passed on as a
+     * single summary holding the run's events; a shorter run is passed on as it was. Events that aren't about an item
+     * are passed on in order, after the run that preceded them.
+     */
+    class EventCompactor
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** The longest gap between the events in a run, on the monotonic clock (ms). */
+        static constexpr const int Window = 1000;
+
+        /** The fewest events that are folded into a summary. */
+        static constexpr const int MinimumRunLength = 10;
+
+        /** An event, or a summary of a run of events. */
+        struct Entry
+        {
+            /**
+             * The event, or for a summary the first event of the run with its path replaced by the folder the run
+             * shares and, for moves, its detail by the folder the items were moved to.
+             */
+            EventBus::Event event;
+
+            /** The events in the run, oldest first. Empty if the entry isn't a summary. */
+            EventBus::Batch items;
+
+            [[nodiscard]] inline bool isSummary() const
+            {
+                return !items.isEmpty();
+            }
+        };
+
+        using Entries = QVector<Entry>;
+
+        /**
+         * @param bus The bus to subscribe to.
+         * @param types The types of event to pass on. Those in EventBus::ItemEventTypes are compacted.
+         */
+        EventCompactor(EventBus & bus, EventBus::EventTypes types, QObject * parent = nullptr);
+
+        ~EventCompactor() override;
+
+        /** The folder a path is in, or an empty string for an item at the root. */
+        [[nodiscard]] static QString directoryOf(const QString & path);
+
+        /** The deepest folder two folders share, or an empty string if they share none. */
+        [[nodiscard]] static QString commonDirectory(const QString & first, const QString & second);
+
+    Q_SIGNALS:
+        /** Emitted with the entries that are ready, oldest first. */
+        void entriesReady(const OneDrive::EventCompactor::Entries & entries);
+
+    private:
+        /** Handle a batch from the bus. */
+        void compact(const EventBus::Batch & events);
+
+        /** Add an event to the current run if it belongs in it. */
+        bool extendRun(const EventBus::Event & event);
+
+        /** End the current run, adding it to the entries. */
+        void endRun(Entries & entries);
+
+        /** End the current run once it has been quiet for Window. */
+        void onRunTimeout();
+
+        /** The events in the current run. */
+        EventBus::Batch m_run;
+
+        /** The folder shared by the paths of the items in the current run. */
+        QString m_runDirectory;
+
+        /** For moves, the folder shared by the new paths of the items in the current run. */
+        QString m_runDestination;
+
+        QTimer m_runTimer;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_EVENTCOMPACTOR_H
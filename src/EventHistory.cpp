@@ -0,0 +1,58 @@
+/**
+ * EventHistory.cpp
+ *
+ * Implementation of EventHistory class.
+ */
+
+#include <algorithm>
+#include "EventHistory.h"
+
+using namespace OneDrive;
+
+
+EventHistory::EventHistory(EventBus & bus, QObject * parent)
+        : QObject(parent),
+          m_events(Capacity),
+          m_next(0),
+          m_count(0)
+{
+    bus.subscribe(this, RecordedEventTypes, {}, [this](const EventBus::Batch & events) {
+        for (const auto & event : events) {
+            record(event);
+        }
+    });
+}
+
+
+EventHistory::~EventHistory() = default;
+
+
+void EventHistory::record(const Event & event)
+{
+    m_events[m_next] = event;
+    m_next = (m_next + 1) % Capacity;
+
+    if (m_count < Capacity) {
+        ++m_count;
+    }
+}
+
+
+QVector<EventHistory::Event> EventHistory::eventsFor(const QString & path, int limit) const
+{
+    const auto directory = EventBus::normalisePath(path);
+    QVector<Event> events;
+
+    // newest first, so that the limit keeps the most recent
+    for (int age = 1; age <= m_count && events.size() < limit; ++age) {
+        const auto & event = m_events[(m_next - age + Capacity) % Capacity];
+
+        if (directory.isEmpty() || EventBus::isWithin(event.path, directory) || (EventType::Renamed == event.type && EventBus::isWithin(event.detail, directory))) {
+            events.append(event);
+        }
+    }
+
+    std::reverse(events.begin(), events.end());
+    return events;
+}
+
@@ -0,0 +1,73 @@
+/**
+ * EventHistory.h
+ *
+ * Declaration of EventHistory class.
+ */
+
+#ifndef ONEDRIVETRAY_EVENTHISTORY_H
+#define ONEDRIVETRAY_EVENTHISTORY_H
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include "EventBus.h"
+
+namespace OneDrive
+{
+    /**
+     * Keeps the most recent file events reported by the onedrive client.
+     *
+     * The events are kept in a fixed-capacity ring, so the memory used doesn't grow with the number of events. Once
+     * the ring is full, each new event replaces the oldest. The history subscribes to the item and error events on
+     * the bus.
+     */
+    class EventHistory
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        using EventType = EventBus::EventType;
+        using Event = EventBus::Event;
+
+        /** The types of event recorded. */
+        static constexpr const EventBus::EventTypes RecordedEventTypes = EventBus::ItemEventTypes | EventBus::typeMask(EventType::Error);
+
+        /** The number of events kept. */
+        static constexpr const int Capacity = 4096;
+
+        explicit EventHistory(EventBus & bus, QObject * parent = nullptr);
+
+        ~EventHistory() override;
+
+        /** The number of events held. */
+        [[nodiscard]] inline int size() const
+        {
+            return m_count;
+        }
+
+        /**
+         * Fetch the events that affect a path, oldest first.
+         *
+         * An event affects the path if its path (or its new path, for a rename) is the path or is inside it.
+         *
+         * @param path The path, relative to the sync directory. An empty path matches all events.
+         * @param limit The maximum number of events to return. The most recent are returned.
+         */
+        [[nodiscard]] QVector<Event> eventsFor(const QString & path, int limit = Capacity) const;
+
+    private:
+        void record(const Event & event);
+
+        /** The ring. Slots are reused rather than reallocated. */
+        QVector<Event> m_events;
+
+        /** The index the next event will be written to. */
+        int m_next;
+
+        /** The number of events in the ring. */
+        int m_count;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_EVENTHISTORY_H
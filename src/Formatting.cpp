@@ -0,0 +1,22 @@
+/**
+ * Formatting.cpp
+ *
+ * Implementation of helpers for formatting values for display.
+ */
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QLocale>
+#include "Formatting.h"
+
+QString OneDrive::formatDuration(qint64 ms)
+{
+    if (60000 > ms) {
+        return QCoreApplication::translate("Formatting", "%1s").arg(QLocale::system().toString(static_cast<double>(ms) / 1000.0, 'f', 1));
+    }
+
+    if (3600000 > ms) {
+        return QCoreApplication::translate("Formatting", "%1m %2s").arg(ms / 60000).arg((ms % 60000) / 1000);
+    }
+
+    return QCoreApplication::translate("Formatting", "%1h %2m").arg(ms / 3600000).arg((ms % 3600000) / 60000);
+}
@@ -0,0 +1,24 @@
+/**
+ * Formatting.h
+ *
+ * Declaration of helpers for formatting values for display.
+ */
+
+#ifndef ONEDRIVETRAY_FORMATTING_H
+#define ONEDRIVETRAY_FORMATTING_H
+
+#include <QtCore/QString>
+
+namespace OneDrive
+{
+    /**
+     * Format a duration for display.
+     *
+     * @param ms The duration in milliseconds.
+     *
+     * @return The translated duration, e.g. "4.2s" or "3m 12s".
+     */
+    QString formatDuration(qint64 ms);
+}
+
+#endif //ONEDRIVETRAY_FORMATTING_H
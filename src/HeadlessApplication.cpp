@@ -0,0 +1,155 @@
+/**
+ * HeadlessApplication.cpp
+ *
+ * Implementation of HeadlessApplication class.
+ */
+
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "HeadlessApplication.h"
+#include "Logger.h"
+#include "Startup.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /** The signal handler writes to [0]; the event loop reads from [1]. */
+    int signalSockets[2] = {-1, -1};
+
+    void forwardSignal(int signalNumber)
+    {
+        // only async-signal-safe calls are allowed here
+        const auto byte = static_cast<char>(signalNumber);
+        [[maybe_unused]] const auto written = ::write(signalSockets[0], &byte, 1);
+    }
+}
+
+
+HeadlessApplication::HeadlessApplication(int & argc, char ** argv)
+        : QCoreApplication(argc, argv),
+          m_qtTranslator(),
+          m_appTranslator(),
+          m_service(),
+          m_signalNotifier(nullptr),
+          m_instanceLock(),
+          m_alreadyRunning(false),
+          m_intents()
+{
+    installTranslators(m_qtTranslator, m_appTranslator);
+    const auto options = parseCommandLine(*this, tr("Synchronise your OneDrive in the background, without the system tray."));
+    m_service.setOneDrivePath(options.oneDrivePath);
+    m_service.setOneDriveArgs(options.oneDriveArguments);
+    m_intents = options.intents;
+
+    if (!m_instanceLock.acquire(m_service.instanceKey())) {
+        m_alreadyRunning = true;
+        return;
+    }
+
+    startLogging(options);
+    m_service.loadSettings();
+    connect(&m_instanceLock, &InstanceLock::intentReceived, this, &HeadlessApplication::onIntentReceived);
+
+    connect(&m_service, &SynchronisationService::statusChanged, this, [](const QString & status) {
+        Logger::log(LogLevel::Info, LogCategory::Application, status);
+    });
+
+    installSignalHandlers();
+}
+
+
+HeadlessApplication::~HeadlessApplication() noexcept
+{
+    m_service.shutDown();
+    std::signal(SIGTERM, SIG_DFL);
+    std::signal(SIGINT, SIG_DFL);
+
+    for (auto & socket : signalSockets) {
+        if (0 <= socket) {
+            ::close(socket);
+            socket = -1;
+        }
+    }
+
+    Logger::stop();
+}
+
+
+void HeadlessApplication::installSignalHandlers()
+{
+    if (0 != ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, signalSockets)) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to create the signal socket: %1").arg(QString::fromLocal8Bit(std::strerror(errno))));
+        return;
+    }
+
+    m_signalNotifier = new QSocketNotifier(signalSockets[1], QSocketNotifier::Read, this);
+    connect(m_signalNotifier, &QSocketNotifier::activated, this, &HeadlessApplication::onTerminationSignal);
+
+    struct sigaction action = {};
+    action.sa_handler = forwardSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    ::sigaction(SIGTERM, &action, nullptr);
+    ::sigaction(SIGINT, &action, nullptr);
+}
+
+
+void HeadlessApplication::onTerminationSignal()
+{
+    char byte;
+
+    if (1 != ::read(signalSockets[1], &byte, 1)) {
+        return;
+    }
+
+    Logger::log(LogLevel::Info, LogCategory::Application, QStringLiteral("received signal %1, stopping").arg(static_cast<int>(byte)));
+    m_signalNotifier->setEnabled(false);
+    m_service.stop();
+    quit();
+}
+
+
+int HeadlessApplication::exec()
+{
+    if (m_alreadyRunning) {
+        if (m_intents.isEmpty()) {
+            std::cerr << "onedrive-tray is already running for this OneDrive configuration\n";
+            return 1;
+        }
+
+        if (m_instanceLock.forward(m_intents)) {
+            return 0;
+        }
+
+        std::cerr << "onedrive-tray is already running for this OneDrive configuration but did not respond\n";
+        return 1;
+    }
+
+    m_service.start();
+
+    for (const auto intent : m_intents) {
+        onIntentReceived(intent);
+    }
+
+    return QCoreApplication::exec();
+}
+
+
+void HeadlessApplication::onIntentReceived(InstanceLock::Intent intent)
+{
+    switch (intent) {
+        case InstanceLock::Intent::Pause:
+            m_service.pauseSynchronisation();
+            break;
+
+        case InstanceLock::Intent::ShowMessages:
+        case InstanceLock::Intent::OpenFolder:
+            Logger::log(LogLevel::Info, LogCategory::Application, QStringLiteral("ignoring --%1 in headless mode").arg(InstanceLock::intentName(intent)));
+            break;
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ * HeadlessApplication.h
+ *
+ * Declaration of HeadlessApplication class.
+ */
+
+#ifndef ONEDRIVETRAY_HEADLESSAPPLICATION_H
+#define ONEDRIVETRAY_HEADLESSAPPLICATION_H
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QSocketNotifier>
+#include <QtCore/QTranslator>
+#include "InstanceLock.h"
+#include "SynchronisationService.h"
+
+namespace OneDrive
+{
+    /**
+     * The application class for --headless mode.
+     *
+     * Runs the onedrive client and its supervision without any widgets, so it needs no connection to the display
+     * server and can run as a user service. The status is published in the log. SIGTERM and SIGINT stop the client
+     * and quit cleanly.
+     */
+    class HeadlessApplication
+            : public QCoreApplication
+    {
+    Q_OBJECT
+
+    public:
+        /**
+         * Initialise a new HeadlessApplication instance.
+         *
+         * @param argc A reference to the argument count.
+         * @param argv The arguments as an array of c-style strings. Must be at least `argc` strings.
+         */
+        HeadlessApplication(int & argc, char ** argv);
+
+        /** Destructor. */
+        ~HeadlessApplication() noexcept override;
+
+        /**
+         * Run the application.
+         *
+         * Start the onedrive client process and supervise it until a termination signal is received.
+         *
+         * If another instance is already running for the same onedrive config directory, the intents from the command
+         * line are forwarded to it instead and this returns immediately.
+         *
+         * @return The exit code.
+         */
+        int exec();
+
+    private:
+        /** Route SIGTERM and SIGINT to the event loop. */
+        void installSignalHandlers();
+
+        /** Receiver for when a termination signal has been received. */
+        void onTerminationSignal();
+
+        /** Carry out an intent from the command line or from a later launch. */
+        void onIntentReceived(InstanceLock::Intent intent);
+
+        /** The translator for Qt strings. */
+        QTranslator m_qtTranslator;
+
+        /** The translator for application strings. */
+        QTranslator m_appTranslator;
+
+        /** Runs the onedrive client. */
+        SynchronisationService m_service;
+
+        /** Watches for termination signals forwarded by the signal handler. */
+        QSocketNotifier * m_signalNotifier;
+
+        /** Stops a second instance running for the same onedrive config directory. */
+        InstanceLock m_instanceLock;
+
+        /** Whether another instance is already running, in which case this one only forwards its intents. */
+        bool m_alreadyRunning;
+
+        /** The intents given on the command line. */
+        QList<InstanceLock::Intent> m_intents;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_HEADLESSAPPLICATION_H
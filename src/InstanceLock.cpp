@@ -0,0 +1,201 @@
+/**
+ * InstanceLock.cpp
+ *
+ * Implementation of InstanceLock class.
+ */
+
+#include <stdexcept>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QLockFile>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtNetwork/QLocalSocket>
+#include "InstanceLock.h"
+#include "ControlProtocol.h"
+#include "Logger.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /** Intents are sent as one line of space-separated names; this is far longer than any valid line. */
+    constexpr const qint64 MaximumLineLength = 256;
+
+    /** How often a later instance tries to connect while the running instance is between locking and listening. */
+    constexpr const int ConnectAttempts = 5;
+
+    const QByteArray Acknowledgement = QByteArrayLiteral("OK\n");
+
+    const QList<InstanceLock::Intent> AllIntents = {
+            InstanceLock::Intent::ShowMessages,
+            InstanceLock::Intent::Pause,
+            InstanceLock::Intent::OpenFolder,
+    };
+}
+
+
+InstanceLock::InstanceLock(QObject * parent)
+        : QObject(parent),
+          m_path(),
+          m_lockFile(),
+          m_server()
+{
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+    connect(&m_server, &QLocalServer::newConnection, this, &InstanceLock::onNewConnection);
+}
+
+
+InstanceLock::~InstanceLock() = default;
+
+
+QString InstanceLock::intentName(Intent intent)
+{
+    switch (intent) {
+        case Intent::ShowMessages:
+            return QStringLiteral("show-messages");
+
+        case Intent::Pause:
+            return QStringLiteral("pause");
+
+        case Intent::OpenFolder:
+            return QStringLiteral("open-folder");
+    }
+
+    throw std::logic_error("Unhandled intent in InstanceLock::intentName()");
+}
+
+
+bool InstanceLock::acquire(const QString & instanceKey)
+{
+    if (m_lockFile) {
+        return true;
+    }
+
+    const auto directory = QString::fromStdString(ControlProtocol::socketDirectory());
+
+    if (!QDir().mkpath(directory)) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to create the socket directory %1, not checking for other instances").arg(directory));
+        return true;
+    }
+
+    QFile::setPermissions(directory, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+    m_path = directory + QStringLiteral("/instance");
+
+    if (!instanceKey.isEmpty()) {
+        m_path += QLatin1Char('-') + instanceKey;
+    }
+
+    auto lockFile = std::make_unique<QLockFile>(m_path + QStringLiteral(".lock"));
+
+    // the lock is held for as long as the instance runs, so it must only be considered stale if its owner has gone
+    lockFile->setStaleLockTime(0);
+
+    if (!lockFile->tryLock(0)) {
+        if (QLockFile::LockFailedError == lockFile->error()) {
+            return false;
+        }
+
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to create the instance lock %1.lock, not checking for other instances").arg(m_path));
+        return true;
+    }
+
+    // holding the lock means any socket there was left behind by an instance that has gone
+    QLocalServer::removeServer(m_path);
+
+    // later instances are still stopped by the lock if this fails, they just can't forward their intents
+    if (!m_server.listen(m_path)) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to listen on the instance socket %1: %2").arg(m_path, m_server.errorString()));
+    }
+
+    m_lockFile = std::move(lockFile);
+    return true;
+}
+
+
+bool InstanceLock::forward(const QList<Intent> & intents) const
+{
+    QStringList names;
+
+    for (const auto intent : intents) {
+        names.append(intentName(intent));
+    }
+
+    QLocalSocket socket;
+
+    for (auto attempt = 0; attempt < ConnectAttempts; ++attempt) {
+        socket.connectToServer(m_path);
+
+        if (socket.waitForConnected(ForwardTimeout / ConnectAttempts)) {
+            break;
+        }
+
+        // connecting fails immediately if the running instance isn't listening yet
+        QThread::msleep(ForwardTimeout / ConnectAttempts / 4);
+    }
+
+    if (QLocalSocket::ConnectedState != socket.state()) {
+        return false;
+    }
+
+    socket.write(names.join(QLatin1Char(' ')).toUtf8() + '\n');
+
+    if (!socket.waitForBytesWritten(ForwardTimeout)) {
+        return false;
+    }
+
+    while (!socket.canReadLine()) {
+        if (!socket.waitForReadyRead(ForwardTimeout)) {
+            return false;
+        }
+    }
+
+    return Acknowledgement == socket.readLine(MaximumLineLength);
+}
+
+
+void InstanceLock::onNewConnection()
+{
+    while (auto * socket = m_server.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            onReadyRead(socket);
+        });
+
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+
+void InstanceLock::onReadyRead(QLocalSocket * socket)
+{
+    if (!socket->canReadLine()) {
+        if (MaximumLineLength < socket->bytesAvailable()) {
+            socket->abort();
+        }
+
+        return;
+    }
+
+    const auto names = QString::fromUtf8(socket->readLine(MaximumLineLength)).trimmed().split(QLatin1Char(' '), Qt::SkipEmptyParts);
+
+    // acknowledge first so that the later instance can exit while the intents are carried out
+    socket->write(Acknowledgement);
+    socket->disconnectFromServer();
+
+    for (const auto & name : names) {
+        bool known = false;
+
+        for (const auto intent : AllIntents) {
+            if (intentName(intent) == name) {
+                known = true;
+                Q_EMIT intentReceived(intent);
+                break;
+            }
+        }
+
+        if (!known) {
+            Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("ignoring unknown intent %1 from another instance").arg(name));
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/**
+ * InstanceLock.h
+ *
+ * Declaration of InstanceLock class.
+ */
+
+#ifndef ONEDRIVETRAY_INSTANCELOCK_H
+#define ONEDRIVETRAY_INSTANCELOCK_H
+
+#include <memory>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtNetwork/QLocalServer>
+
+QT_BEGIN_NAMESPACE
+class QLocalSocket;
+class QLockFile;
+QT_END_NAMESPACE
+
+namespace OneDrive
+{
+    /**
+     * Ensures only one instance runs the onedrive client for a config directory.
+     *
+     * Two onedrive clients using the same config directory share an items database and fight over it. The first
+     * instance for a config directory holds a lock file and listens on a local socket; a later instance finds the lock
+     * held, forwards what its command line asked for to the first instance over the socket, and exits.
+     *
+     * Instances for different config directories don't interfere with each other.
+     */
+    class InstanceLock
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** What a later launch asks the running instance to do. */
+        enum class Intent
+        {
+            ShowMessages,
+            Pause,
+            OpenFolder,
+        };
+
+        /** How long a later instance waits for the running instance to answer (ms). */
+        static constexpr const int ForwardTimeout = 2000;
+
+        explicit InstanceLock(QObject * parent = nullptr);
+
+        ~InstanceLock() override;
+
+        /**
+         * Try to become the running instance for a config directory.
+         *
+         * @param instanceKey The key for the onedrive client's config directory, from
+         * SynchronisationService::instanceKey().
+         *
+         * @return false if another instance holds the lock. If the lock or the socket can't be created the reason is
+         * logged and true is returned, so that a problem with the lock never stops the program running.
+         */
+        bool acquire(const QString & instanceKey);
+
+        /**
+         * Ask the running instance to carry out some intents.
+         *
+         * Blocks for up to ForwardTimeout ms. Call this after acquire() has returned false.
+         *
+         * @return true if the running instance acknowledged the intents.
+         */
+        bool forward(const QList<Intent> & intents) const;
+
+        /** The name of an intent, as sent over the socket and given on the command line. */
+        [[nodiscard]] static QString intentName(Intent intent);
+
+    Q_SIGNALS:
+        /** Emitted in the running instance when a later launch asks it to do something. */
+        void intentReceived(OneDrive::InstanceLock::Intent intent);
+
+    private:
+        /** Accept the waiting connections from later instances. */
+        void onNewConnection();
+
+        /** Read the intents from a later instance once the line is complete. */
+        void onReadyRead(QLocalSocket * socket);
+
+        /** The path of the socket for the config directory, without extension. */
+        QString m_path;
+
+        /** Held by the running instance. */
+        std::unique_ptr<QLockFile> m_lockFile;
+
+        /** Receives the intents from later instances. */
+        QLocalServer m_server;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_INSTANCELOCK_H
@@ -0,0 +1,476 @@
+/**
+ * Logger.cpp
+ *
+ * Implementation of Logger class.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include "Logger.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /** The number of records in each thread's ring. Must be a power of 2. */
+    constexpr const std::size_t RingCapacity = 512;
+
+    /** How often the writer drains the rings when they're not filling up quickly. */
+    constexpr const auto FlushInterval = std::chrono::milliseconds(250);
+
+    /** The size of the chunks in which rotated logs are compressed. */
+    constexpr const std::size_t CompressionChunkSize = 64 * 1024;
+
+    struct LogRecord
+    {
+        /** ms since the epoch. */
+        std::int64_t timestamp;
+        LogLevel level;
+        LogCategory category;
+        std::uint16_t length;
+        std::array<char, Logger::MaximumMessageLength> text;
+    };
+
+    /**
+     * A single-producer, single-consumer ring of log records.
+     *
+     * Only the owning thread advances the tail and only the writer thread advances the head, so neither needs a lock.
+     */
+    struct LogRing
+    {
+        explicit LogRing(std::uint64_t id)
+                : records(),
+                  head(0),
+                  tail(0),
+                  dropped(0),
+                  closed(false),
+                  threadId(id)
+        {}
+
+        std::array<LogRecord, RingCapacity> records;
+        std::atomic_size_t head;
+        std::atomic_size_t tail;
+        std::atomic_uint64_t dropped;
+
+        /** Set when the owning thread exits; the writer discards the ring once it's empty. */
+        std::atomic_bool closed;
+        std::uint64_t threadId;
+    };
+
+    struct LoggerState
+    {
+        ~LoggerState();
+
+        std::atomic_int minimumLevel{static_cast<int>(LogLevel::Info)};
+        std::atomic_bool echo{false};
+
+        std::mutex ringsMutex;
+        std::vector<std::shared_ptr<LogRing>> rings;
+
+        std::mutex writerMutex;
+        std::condition_variable wake;
+        bool running = false;
+        std::thread writer;
+
+        // only used by the writer thread while it's running
+        std::string path;
+        std::FILE * file = nullptr;
+        qint64 fileSize = 0;
+        qint64 maximumFileSize = Logger::DefaultMaximumFileSize;
+        int maximumFiles = Logger::DefaultMaximumFiles;
+    };
+
+    LoggerState & loggerState()
+    {
+        static LoggerState state;
+        return state;
+    }
+
+    /** Owns the calling thread's ring and marks it closed when the thread exits. */
+    struct ThreadRing
+    {
+        ~ThreadRing()
+        {
+            if (ring) {
+                ring->closed.store(true, std::memory_order_release);
+            }
+        }
+
+        std::shared_ptr<LogRing> ring;
+    };
+
+    LogRing & threadRing()
+    {
+        thread_local ThreadRing local;
+
+        if (!local.ring) {
+            local.ring = std::make_shared<LogRing>(static_cast<std::uint64_t>(::syscall(SYS_gettid)));
+            auto & state = loggerState();
+            std::lock_guard lock(state.ringsMutex);
+            state.rings.push_back(local.ring);
+        }
+
+        return *local.ring;
+    }
+
+    void appendLine(std::string & out, std::int64_t timestamp, LogLevel level, LogCategory category, std::uint64_t threadId, const char * text, std::size_t length)
+    {
+        const auto seconds = static_cast<std::time_t>(timestamp / 1000);
+        std::tm time{};
+        ::localtime_r(&seconds, &time);
+        std::array<char, 64> prefix{};
+        const auto timeLength = std::strftime(prefix.data(), prefix.size(), "%Y-%m-%d %H:%M:%S", &time);
+        std::snprintf(prefix.data() + timeLength, prefix.size() - timeLength, ".%03d ", static_cast<int>(timestamp % 1000));
+        out += prefix.data();
+        out += Logger::levelName(level);
+        out += " [";
+        out += Logger::categoryName(category);
+        out += "] ";
+        out += std::to_string(threadId);
+        out += ": ";
+        out.append(text, length);
+        out += '\n';
+    }
+
+    /** Compress a file with gzip. */
+    bool compressFile(const std::string & source, const std::string & destination)
+    {
+        auto * in = std::fopen(source.c_str(), "rbe");
+
+        if (!in) {
+            return false;
+        }
+
+        auto out = ::gzopen(destination.c_str(), "wb6");
+
+        if (!out) {
+            std::fclose(in);
+            return false;
+        }
+
+        std::vector<char> chunk(CompressionChunkSize);
+        bool success = true;
+
+        while (const auto bytes = std::fread(chunk.data(), 1, chunk.size(), in)) {
+            if (static_cast<int>(bytes) != ::gzwrite(out, chunk.data(), static_cast<unsigned>(bytes))) {
+                success = false;
+                break;
+            }
+        }
+
+        std::fclose(in);
+        return Z_OK == ::gzclose(out) && success;
+    }
+
+    void openLogFile(LoggerState & state)
+    {
+        state.file = std::fopen(state.path.c_str(), "ae");
+        state.fileSize = 0;
+
+        if (state.file && 0 == std::fseek(state.file, 0, SEEK_END)) {
+            state.fileSize = std::ftell(state.file);
+        }
+    }
+
+    /** Rotate the log file: log.N.gz -> log.N+1.gz, log -> log.1.gz. */
+    void rotateLogFile(LoggerState & state)
+    {
+        std::fclose(state.file);
+        state.file = nullptr;
+
+        const auto rotatedPath = [&state](int index) -> std::string {
+            return state.path + '.' + std::to_string(index) + ".gz";
+        };
+
+        if (0 < state.maximumFiles) {
+            std::remove(rotatedPath(state.maximumFiles).c_str());
+
+            for (auto index = state.maximumFiles - 1; 0 < index; --index) {
+                std::rename(rotatedPath(index).c_str(), rotatedPath(index + 1).c_str());
+            }
+
+            // renamed first so that nothing is lost if the compression is interrupted
+            const auto uncompressedPath = state.path + ".1";
+
+            if (0 == std::rename(state.path.c_str(), uncompressedPath.c_str()) && compressFile(uncompressedPath, rotatedPath(1))) {
+                std::remove(uncompressedPath.c_str());
+            }
+        } else {
+            std::remove(state.path.c_str());
+        }
+
+        openLogFile(state);
+    }
+
+    /** Write out everything in the rings, in time order. */
+    void drainRings(LoggerState & state)
+    {
+        std::vector<std::shared_ptr<LogRing>> rings;
+
+        {
+            std::lock_guard lock(state.ringsMutex);
+            rings = state.rings;
+        }
+
+        // (timestamp, formatted line), sorted so that messages from different threads are interleaved correctly
+        std::vector<std::pair<std::int64_t, std::string>> lines;
+
+        for (const auto & ring : rings) {
+            const auto head = ring->head.load(std::memory_order_relaxed);
+            const auto tail = ring->tail.load(std::memory_order_acquire);
+
+            for (auto index = head; index != tail; ++index) {
+                const auto & record = ring->records[index % RingCapacity];
+                auto & entry = lines.emplace_back(record.timestamp, std::string());
+                appendLine(entry.second, record.timestamp, record.level, record.category, ring->threadId, record.text.data(), record.length);
+            }
+
+            ring->head.store(tail, std::memory_order_release);
+
+            if (const auto dropped = ring->dropped.exchange(0, std::memory_order_relaxed); 0 < dropped) {
+                const auto message = std::to_string(dropped) + " messages dropped because the log could not keep up";
+                const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                auto & entry = lines.emplace_back(now, std::string());
+                appendLine(entry.second, now, LogLevel::Warning, LogCategory::Application, ring->threadId, message.data(), message.size());
+            }
+        }
+
+        {
+            std::lock_guard lock(state.ringsMutex);
+
+            state.rings.erase(
+                    std::remove_if(state.rings.begin(), state.rings.end(), [](const std::shared_ptr<LogRing> & ring) -> bool {
+                        return ring->closed.load(std::memory_order_acquire) && ring->head.load(std::memory_order_relaxed) == ring->tail.load(std::memory_order_acquire);
+                    }),
+                    state.rings.end()
+            );
+        }
+
+        if (lines.empty()) {
+            return;
+        }
+
+        std::stable_sort(lines.begin(), lines.end(), [](const auto & first, const auto & second) -> bool {
+            return first.first < second.first;
+        });
+
+        const auto echo = state.echo.load(std::memory_order_relaxed);
+
+        for (const auto & [timestamp, line] : lines) {
+            if (state.file) {
+                std::fwrite(line.data(), 1, line.size(), state.file);
+                state.fileSize += static_cast<qint64>(line.size());
+            }
+
+            if (echo) {
+                std::fwrite(line.data(), 1, line.size(), stderr);
+            }
+        }
+
+        if (echo) {
+            std::fflush(stderr);
+        }
+
+        if (!state.file) {
+            return;
+        }
+
+        std::fflush(state.file);
+
+        if (state.fileSize >= state.maximumFileSize) {
+            rotateLogFile(state);
+        }
+    }
+
+    void runWriter(LoggerState & state)
+    {
+        std::unique_lock lock(state.writerMutex);
+
+        while (state.running) {
+            state.wake.wait_for(lock, FlushInterval);
+            lock.unlock();
+            drainRings(state);
+            lock.lock();
+        }
+
+        lock.unlock();
+        drainRings(state);
+    }
+
+    void stopWriter(LoggerState & state)
+    {
+        {
+            std::lock_guard lock(state.writerMutex);
+
+            if (!state.running) {
+                return;
+            }
+
+            state.running = false;
+        }
+
+        state.wake.notify_one();
+        state.writer.join();
+
+        if (state.file) {
+            std::fclose(state.file);
+            state.file = nullptr;
+        }
+    }
+
+    LoggerState::~LoggerState()
+    {
+        stopWriter(*this);
+    }
+}
+
+
+bool Logger::start(const QString & path, qint64 maximumFileSize, int maximumFiles)
+{
+    auto & state = loggerState();
+    stopWriter(state);
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    state.path = QFile::encodeName(path).toStdString();
+    state.maximumFileSize = std::max<qint64>(maximumFileSize, MaximumMessageLength);
+    state.maximumFiles = std::max(0, maximumFiles);
+    openLogFile(state);
+
+    {
+        std::lock_guard lock(state.writerMutex);
+        state.running = true;
+    }
+
+    state.writer = std::thread(runWriter, std::ref(state));
+    return nullptr != state.file;
+}
+
+
+void Logger::stop()
+{
+    stopWriter(loggerState());
+}
+
+
+void Logger::setMinimumLevel(LogLevel level)
+{
+    loggerState().minimumLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+
+bool Logger::isEnabled(LogLevel level)
+{
+    return static_cast<int>(level) >= loggerState().minimumLevel.load(std::memory_order_relaxed);
+}
+
+
+void Logger::setEchoToStderr(bool echo)
+{
+    loggerState().echo.store(echo, std::memory_order_relaxed);
+}
+
+
+void Logger::log(LogLevel level, LogCategory category, const QByteArray & message)
+{
+    if (!isEnabled(level)) {
+        return;
+    }
+
+    auto & ring = threadRing();
+    const auto tail = ring.tail.load(std::memory_order_relaxed);
+    const auto queued = tail - ring.head.load(std::memory_order_acquire);
+
+    if (RingCapacity <= queued) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto length = message.size();
+
+    while (0 < length && ('\n' == message[length - 1] || '\r' == message[length - 1])) {
+        --length;
+    }
+
+    if (MaximumMessageLength < length) {
+        length = MaximumMessageLength;
+
+        // don't split a UTF-8 sequence
+        while (0 < length && 0x80 == (static_cast<unsigned char>(message[length]) & 0xc0)) {
+            --length;
+        }
+    }
+
+    auto & record = ring.records[tail % RingCapacity];
+    record.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    record.level = level;
+    record.category = category;
+    record.length = static_cast<std::uint16_t>(length);
+    std::memcpy(record.text.data(), message.constData(), static_cast<std::size_t>(length));
+    ring.tail.store(tail + 1, std::memory_order_release);
+
+    // don't wait for the flush interval if the ring is filling up
+    if (RingCapacity / 2 == queued + 1) {
+        loggerState().wake.notify_one();
+    }
+}
+
+
+const char * Logger::levelName(LogLevel level)
+{
+    switch (level) {
+        case LogLevel::Debug:
+            return "DEBUG";
+
+        case LogLevel::Info:
+            return "INFO";
+
+        case LogLevel::Warning:
+            return "WARNING";
+
+        case LogLevel::Error:
+            return "ERROR";
+    }
+
+    return "?";
+}
+
+
+const char * Logger::categoryName(LogCategory category)
+{
+    switch (category) {
+        case LogCategory::Application:
+            return "application";
+
+        case LogCategory::Process:
+            return "process";
+
+        case LogCategory::ClientOutput:
+            return "client-output";
+
+        case LogCategory::ClientError:
+            return "client-error";
+
+        case LogCategory::Supervisor:
+            return "supervisor";
+    }
+
+    return "?";
+}
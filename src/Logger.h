@@ -0,0 +1,114 @@
+/**
+ * Logger.h
+ *
+ * Declaration of Logger class.
+ */
+
+#ifndef ONEDRIVETRAY_LOGGER_H
+#define ONEDRIVETRAY_LOGGER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+namespace OneDrive
+{
+    /** Enumeration of the severities of log messages. */
+    enum class LogLevel
+    {
+        Debug = 0,
+        Info,
+        Warning,
+        Error,
+    };
+
+    /** Enumeration of the parts of the application log messages come from. */
+    enum class LogCategory
+    {
+        Application = 0,
+        Process,
+        ClientOutput,
+        ClientError,
+        Supervisor,
+    };
+
+    /**
+     * Asynchronous logger.
+     *
+     * Each thread that logs gets its own lock-free ring buffer of fixed-size records, so logging never blocks and
+     * never allocates once the ring exists. A background thread drains the rings, writes the messages to the log file
+     * (and optionally stderr), and rotates the file when it reaches its size limit, compressing the old logs with
+     * gzip. If a thread logs faster than the writer can keep up with, messages are dropped and the number dropped is
+     * written to the log instead.
+     *
+     * Messages can be logged before start() is called; they are buffered (subject to the ring capacity) and written
+     * once it is.
+     */
+    class Logger
+    {
+    public:
+        /** The size at which the log file is rotated. */
+        static constexpr const qint64 DefaultMaximumFileSize = 10 * 1024 * 1024;
+
+        /** The number of rotated log files kept. */
+        static constexpr const int DefaultMaximumFiles = 5;
+
+        /** Messages longer than this (in UTF-8 bytes) are truncated. */
+        static constexpr const int MaximumMessageLength = 480;
+
+        Logger() = delete;
+
+        /**
+         * Start writing log messages to a file.
+         *
+         * @param path The log file. Its directory is created if necessary.
+         * @param maximumFileSize The size at which to rotate the file.
+         * @param maximumFiles The number of rotated files to keep.
+         *
+         * @return false if the file can't be opened. Messages are still echoed to stderr if that is enabled.
+         */
+        static bool start(const QString & path, qint64 maximumFileSize = DefaultMaximumFileSize, int maximumFiles = DefaultMaximumFiles);
+
+        /** Write any outstanding messages and stop the writer thread. */
+        static void stop();
+
+        /** Set the least severe level that is logged. */
+        static void setMinimumLevel(LogLevel level);
+
+        /** Whether messages at a level are logged. Check this before doing any work to build a message. */
+        [[nodiscard]] static bool isEnabled(LogLevel level);
+
+        /** Set whether messages are also written to stderr. */
+        static void setEchoToStderr(bool echo);
+
+        /**
+         * Log a message.
+         *
+         * @param level The message's severity.
+         * @param category Where the message comes from.
+         * @param message The message, in UTF-8. Trailing line breaks are removed.
+         */
+        static void log(LogLevel level, LogCategory category, const QByteArray & message);
+
+        /**
+         * Log a message.
+         *
+         * @param level The message's severity.
+         * @param category Where the message comes from.
+         * @param message The message.
+         */
+        static inline void log(LogLevel level, LogCategory category, const QString & message)
+        {
+            if (isEnabled(level)) {
+                log(level, category, message.toUtf8());
+            }
+        }
+
+        /** The name of a log level, as written in the log. */
+        [[nodiscard]] static const char * levelName(LogLevel level);
+
+        /** The name of a log category, as written in the log. */
+        [[nodiscard]] static const char * categoryName(LogCategory category);
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_LOGGER_H
@@ -0,0 +1,189 @@
+/**
+ * MessageListModel.cpp
+ *
+ * Implementation of MessageListModel class.
+ */
+
+#include <algorithm>
+#include <QtCore/QDateTime>
+#include <QtGui/QColor>
+#include "MessageListModel.h"
+
+using namespace OneDrive;
+
+
+MessageListModel::MessageListModel(QObject * parent)
+        : QAbstractItemModel(parent),
+          m_messages(),
+          m_firstSerial(1),
+          m_locale(QLocale::system()),
+          m_timeFormat(m_locale.dateTimeFormat(QLocale::ShortFormat)),
+          m_formattedSecond(-1),
+          m_formattedTime()
+{
+}
+
+
+MessageListModel::~MessageListModel() = default;
+
+
+QModelIndex MessageListModel::index(int row, int column, const QModelIndex & parent) const
+{
+    if (0 != column || 0 > row) {
+        return {};
+    }
+
+    if (!parent.isValid()) {
+        return row < m_messages.size() ? createIndex(row, 0, quintptr(0)) : QModelIndex();
+    }
+
+    // only messages have children
+    if (0 != parent.internalId() || parent.row() >= m_messages.size() || row >= m_messages.at(parent.row()).items.size()) {
+        return {};
+    }
+
+    return createIndex(row, 0, m_firstSerial + static_cast<quintptr>(parent.row()));
+}
+
+
+QModelIndex MessageListModel::parent(const QModelIndex & index) const
+{
+    const auto row = parentRow(index);
+    return 0 > row ? QModelIndex() : createIndex(row, 0, quintptr(0));
+}
+
+
+int MessageListModel::rowCount(const QModelIndex & parent) const
+{
+    if (!parent.isValid()) {
+        return m_messages.size();
+    }
+
+    if (0 != parent.internalId() || parent.row() >= m_messages.size()) {
+        return 0;
+    }
+
+    return m_messages.at(parent.row()).items.size();
+}
+
+
+int MessageListModel::columnCount(const QModelIndex &) const
+{
+    return 1;
+}
+
+
+QVariant MessageListModel::data(const QModelIndex & index, int role) const
+{
+    if (!index.isValid() || 0 > index.row()) {
+        return {};
+    }
+
+    const Message * message;
+    const QString * text;
+
+    if (0 == index.internalId()) {
+        if (m_messages.size() <= index.row()) {
+            return {};
+        }
+
+        message = &m_messages.at(index.row());
+        text = &message->text;
+    } else {
+        const auto row = parentRow(index);
+
+        if (0 > row || m_messages.at(row).items.size() <= index.row()) {
+            return {};
+        }
+
+        message = &m_messages.at(row);
+        text = &message->items.at(index.row());
+    }
+
+    switch (role) {
+        case Qt::DisplayRole:
+            // items are shown without a time, under their summary
+            if (0 != index.internalId()) {
+                return *text;
+            }
+
+            return formatTime(message->time) + QStringLiteral("  ") + *text;
+
+        case Qt::ToolTipRole:
+            return *text;
+
+        case Qt::ForegroundRole:
+            switch (message->kind) {
+                case Kind::Info:
+                    return {};
+
+                case Kind::Operation:
+                    return QColor(Qt::blue);
+
+                case Kind::Error:
+                    return QColor(Qt::red);
+            }
+
+            break;
+    }
+
+    return {};
+}
+
+
+void MessageListModel::addMessage(qint64 time, Kind kind, const QString & text)
+{
+    addMessages({{time, kind, text}});
+}
+
+
+void MessageListModel::addMessages(const QVector<Message> & messages)
+{
+    if (messages.isEmpty()) {
+        return;
+    }
+
+    // only the newest Capacity of a large batch are kept, so there's no point inserting the others
+    const auto first = std::max(0, messages.size() - Capacity);
+    const auto count = messages.size() - first;
+    const auto excess = m_messages.size() + count - Capacity;
+
+    if (0 < excess) {
+        beginRemoveRows({}, 0, excess - 1);
+        m_messages.erase(m_messages.begin(), m_messages.begin() + excess);
+        m_firstSerial += static_cast<quintptr>(excess);
+        endRemoveRows();
+    }
+
+    beginInsertRows({}, m_messages.size(), m_messages.size() + count - 1);
+
+    for (auto message = messages.cbegin() + first; message != messages.cend(); ++message) {
+        m_messages.append(*message);
+    }
+
+    endInsertRows();
+}
+
+
+int MessageListModel::parentRow(const QModelIndex & index) const
+{
+    if (!index.isValid() || 0 == index.internalId() || index.internalId() < m_firstSerial) {
+        return -1;
+    }
+
+    const auto row = index.internalId() - m_firstSerial;
+    return row < static_cast<quintptr>(m_messages.size()) ? static_cast<int>(row) : -1;
+}
+
+
+const QString & MessageListModel::formatTime(qint64 time) const
+{
+    const auto second = time / 1000;
+
+    if (second != m_formattedSecond) {
+        m_formattedTime = m_locale.toString(QDateTime::fromMSecsSinceEpoch(time), m_timeFormat);
+        m_formattedSecond = second;
+    }
+
+    return m_formattedTime;
+}
@@ -0,0 +1,108 @@
+/**
+ * MessageListModel.h
+ *
+ * Declaration of MessageListModel class.
+ */
+
+#ifndef ONEDRIVETRAY_MESSAGELISTMODEL_H
+#define ONEDRIVETRAY_MESSAGELISTMODEL_H
+
+#include <QtCore/QAbstractItemModel>
+#include <QtCore/QList>
+#include <QtCore/QLocale>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+namespace OneDrive
+{
+    /**
+     * The messages shown in the messages window.
+     *
+     * Each message holds the time it was stamped with when the client's output was read, not the time it was added.
+     * The time is only formatted when a view asks for a row, so messages added while the window is hidden cost no
+     * formatting, and the formatted time of the last second asked for is cached because neighbouring rows usually
+     * share it.
+     *
+     * A message that summarises a bulk operation has the operation's items as its children.
+     */
+    class MessageListModel
+            : public QAbstractItemModel
+    {
+    Q_OBJECT
+
+    public:
+        enum class Kind
+        {
+            Info = 0,
+            Operation,
+            Error,
+        };
+
+        struct Message
+        {
+            /** When the message's event happened, in ms since the epoch. */
+            qint64 time = 0;
+
+            Kind kind = Kind::Info;
+            QString text;
+
+            /** The items, for a message that summarises a bulk operation. */
+            QStringList items = {};
+        };
+
+        /** The number of messages kept. Once there are this many, the oldest are removed as new ones are added. */
+        static constexpr const int Capacity = 5000;
+
+        explicit MessageListModel(QObject * parent = nullptr);
+
+        ~MessageListModel() override;
+
+        [[nodiscard]] QModelIndex index(int row, int column, const QModelIndex & parent = {}) const override;
+
+        [[nodiscard]] QModelIndex parent(const QModelIndex & index) const override;
+
+        [[nodiscard]] int rowCount(const QModelIndex & parent = {}) const override;
+
+        [[nodiscard]] int columnCount(const QModelIndex & parent = {}) const override;
+
+        [[nodiscard]] QVariant data(const QModelIndex & index, int role) const override;
+
+        /** Add a message. */
+        void addMessage(qint64 time, Kind kind, const QString & text);
+
+        /** Add several messages at once, oldest first. */
+        void addMessages(const QVector<Message> & messages);
+
+    private:
+        /** Format a time for display, reusing the previous result if it's in the same second. */
+        [[nodiscard]] const QString & formatTime(qint64 time) const;
+
+        /**
+         * Find the message an index is or belongs to.
+         *
+         * @return The message's row, or -1 if the index is a top-level index or is no longer valid.
+         */
+        [[nodiscard]] int parentRow(const QModelIndex & index) const;
+
+        QList<Message> m_messages;
+
+        /**
+         * The serial number of the first message.
+         *
+         * Messages are numbered from 1 as they are added, and an item's index holds its message's number, so that it
+         * stays correct as the oldest messages are removed.
+         */
+        quintptr m_firstSerial;
+
+        /** The locale and its short date and time format, looked up once. */
+        QLocale m_locale;
+        QString m_timeFormat;
+
+        /** The second (since the epoch) that m_formattedTime is for. */
+        mutable qint64 m_formattedSecond;
+        mutable QString m_formattedTime;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_MESSAGELISTMODEL_H
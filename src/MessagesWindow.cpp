@@ -5,26 +5,48 @@
  */
 
 #include <stdexcept>
-#include <QtCore/QDateTime>
+#include <QtCore/QLocale>
 #include <QtCore/QSettings>
-#include <QtWidgets/QPlainTextEdit>
+#include <QtWidgets/QTreeView>
 #include <QtWidgets/QComboBox>
 #include <QtGui/QCloseEvent>
 #include <QtCore/QDebug>
 #include <QtWidgets/QGroupBox>
+#include <QtWidgets/QLabel>
 #include <QtWidgets/QLineEdit>
 #include <QtWidgets/QPushButton>
 #include <QtWidgets/QVBoxLayout>
 #include "MessagesWindow.h"
 #include "Application.h"
+#include "Formatting.h"
 
 using namespace OneDrive;
 
-MessagesWindow::MessagesWindow(const Process & process)
+namespace
+{
+    /** The events shown in the window. */
+    constexpr const EventBus::EventTypes MessageEventTypes = EventBus::ItemEventTypes
+            | EventBus::typeMask(EventBus::EventType::Started)
+            | EventBus::typeMask(EventBus::EventType::Stopped)
+            | EventBus::typeMask(EventBus::EventType::SynchronisationComplete)
+            | EventBus::typeMask(EventBus::EventType::LocalRootDirectoryRemoved)
+            | EventBus::typeMask(EventBus::EventType::FreeSpaceUpdated);
+
+    /** A folder for display, with the root of the sync directory shown as "/". */
+    QString displayDirectory(const QString & directory)
+    {
+        return directory.isEmpty() ? QStringLiteral("/") : directory;
+    }
+}
+
+MessagesWindow::MessagesWindow(const Process & process, EventBus & eventBus)
 : QDialog(),
   m_process(process),
+  m_compactor(eventBus, MessageEventTypes),
   m_messagesContainer(nullptr),
-  m_eventsList(nullptr)
+  m_messages(),
+  m_eventsList(nullptr),
+  m_resourceUsage(nullptr)
 {
     loadSettings();
     createMessageGroupBox();
@@ -41,11 +63,17 @@ MessagesWindow::MessagesWindow(const Process & process)
     }
 
     connectProcess();
-    addInfoMessage(tr("OneDrive started"));
+    addInfoMessage(tr("OneDrive started"), Process::currentTimestamp());
 }
 
 MessagesWindow::~MessagesWindow() = default;
 
+void MessagesWindow::setResourceUsage(const QString & usage)
+{
+    m_resourceUsage->setText(usage);
+    m_resourceUsage->setVisible(!usage.isEmpty());
+}
+
 void MessagesWindow::closeEvent(QCloseEvent * event)
 {
 #ifdef Q_OS_OSX
@@ -61,81 +89,186 @@ void MessagesWindow::closeEvent(QCloseEvent * event)
 
 void MessagesWindow::connectProcess()
 {
-    connect(&m_process, &Process::started, [this] () {
-        addInfoMessage(tr("Synchronization restarted"));
-    });
+    connect(&m_compactor, &EventCompactor::entriesReady, this, &MessagesWindow::addEntries);
 
-    connect(&m_process, &Process::synchronisationComplete, [this]( ) {
-        addInfoMessage(tr("Synchronisation completed"));
-    });
+    // the cycle timings aren't an event on the bus
+    connect(&m_process, &Process::synchronisationCycleCompleted, this, [this] (const Process::SynchronisationCycle & cycle) {
+        const auto phaseDuration = [&cycle](Process::SynchronisationState phase) -> QString {
+            return formatDuration(cycle.phaseDurations[static_cast<int>(phase)]);
+        };
 
-    connect(&m_process, &Process::localRootDirectoryRemoved, [this] () {
-        addInfoMessage(tr("The local synchronisation directory was not found"));
+        addInfoMessage(tr("Synchronisation took %1 (starting %2, scanning %3, fetching %4, transferring %5)").arg(
+                formatDuration(cycle.duration),
+                phaseDuration(Process::SynchronisationState::Starting),
+                phaseDuration(Process::SynchronisationState::ScanningLocal),
+                phaseDuration(Process::SynchronisationState::FetchingRemote),
+                phaseDuration(Process::SynchronisationState::Transferring)
+        ), cycle.end);
     });
+}
 
-    connect(&m_process, &Process::freeSpaceUpdated, [this] (uint64_t bytes) {
-        addInfoMessage(tr("Free space updated to %1 bytes").arg(bytes));
-    });
+void MessagesWindow::addEntries(const EventCompactor::Entries & entries)
+{
+    QVector<MessageListModel::Message> messages;
+    messages.reserve(entries.size());
 
-    connect(&m_process, &Process::stopped, [this] () {
-        addInfoMessage(tr("Synchronization suspended"));
-    });
+    const auto info = [&messages](const EventBus::Event & event, const QString & text) {
+        messages.append({event.time, MessageListModel::Kind::Info, text});
+    };
 
-    connect(&m_process, &Process::fileDeleted, [this] (const QString & fileName) {
-        addOperationMessage(tr("Deleted"), fileName);
-    });
+    const auto operation = [&messages](const EventBus::Event & event, const QString & operation, const QString & fileName) {
+        messages.append({event.time, MessageListModel::Kind::Operation, operation + ", " + fileName});
+    };
 
-    connect(&m_process, &Process::fileRenamed, [this] (const QString & from, const QString & to) {
-        addOperationMessage(tr("Renamed"), tr("'%1' to '%2'").arg(from, to));
-    });
+    for (const auto & entry : entries) {
+        const auto & event = entry.event;
 
-    connect(&m_process, &Process::fileUploaded, [this] (const QString & fileName) {
-        addOperationMessage(tr("Uploaded"), fileName);
-    });
+        if (entry.isSummary()) {
+            const auto count = static_cast<int>(entry.items.size());
+            QString text;
 
-    connect(&m_process, &Process::fileDownloaded, [this] (const QString & fileName) {
-        addOperationMessage(tr("Downloaded"), fileName);
-    });
+            switch (event.type) {
+                case EventBus::EventType::Renamed:
+                    text = tr("Moved %1 \u2192 %2 (%Ln item(s))", nullptr, count).arg(displayDirectory(event.path), displayDirectory(event.detail));
+                    break;
 
-    connect(&m_process, &Process::localDirectoryCreated, [this] (const QString & dirName) {
-        addOperationMessage(tr("Local directory created"), dirName);
-    });
+                case EventBus::EventType::Deleted:
+                    text = tr("Deleted %1 (%Ln item(s))", nullptr, count).arg(displayDirectory(event.path));
+                    break;
 
-    connect(&m_process, &Process::remoteDirectoryCreated, [this] (const QString & dirName) {
-        addOperationMessage(tr("Remote directory created"), dirName);
-    });
+                case EventBus::EventType::Uploaded:
+                    text = tr("Uploaded %Ln item(s) in %1", nullptr, count).arg(displayDirectory(event.path));
+                    break;
 
-    connect(&m_process, &Process::fileDownloaded, [this] (const QString & fileName) {
-        addOperationMessage(tr("Downloaded"), fileName);
-    });
+                case EventBus::EventType::Downloaded:
+                    text = tr("Downloaded %Ln item(s) in %1", nullptr, count).arg(displayDirectory(event.path));
+                    break;
+
+                case EventBus::EventType::LocalDirectoryCreated:
+                    text = tr("Created %Ln local folder(s) in %1", nullptr, count).arg(displayDirectory(event.path));
+                    break;
+
+                case EventBus::EventType::RemoteDirectoryCreated:
+                    text = tr("Created %Ln remote folder(s) in %1", nullptr, count).arg(displayDirectory(event.path));
+                    break;
+
+                default:
+                    // only item events are compacted
+                    continue;
+            }
+
+            QStringList items;
+            items.reserve(count);
+
+            for (const auto & item : entry.items) {
+                items.append(EventBus::EventType::Renamed == item.type ? tr("'%1' to '%2'").arg(item.path, item.detail) : item.path);
+            }
+
+            messages.append({event.time, MessageListModel::Kind::Operation, text, items});
+            continue;
+        }
+
+        switch (event.type) {
+            case EventBus::EventType::Started:
+                info(event, tr("Synchronization restarted"));
+                break;
+
+            case EventBus::EventType::SynchronisationComplete:
+                info(event, tr("Synchronisation completed"));
+                break;
+
+            case EventBus::EventType::LocalRootDirectoryRemoved:
+                info(event, tr("The local synchronisation directory was not found"));
+                break;
+
+            case EventBus::EventType::FreeSpaceUpdated:
+                info(event, tr("Free space updated to %1 bytes").arg(event.size));
+                break;
+
+            case EventBus::EventType::Stopped:
+                info(event, tr("Synchronization suspended"));
+                break;
+
+            case EventBus::EventType::Deleted:
+                operation(event, tr("Deleted"), event.path);
+                break;
+
+            case EventBus::EventType::Renamed:
+                operation(event, tr("Renamed"), tr("'%1' to '%2'").arg(event.path, event.detail));
+                break;
+
+            case EventBus::EventType::Uploaded:
+                operation(event, tr("Uploaded"), event.path);
+                break;
+
+            case EventBus::EventType::Downloaded:
+                operation(event, tr("Downloaded"), event.path);
+                break;
+
+            case EventBus::EventType::LocalDirectoryCreated:
+                operation(event, tr("Local directory created"), event.path);
+                break;
+
+            case EventBus::EventType::RemoteDirectoryCreated:
+                operation(event, tr("Remote directory created"), event.path);
+                break;
+
+            case EventBus::EventType::Error:
+                // errors are classified and added by the application
+                break;
+        }
+    }
+
+    m_messages.addMessages(messages);
 }
 
-void MessagesWindow::addInfoMessage(const QString & info)
+void MessagesWindow::addInfoMessage(const QString & info, const Process::Timestamp & time)
 {
-    m_eventsList->appendHtml("<p><span style=\"color:gray;\">" + QDateTime::currentDateTime().toString(QLocale::system().dateFormat(QLocale::ShortFormat)) +
-                             " </span><span style=\"color:black;\"> " + info + "</span></p>");
+    m_messages.addMessage(time.wallTime, MessageListModel::Kind::Info, info);
 }
 
-void MessagesWindow::addErrorMessage(const QString & error)
+void MessagesWindow::addErrorMessage(const QString & error, const Process::Timestamp & time)
 {
-    m_eventsList->appendHtml("<p><span style=\"color:gray;\">" + QDateTime::currentDateTime().toString(QLocale::system().dateFormat(QLocale::ShortFormat)) +
-                             " </span><span style=\"color:red;\"> " + error + "</span></p>");
+    m_messages.addMessage(time.wallTime, MessageListModel::Kind::Error, error);
 }
 
-void MessagesWindow::addOperationMessage(const QString & operation, const QString & fileName)
+void MessagesWindow::addLastSessionEvents(const QVector<EventBus::Event> & events)
 {
-    m_eventsList->appendHtml("<p><span style=\"color:gray;\">" + QDateTime::currentDateTime().toString(QLocale::system().dateFormat(QLocale::ShortFormat)) +
-                             "</span><span style=\"color:blue;\"> " + operation + ", <b>" + fileName + "</b> </span></p>");
+    if (events.isEmpty()) {
+        return;
+    }
+
+    EventCompactor::Entries entries;
+    entries.reserve(events.size());
+
+    for (const auto & event : events) {
+        entries.append({event, {}});
+    }
+
+    // the saved events have no monotonic time, which isn't needed for display
+    addInfoMessage(tr("Events from the last session:"), {events.first().time, 0});
+    addEntries(entries);
+    addInfoMessage(tr("End of the last session"), {events.last().time, 0});
 }
 
 void MessagesWindow::createMessageGroupBox()
 {
-    m_eventsList = new QPlainTextEdit(this);
-    m_eventsList->setReadOnly(true);
-    m_eventsList->setMaximumBlockCount(5000);
+    // with uniform row heights the view only asks the model for the rows it shows
+    m_eventsList = new QTreeView(this);
+    m_eventsList->setModel(&m_messages);
+    m_eventsList->setHeaderHidden(true);
+    m_eventsList->setUniformRowHeights(true);
+    m_eventsList->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_eventsList->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    connect(&m_messages, &QAbstractItemModel::rowsInserted, m_eventsList, &QAbstractItemView::scrollToBottom);
 
     auto * messageLayout = new QGridLayout(this);
     messageLayout->addWidget(m_eventsList, 2, 1, 1, 4);
+
+    m_resourceUsage = new QLabel(this);
+    m_resourceUsage->setVisible(false);
+    messageLayout->addWidget(m_resourceUsage, 3, 1, 1, 4);
+
     messageLayout->setColumnStretch(3, 0);
     messageLayout->setRowStretch(4, 0);
 
@@ -10,42 +10,52 @@
 #include <QtCore/QSize>
 #include <QtCore/QPoint>
 #include <QtWidgets/QDialog>
+#include "EventCompactor.h"
+#include "MessageListModel.h"
+#include "Process.h"
 
 QT_BEGIN_NAMESPACE
 class QString;
 class QGroupBox;
-class QPlainTextEdit;
+class QTreeView;
+class QLabel;
 QT_END_NAMESPACE
 
 namespace OneDrive
 {
-    class Process;
-
     class MessagesWindow : public QDialog
     {
     Q_OBJECT
 
     public:
-        MessagesWindow(const Process & process);
+        MessagesWindow(const Process & process, EventBus & eventBus);
         ~MessagesWindow() override;
 
+        /** Show the onedrive client's current resource usage. Pass an empty string to hide it. */
+        void setResourceUsage(const QString & usage);
+
+        /** Add an error to the events list, shown with the time the client reported it. */
+        void addErrorMessage(const QString & error, const Process::Timestamp & time);
+
+        /** Add the events saved by the last session, marked as such, to the events list. */
+        void addLastSessionEvents(const QVector<EventBus::Event> & events);
+
     protected:
         void closeEvent(QCloseEvent * event) override;
 
     private:
         void connectProcess();
 
+        /** Add a message for each of a batch of events and summaries from the compactor. */
+        void addEntries(const EventCompactor::Entries & entries);
+
         void createMessageGroupBox();
 
         void loadSettings();
 
         void saveSettings() const;
 
-        void addInfoMessage(const QString & info);
-
-        void addErrorMessage(const QString & error);
-
-        void addOperationMessage(const QString & Operation, const QString & fileName);
+        void addInfoMessage(const QString & info, const Process::Timestamp & time);
 
         struct WindowSettings
         {
@@ -54,8 +64,14 @@ namespace OneDrive
         };
 
         const Process & m_process;
+
+        /** Folds bulk operations into one message each. */
+        EventCompactor m_compactor;
+
         QGroupBox * m_messagesContainer;
-        QPlainTextEdit * m_eventsList;
+        MessageListModel m_messages;
+        QTreeView * m_eventsList;
+        QLabel * m_resourceUsage;
         WindowSettings m_settings;
     };
 }
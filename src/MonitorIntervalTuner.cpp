@@ -0,0 +1,169 @@
+/**
+ * MonitorIntervalTuner.cpp
+ *
+ * Implementation of MonitorIntervalTuner class.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include "MonitorIntervalTuner.h"
+#include "Logger.h"
+#include "Process.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /** How often the level is re-evaluated while nothing changes (ms). */
+    constexpr const int EvaluationInterval = 60 * 1000;
+
+    qint64 now()
+    {
+        return Process::currentTimestamp().monotonicTime;
+    }
+}
+
+
+MonitorIntervalTuner::MonitorIntervalTuner(EventBus & bus, QObject * parent)
+        : QObject(parent),
+          m_enabled(false),
+          m_level(Level::Normal),
+          m_levelTime(0),
+          m_changeTimes(),
+          m_lastChangeTime(0),
+          m_evaluationTimer()
+{
+    m_evaluationTimer.setInterval(EvaluationInterval);
+    connect(&m_evaluationTimer, &QTimer::timeout, this, &MonitorIntervalTuner::evaluate);
+
+    bus.subscribe(this, EventBus::ItemEventTypes, {}, [this](const EventBus::Batch & events) {
+        onEvents(events);
+    });
+}
+
+
+MonitorIntervalTuner::~MonitorIntervalTuner() = default;
+
+
+void MonitorIntervalTuner::setEnabled(bool enabled)
+{
+    if (enabled == m_enabled) {
+        return;
+    }
+
+    m_enabled = enabled;
+    m_changeTimes.clear();
+
+    if (!m_enabled) {
+        m_evaluationTimer.stop();
+        return;
+    }
+
+    const auto time = now();
+    m_lastChangeTime = time;
+    m_evaluationTimer.start();
+    setLevel(Level::Normal, time);
+}
+
+
+MonitorIntervalTuner::Intervals MonitorIntervalTuner::intervals(Level level)
+{
+    // 300s is the shortest interval the client accepts, and 12 the least frequent full scan it allows below "never"
+    switch (level) {
+        case Level::Active:
+            return {300, 12};
+
+        case Level::Normal:
+            return {900, 12};
+
+        case Level::Idle:
+            return {3600, 24};
+    }
+
+    throw std::logic_error("Unhandled level in MonitorIntervalTuner::intervals()");
+}
+
+
+QString MonitorIntervalTuner::levelName(Level level)
+{
+    switch (level) {
+        case Level::Active:
+            return QStringLiteral("active");
+
+        case Level::Normal:
+            return QStringLiteral("normal");
+
+        case Level::Idle:
+            return QStringLiteral("idle");
+    }
+
+    throw std::logic_error("Unhandled level in MonitorIntervalTuner::levelName()");
+}
+
+
+void MonitorIntervalTuner::onEvents(const EventBus::Batch & events)
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    for (const auto & event : events) {
+        m_changeTimes.push_back(event.monotonicTime);
+    }
+
+    m_lastChangeTime = std::max(m_lastChangeTime, m_changeTimes.back());
+
+    // a burst of changes after a quiet spell should shorten the interval straight away, not at the next tick
+    evaluate();
+}
+
+
+MonitorIntervalTuner::Level MonitorIntervalTuner::targetLevel(qint64 now) const
+{
+    const auto changeCount = static_cast<int>(m_changeTimes.size());
+
+    if (EnterActiveCount <= changeCount || (Level::Active == m_level && StayActiveCount <= changeCount)) {
+        return Level::Active;
+    }
+
+    if (IdleAfter <= now - m_lastChangeTime) {
+        return Level::Idle;
+    }
+
+    return Level::Normal;
+}
+
+
+void MonitorIntervalTuner::evaluate()
+{
+    const auto time = now();
+
+    while (!m_changeTimes.empty() && ActivityWindow < time - m_changeTimes.front()) {
+        m_changeTimes.pop_front();
+    }
+
+    const auto level = targetLevel(time);
+
+    if (level == m_level) {
+        return;
+    }
+
+    // the levels are ordered from the shortest interval to the longest
+    const auto dwell = (level < m_level ? FasterDwell : SlowerDwell);
+
+    if (dwell > time - m_levelTime) {
+        return;
+    }
+
+    setLevel(level, time);
+}
+
+
+void MonitorIntervalTuner::setLevel(Level level, qint64 now)
+{
+    m_level = level;
+    m_levelTime = now;
+    const auto levelIntervals = intervals(level);
+    Logger::log(LogLevel::Info, LogCategory::Application, QStringLiteral("activity level is %1, checking for changes every %2s").arg(levelName(level)).arg(levelIntervals.monitorInterval));
+    Q_EMIT levelChanged(level);
+}
@@ -0,0 +1,125 @@
+/**
+ * MonitorIntervalTuner.h
+ *
+ * Declaration of MonitorIntervalTuner class.
+ */
+
+#ifndef ONEDRIVETRAY_MONITORINTERVALTUNER_H
+#define ONEDRIVETRAY_MONITORINTERVALTUNER_H
+
+#include <deque>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include "EventBus.h"
+
+namespace OneDrive
+{
+    /**
+     * Chooses how often the onedrive client checks for changes from how often things actually change.
+     *
+     * The tuner counts the changes the client reports. While files are changing it picks the client's shortest check
+     * interval, so that remote changes arrive quickly. The longer nothing changes, the longer the interval it picks,
+     * so that an idle machine wakes the network and the disk less often. Local changes are uploaded straight away
+     * whatever the interval, so the first edit after a quiet spell still brings the tuner back to the short interval.
+     *
+     * Every change of level costs a restart of the client, so the tuner guards against oscillating: it needs fewer
+     * changes to stay active than to become active, and it keeps a level for a while before it leaves it.
+     */
+    class MonitorIntervalTuner
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        enum class Level
+        {
+            Active = 0,
+            Normal,
+            Idle,
+        };
+
+        /** The client settings for a level. */
+        struct Intervals
+        {
+            /** monitor_interval (s). */
+            int monitorInterval;
+
+            /** monitor_fullscan_frequency. */
+            int monitorFullscanFrequency;
+        };
+
+        /** The period over which changes are counted (ms). */
+        static constexpr const qint64 ActivityWindow = 15 * 60 * 1000;
+
+        /** The changes in the activity window that make the tuner pick the Active level. */
+        static constexpr const int EnterActiveCount = 10;
+
+        /** The changes in the activity window that keep the tuner at the Active level. */
+        static constexpr const int StayActiveCount = 3;
+
+        /** How long nothing must change before the tuner picks the Idle level (ms). */
+        static constexpr const qint64 IdleAfter = 2 * 60 * 60 * 1000;
+
+        /** How long a level is kept before the tuner moves to a shorter interval (ms). */
+        static constexpr const qint64 FasterDwell = 5 * 60 * 1000;
+
+        /** How long a level is kept before the tuner moves to a longer interval (ms). */
+        static constexpr const qint64 SlowerDwell = 30 * 60 * 1000;
+
+        explicit MonitorIntervalTuner(EventBus & bus, QObject * parent = nullptr);
+
+        ~MonitorIntervalTuner() override;
+
+        [[nodiscard]] inline bool isEnabled() const
+        {
+            return m_enabled;
+        }
+
+        /**
+         * Start or stop tuning.
+         *
+         * When tuning starts the tuner picks the Normal level and emits levelChanged() for it, so that the client's
+         * settings match the level from the outset.
+         */
+        void setEnabled(bool enabled);
+
+        [[nodiscard]] inline Level level() const
+        {
+            return m_level;
+        }
+
+        [[nodiscard]] static Intervals intervals(Level level);
+        [[nodiscard]] static QString levelName(Level level);
+
+    Q_SIGNALS:
+        /** Emitted when the tuner picks a different level. */
+        void levelChanged(Level level);
+
+    private:
+        void onEvents(const EventBus::Batch & events);
+
+        /** Pick the level for the changes seen so far, and move to it if the guards allow. */
+        void evaluate();
+
+        [[nodiscard]] Level targetLevel(qint64 now) const;
+        void setLevel(Level level, qint64 now);
+
+        bool m_enabled;
+        Level m_level;
+
+        /** When the level was last changed (monotonic ms). */
+        qint64 m_levelTime;
+
+        /** When each change in the activity window was reported (monotonic ms), oldest first. */
+        std::deque<qint64> m_changeTimes;
+
+        /** When the last change was reported (monotonic ms), or when tuning started if nothing has changed since. */
+        qint64 m_lastChangeTime;
+
+        /** Re-evaluates the level while nothing is changing. */
+        QTimer m_evaluationTimer;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_MONITORINTERVALTUNER_H
@@ -0,0 +1,240 @@
+/**
+ * Notifier.cpp
+ *
+ * Implementation of Notifier class.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QVariantMap>
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusMessage>
+#include <QtDBus/QDBusPendingCallWatcher>
+#include <QtDBus/QDBusPendingReply>
+#include "Notifier.h"
+#include "EventBus.h"
+#include "Logger.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    const QString NotificationService = QStringLiteral("org.freedesktop.Notifications");
+    const QString NotificationPath = QStringLiteral("/org/freedesktop/Notifications");
+    const QString NotificationInterface = QStringLiteral("org.freedesktop.Notifications");
+
+    /** The icon installed with the application. */
+    const QString NotificationIcon = QStringLiteral("OneDrive");
+
+    /** The category for each kind of transfer. */
+    const std::array<QString, 3> TransferCategories = {
+            QStringLiteral("transfers-upload"),
+            QStringLiteral("transfers-download"),
+            QStringLiteral("transfers-delete"),
+    };
+
+    /** Normalise a path reported by the client and return the directory containing it. */
+    QString parentDirectory(const QString & path)
+    {
+        const auto directory = EventBus::normalisePath(path);
+        const auto separator = directory.lastIndexOf(QLatin1Char('/'));
+        return 0 > separator ? QString() : directory.left(separator);
+    }
+
+    /** The deepest directory that contains both directories. */
+    QString commonDirectory(const QString & first, const QString & second)
+    {
+        const auto length = std::min(first.size(), second.size());
+        int common = 0;
+
+        while (common < length && first[common] == second[common]) {
+            ++common;
+        }
+
+        if (common == first.size() && (common == second.size() || QLatin1Char('/') == second[common])) {
+            return first;
+        }
+
+        if (common == second.size() && QLatin1Char('/') == first[common]) {
+            return second;
+        }
+
+        // back up to the last whole directory name
+        const auto separator = first.lastIndexOf(QLatin1Char('/'), common - 1);
+        return 0 >= separator || 0 == common ? QString() : first.left(separator);
+    }
+}
+
+
+Notifier::Notifier(Fallback * fallback, QObject * parent)
+        : QObject(parent),
+          m_fallback(fallback),
+          m_displayName(),
+          m_useNotificationService(QDBusConnection::sessionBus().isConnected()),
+          m_clock(),
+          m_categories(),
+          m_pendingTimer(),
+          m_transfers(),
+          m_transferTimer()
+{
+    m_clock.start();
+    m_pendingTimer.setSingleShot(true);
+    connect(&m_pendingTimer, &QTimer::timeout, this, &Notifier::showPending);
+
+    m_transferTimer.setSingleShot(true);
+    m_transferTimer.setInterval(AggregationDelay);
+    connect(&m_transferTimer, &QTimer::timeout, this, &Notifier::notifyTransfers);
+}
+
+
+Notifier::~Notifier() = default;
+
+
+QString Notifier::displayName() const
+{
+    // read when needed, since the application's name may be set after the notifier is created
+    return m_displayName.isEmpty() ? QCoreApplication::applicationName() : m_displayName;
+}
+
+
+void Notifier::notify(const QString & category, const QString & summary, const QString & body, Urgency urgency, int timeout)
+{
+    auto & state = m_categories[category];
+    const auto now = m_clock.elapsed();
+
+    if (0 > state.lastShown || MinimumInterval <= now - state.lastShown) {
+        state.pending.reset();
+        show(category, {summary, body, urgency, timeout});
+        return;
+    }
+
+    // only the latest notification in a burst is shown
+    state.pending = Notification{summary, body, urgency, timeout};
+    const auto due = static_cast<int>(MinimumInterval - (now - state.lastShown));
+
+    if (!m_pendingTimer.isActive() || m_pendingTimer.remainingTime() > due) {
+        m_pendingTimer.start(due);
+    }
+}
+
+
+void Notifier::showPending()
+{
+    const auto now = m_clock.elapsed();
+    qint64 nextDue = -1;
+
+    for (auto it = m_categories.begin(); it != m_categories.end(); ++it) {
+        if (!it->pending) {
+            continue;
+        }
+
+        if (MinimumInterval <= now - it->lastShown) {
+            const auto notification = *it->pending;
+            it->pending.reset();
+            show(it.key(), notification);
+        } else {
+            const auto due = MinimumInterval - (now - it->lastShown);
+            nextDue = (0 > nextDue ? due : std::min(nextDue, due));
+        }
+    }
+
+    if (0 <= nextDue) {
+        m_pendingTimer.start(static_cast<int>(nextDue));
+    }
+}
+
+
+void Notifier::show(const QString & category, const Notification & notification)
+{
+    auto & state = m_categories[category];
+    state.lastShown = m_clock.elapsed();
+
+    if (!m_useNotificationService) {
+        showOnFallback(notification);
+        return;
+    }
+
+    auto message = QDBusMessage::createMethodCall(NotificationService, NotificationPath, NotificationInterface, QStringLiteral("Notify"));
+    const QVariantMap hints = {{QStringLiteral("urgency"), QVariant::fromValue(static_cast<uchar>(notification.urgency))}};
+
+    message << QCoreApplication::applicationName()
+            << state.id
+            << NotificationIcon
+            << notification.summary
+            << notification.body
+            << QStringList()
+            << hints
+            << notification.timeout;
+
+    // the reply is handled when it arrives, so a slow or absent notification service never blocks the event loop
+    auto * watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(message), this);
+
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, category, notification](QDBusPendingCallWatcher * watcher) {
+        const QDBusPendingReply<uint> reply = *watcher;
+        watcher->deleteLater();
+
+        if (reply.isError()) {
+            Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("notification service unavailable (%1), using the fallback instead").arg(reply.error().message()));
+            m_useNotificationService = false;
+            showOnFallback(notification);
+            return;
+        }
+
+        m_categories[category].id = reply.value();
+    });
+}
+
+
+void Notifier::showOnFallback(const Notification & notification) const
+{
+    if (!m_fallback || !m_fallback->showMessage(notification.summary, notification.body, notification.urgency, notification.timeout)) {
+        Logger::log(LogLevel::Info, LogCategory::Application, notification.summary + ": " + notification.body);
+    }
+}
+
+
+void Notifier::addTransfer(Transfer transfer, const QString & path)
+{
+    auto & burst = m_transfers[static_cast<int>(transfer)];
+    const auto directory = parentDirectory(path);
+    burst.directory = (0 == burst.count ? directory : commonDirectory(burst.directory, directory));
+    ++burst.count;
+
+    if (!m_transferTimer.isActive()) {
+        m_transferTimer.start();
+    }
+}
+
+
+void Notifier::notifyTransfers()
+{
+    for (int index = 0; index < static_cast<int>(m_transfers.size()); ++index) {
+        auto & burst = m_transfers[index];
+
+        if (0 == burst.count) {
+            continue;
+        }
+
+        const auto count = static_cast<int>(std::min<quint64>(burst.count, std::numeric_limits<int>::max()));
+        const auto directory = burst.directory.isEmpty() ? tr("OneDrive") : burst.directory + QLatin1Char('/');
+        QString body;
+
+        switch (static_cast<Transfer>(index)) {
+            case Transfer::Upload:
+                body = tr("%n file(s) uploaded to %1", nullptr, count).arg(directory);
+                break;
+
+            case Transfer::Download:
+                body = tr("%n file(s) downloaded to %1", nullptr, count).arg(directory);
+                break;
+
+            case Transfer::Delete:
+                body = tr("%n item(s) deleted from %1", nullptr, count).arg(directory);
+                break;
+        }
+
+        burst = {};
+        notify(TransferCategories[index], displayName(), body, Urgency::Low);
+    }
+}
@@ -0,0 +1,165 @@
+/**
+ * Notifier.h
+ *
+ * Declaration of Notifier class.
+ */
+
+#ifndef ONEDRIVETRAY_NOTIFIER_H
+#define ONEDRIVETRAY_NOTIFIER_H
+
+#include <array>
+#include <optional>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+
+namespace OneDrive
+{
+    /**
+     * Shows desktop notifications without blocking.
+     *
+     * Notifications are sent asynchronously over D-Bus to org.freedesktop.Notifications. If that service isn't
+     * available, the Fallback is used instead, or the notification is logged if there is none. The notifier itself only
+     * needs Qt Core and D-Bus, so that it can be used without a display.
+     *
+     * Each notification has a category. A category is shown at most once per MinimumInterval: a notification that
+     * arrives sooner is held back, replacing any that is already waiting, and then replaces the category's existing
+     * notification on screen rather than adding another. Transfers are aggregated over AggregationDelay into one
+     * notification per kind of transfer (e.g. "412 files uploaded to Documents").
+     */
+    class Notifier
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** Enumeration of the urgencies of notification, as defined by the notification specification. */
+        enum class Urgency
+        {
+            Low = 0,
+            Normal,
+            Critical,
+        };
+
+        /** Enumeration of the kinds of transfer that are aggregated. */
+        enum class Transfer
+        {
+            Upload = 0,
+            Download,
+            Delete,
+        };
+
+        /** The shortest time between notifications in the same category (ms). */
+        static constexpr const int MinimumInterval = 5000;
+
+        /** How long transfers are collected before being notified (ms). */
+        static constexpr const int AggregationDelay = 3000;
+
+        /** Another way to show notifications, for when the notification service is not available. */
+        class Fallback
+        {
+        public:
+            virtual ~Fallback() = default;
+
+            /**
+             * Show a notification.
+             *
+             * @return false if it can't be shown, in which case it is logged instead.
+             */
+            virtual bool showMessage(const QString & summary, const QString & body, Urgency urgency, int timeout) = 0;
+        };
+
+        /**
+         * @param fallback How to show notifications if the notification service is not available. May be null.
+         */
+        explicit Notifier(Fallback * fallback = nullptr, QObject * parent = nullptr);
+
+        ~Notifier() override;
+
+        /** Set how to show notifications if the notification service is not available. May be null. */
+        inline void setFallback(Fallback * fallback)
+        {
+            m_fallback = fallback;
+        }
+
+        /** The name the notifications are shown under. Defaults to the application's name. */
+        [[nodiscard]] QString displayName() const;
+
+        inline void setDisplayName(const QString & name)
+        {
+            m_displayName = name;
+        }
+
+        /**
+         * Show a notification.
+         *
+         * @param category Notifications in the same category replace each other and are rate limited together.
+         * @param summary The notification's title.
+         * @param body The notification's text.
+         * @param urgency The notification's urgency.
+         * @param timeout How long to show the notification for (ms), 0 for until it is dismissed.
+         */
+        void notify(const QString & category, const QString & summary, const QString & body, Urgency urgency = Urgency::Normal, int timeout = 5000);
+
+        /** Record a transfer to be included in the next aggregated transfer notification. */
+        void addTransfer(Transfer transfer, const QString & path);
+
+    private:
+        struct Notification
+        {
+            QString summary;
+            QString body;
+            Urgency urgency;
+            int timeout;
+        };
+
+        struct Category
+        {
+            /** The notification service's ID for the category's current notification, 0 if none. */
+            uint id = 0;
+
+            /** The time (on m_clock) the category was last shown, or -1. */
+            qint64 lastShown = -1;
+
+            /** A notification held back by the rate limit. */
+            std::optional<Notification> pending;
+        };
+
+        struct TransferBurst
+        {
+            quint64 count = 0;
+
+            /** The deepest directory containing all the transferred files ("" for the root). */
+            QString directory;
+        };
+
+        /** Show a category's notification, via D-Bus or the fallback. */
+        void show(const QString & category, const Notification & notification);
+
+        /** Show a notification using the fallback, or log it if that can't. */
+        void showOnFallback(const Notification & notification) const;
+
+        /** Show the held-back notifications whose interval has passed. */
+        void showPending();
+
+        /** Notify the transfers collected since the last notification. */
+        void notifyTransfers();
+
+        Fallback * m_fallback;
+        QString m_displayName;
+
+        /** Whether to use the notification service. Cleared if a call to it fails. */
+        bool m_useNotificationService;
+
+        QElapsedTimer m_clock;
+        QHash<QString, Category> m_categories;
+        QTimer m_pendingTimer;
+
+        std::array<TransferBurst, 3> m_transfers;
+        QTimer m_transferTimer;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_NOTIFIER_H
@@ -0,0 +1,280 @@
+/**
+ * OneDriveConfig.cpp
+ *
+ * Implementation of OneDriveConfig class.
+ */
+
+#include <utility>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+#include <QtCore/QTextStream>
+#include "OneDriveConfig.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    const QString ThreadsKey = QStringLiteral("threads");
+    const QString RateLimitKey = QStringLiteral("rate_limit");
+    const QString MonitorIntervalKey = QStringLiteral("monitor_interval");
+    const QString MonitorFullscanFrequencyKey = QStringLiteral("monitor_fullscan_frequency");
+    const QString ClassifyAsBigDeleteKey = QStringLiteral("classify_as_big_delete");
+    const QString SkipDotfilesKey = QStringLiteral("skip_dotfiles");
+
+    /**
+     * Split a line of the config file into its key and value.
+     *
+     * @return The key, or an empty string if the line doesn't set anything.
+     */
+    QString parseLine(const QString & line, QString * value = nullptr)
+    {
+        const auto separator = line.indexOf(QLatin1Char('='));
+
+        if (0 > separator) {
+            return {};
+        }
+
+        if (value) {
+            *value = line.mid(separator + 1).trimmed();
+
+            if (2 <= value->size() && value->startsWith(QLatin1Char('"')) && value->endsWith(QLatin1Char('"'))) {
+                *value = value->mid(1, value->size() - 2);
+            }
+        }
+
+        return line.left(separator).trimmed();
+    }
+
+    template<class T>
+    void setOptionalValue(OneDriveConfig & config, const QString & key, const std::optional<T> & value)
+    {
+        if (value) {
+            config.setValue(key, QString::number(*value));
+        } else {
+            config.removeValue(key);
+        }
+    }
+
+    std::optional<int> intValue(const OneDriveConfig & config, const QString & key)
+    {
+        const auto value = config.value(key);
+        bool ok = false;
+        const auto number = (value ? value->toInt(&ok) : 0);
+        return ok ? std::optional<int>(number) : std::nullopt;
+    }
+}
+
+
+bool PerformanceSettings::operator==(const PerformanceSettings & other) const
+{
+    return threads == other.threads
+           && rateLimit == other.rateLimit
+           && monitorInterval == other.monitorInterval
+           && monitorFullscanFrequency == other.monitorFullscanFrequency
+           && classifyAsBigDelete == other.classifyAsBigDelete
+           && skipDotfiles == other.skipDotfiles;
+}
+
+
+OneDriveConfig::OneDriveConfig(QString path)
+        : m_path(std::move(path)),
+          m_lines(),
+          m_errorString()
+{
+}
+
+
+bool OneDriveConfig::load()
+{
+    m_lines.clear();
+    m_errorString.clear();
+    QFile file(m_path);
+
+    if (!file.exists()) {
+        return true;
+    }
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+
+    while (!in.atEnd()) {
+        m_lines.append(in.readLine());
+    }
+
+    return true;
+}
+
+
+bool OneDriveConfig::save()
+{
+    m_errorString.clear();
+
+    // the new content is written to a temporary file that replaces the config only once it's complete
+    QSaveFile file(m_path);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+
+    for (const auto & line : m_lines) {
+        out << line << '\n';
+    }
+
+    out.flush();
+
+    if (QTextStream::Ok != out.status() || !file.commit()) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+
+int OneDriveConfig::findLine(const QString & key, bool commented) const
+{
+    for (int index = 0; index < m_lines.size(); ++index) {
+        auto line = m_lines.at(index).trimmed();
+
+        if (line.startsWith(QLatin1Char('#'))) {
+            if (!commented) {
+                continue;
+            }
+
+            line.remove(0, 1);
+        } else if (commented) {
+            continue;
+        }
+
+        if (key == parseLine(line)) {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+
+std::optional<QString> OneDriveConfig::value(const QString & key) const
+{
+    const auto index = findLine(key);
+
+    if (0 > index) {
+        return {};
+    }
+
+    QString value;
+    parseLine(m_lines.at(index), &value);
+    return value;
+}
+
+
+void OneDriveConfig::setValue(const QString & key, const QString & value)
+{
+    const auto line = QStringLiteral("%1 = \"%2\"").arg(key, value);
+    auto index = findLine(key);
+
+    if (0 <= index) {
+        m_lines[index] = line;
+        return;
+    }
+
+    // the sample config has a commented-out line for each setting, which is the natural place for it
+    index = findLine(key, true);
+
+    if (0 <= index) {
+        m_lines.insert(index + 1, line);
+    } else {
+        m_lines.append(line);
+    }
+}
+
+
+void OneDriveConfig::removeValue(const QString & key)
+{
+    for (auto index = findLine(key); 0 <= index; index = findLine(key)) {
+        m_lines.removeAt(index);
+    }
+}
+
+
+PerformanceSettings OneDriveConfig::performanceSettings() const
+{
+    PerformanceSettings settings;
+    settings.threads = intValue(*this, ThreadsKey);
+    settings.monitorInterval = intValue(*this, MonitorIntervalKey);
+    settings.monitorFullscanFrequency = intValue(*this, MonitorFullscanFrequencyKey);
+    settings.classifyAsBigDelete = intValue(*this, ClassifyAsBigDeleteKey);
+
+    if (const auto rateLimit = value(RateLimitKey)) {
+        bool ok;
+        const auto bytes = rateLimit->toULongLong(&ok);
+
+        if (ok) {
+            settings.rateLimit = bytes;
+        }
+    }
+
+    if (const auto skipDotfiles = value(SkipDotfilesKey)) {
+        if (0 == skipDotfiles->compare(QLatin1String("true"), Qt::CaseInsensitive)) {
+            settings.skipDotfiles = true;
+        } else if (0 == skipDotfiles->compare(QLatin1String("false"), Qt::CaseInsensitive)) {
+            settings.skipDotfiles = false;
+        }
+    }
+
+    return settings;
+}
+
+
+void OneDriveConfig::setPerformanceSettings(const PerformanceSettings & settings)
+{
+    setOptionalValue(*this, ThreadsKey, settings.threads);
+    setOptionalValue(*this, RateLimitKey, settings.rateLimit);
+    setOptionalValue(*this, MonitorIntervalKey, settings.monitorInterval);
+    setOptionalValue(*this, MonitorFullscanFrequencyKey, settings.monitorFullscanFrequency);
+    setOptionalValue(*this, ClassifyAsBigDeleteKey, settings.classifyAsBigDelete);
+
+    if (settings.skipDotfiles) {
+        setValue(SkipDotfilesKey, *settings.skipDotfiles ? QStringLiteral("true") : QStringLiteral("false"));
+    } else {
+        removeValue(SkipDotfilesKey);
+    }
+}
+
+
+QStringList OneDriveConfig::validate(const PerformanceSettings & settings)
+{
+    QStringList problems;
+
+    if (settings.threads && (1 > *settings.threads || MaximumThreads < *settings.threads)) {
+        problems.append(tr("The number of threads must be between 1 and %1.").arg(MaximumThreads));
+    }
+
+    if (settings.rateLimit && 0 != *settings.rateLimit && MinimumRateLimit > *settings.rateLimit) {
+        problems.append(tr("The rate limit must be 0 (no limit) or at least %1 KiB/s.").arg(MinimumRateLimit / 1024));
+    }
+
+    if (settings.monitorInterval && (MinimumMonitorInterval > *settings.monitorInterval || MaximumMonitorInterval < *settings.monitorInterval)) {
+        problems.append(tr("The monitor interval must be between %1 and %2 seconds.").arg(MinimumMonitorInterval).arg(MaximumMonitorInterval));
+    }
+
+    if (settings.monitorFullscanFrequency && 0 != *settings.monitorFullscanFrequency && MinimumMonitorFullscanFrequency > *settings.monitorFullscanFrequency) {
+        problems.append(tr("The full scan frequency must be 0 (never) or at least %1.").arg(MinimumMonitorFullscanFrequency));
+    }
+
+    if (settings.classifyAsBigDelete && 1 > *settings.classifyAsBigDelete) {
+        problems.append(tr("The big delete threshold must be at least 1."));
+    }
+
+    return problems;
+}
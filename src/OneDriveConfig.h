@@ -0,0 +1,137 @@
+/**
+ * OneDriveConfig.h
+ *
+ * Declaration of OneDriveConfig class.
+ */
+
+#ifndef ONEDRIVETRAY_ONEDRIVECONFIG_H
+#define ONEDRIVETRAY_ONEDRIVECONFIG_H
+
+#include <optional>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+namespace OneDrive
+{
+    /**
+     * The onedrive client's settings that most affect its performance.
+     *
+     * A setting that isn't set is left out of the config file, so the client uses its default.
+     */
+    struct PerformanceSettings
+    {
+        /** threads: the number of transfer threads (1 - 16). */
+        std::optional<int> threads;
+
+        /** rate_limit: the bandwidth limit per thread in bytes/s, 0 for none, otherwise at least MinimumRateLimit. */
+        std::optional<quint64> rateLimit;
+
+        /** monitor_interval: the seconds between checks for remote changes (at least MinimumMonitorInterval). */
+        std::optional<int> monitorInterval;
+
+        /** monitor_fullscan_frequency: the checks between full scans of the local files, 0 for none. */
+        std::optional<int> monitorFullscanFrequency;
+
+        /** classify_as_big_delete: the number of deleted children that makes a delete big enough to need confirming. */
+        std::optional<int> classifyAsBigDelete;
+
+        /** skip_dotfiles: whether files and directories whose names start with '.' are skipped. */
+        std::optional<bool> skipDotfiles;
+
+        bool operator==(const PerformanceSettings & other) const;
+
+        inline bool operator!=(const PerformanceSettings & other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * Reads and writes the onedrive client's config file.
+     *
+     * Only the settings that are changed are touched: every other line, including comments, is written back as it
+     * was read. The file is replaced atomically, so the client never sees a partly written config even if the tray is
+     * killed while saving.
+     */
+    class OneDriveConfig
+    {
+    Q_DECLARE_TR_FUNCTIONS(OneDriveConfig)
+
+    public:
+        static constexpr const int MaximumThreads = 16;
+        static constexpr const quint64 MinimumRateLimit = 131072;
+        static constexpr const int MinimumMonitorInterval = 300;
+        static constexpr const int MaximumMonitorInterval = 24 * 60 * 60;
+        static constexpr const int MinimumMonitorFullscanFrequency = 12;
+
+        explicit OneDriveConfig(QString path);
+
+        [[nodiscard]] inline const QString & path() const
+        {
+            return m_path;
+        }
+
+        /** A description of the last error, if load() or save() failed. */
+        [[nodiscard]] inline const QString & errorString() const
+        {
+            return m_errorString;
+        }
+
+        /**
+         * Read the config file.
+         *
+         * A file that doesn't exist is read as empty.
+         *
+         * @return false if the file exists but can't be read.
+         */
+        bool load();
+
+        /**
+         * Write the config file, replacing it atomically.
+         *
+         * @return false if it can't be written, in which case the file is unchanged.
+         */
+        bool save();
+
+        /** The value of a setting, without its quotes, if it's set. */
+        [[nodiscard]] std::optional<QString> value(const QString & key) const;
+
+        /**
+         * Set a setting.
+         *
+         * The setting's line is replaced if it's set, otherwise the line is added after the commented-out default for
+         * the setting if there is one, or at the end.
+         */
+        void setValue(const QString & key, const QString & value);
+
+        /** Remove a setting, so that the client uses its default. */
+        void removeValue(const QString & key);
+
+        [[nodiscard]] PerformanceSettings performanceSettings() const;
+        void setPerformanceSettings(const PerformanceSettings & settings);
+
+        /**
+         * Check performance settings against the limits the client accepts.
+         *
+         * @return A translated description of each problem. Empty if the settings are valid.
+         */
+        [[nodiscard]] static QStringList validate(const PerformanceSettings & settings);
+
+    private:
+        /**
+         * Find a setting's line.
+         *
+         * @param commented Whether to find the setting's commented-out line rather than the line that sets it.
+         *
+         * @return The index of the line, or -1.
+         */
+        [[nodiscard]] int findLine(const QString & key, bool commented = false) const;
+
+        QString m_path;
+        QStringList m_lines;
+        QString m_errorString;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_ONEDRIVECONFIG_H
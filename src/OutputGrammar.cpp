@@ -0,0 +1,314 @@
+/**
+ * OutputGrammar.cpp
+ *
+ * Implementation of OutputGrammar class.
+ */
+
+#include <utility>
+#include "OutputGrammar.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    using Type = ProcessMessageType;
+    using Match = OutputGrammar::Match;
+    using Capture = OutputGrammar::Capture;
+
+    /** The first release that uses the 2.5 wording. */
+    const QVersionNumber Version25 = QVersionNumber(2, 5);
+
+    /** The client's progress marker, which follows the path of a transfer. */
+    const QByteArray Ellipsis = QByteArrayLiteral(" ...");
+
+    const QByteArray PathSeparator = QByteArrayLiteral(" to ");
+
+    /**
+     * Releases before 2.5. This is also used when the version can't be determined.
+     *
+     * The rules for lines that name an item come first, so that a path that happens to contain a throttling message
+     * is still taken for the path. The throttling rules come next, because some of the client's throttling messages
+     * are prefixed with ERROR: and would otherwise be taken for errors.
+     */
+    const std::vector<OutputGrammar::Rule> Rules24 = {
+            {Type::Starting, Match::Prefix, "Initializing the Synchronization Engine"},
+            {Type::ScanningLocal, Match::Prefix, "Performing a database consistency and integrity check"},
+            {Type::ScanningLocal, Match::Prefix, "Uploading differences of "},
+            {Type::ScanningLocal, Match::Prefix, "Uploading new items of "},
+            {Type::ScanningLocal, Match::Prefix, "Scanning local filesystem"},
+            {Type::FetchingRemote, Match::Prefix, "Syncing changes from OneDrive"},
+            {Type::FetchingRemote, Match::Prefix, "Fetching /delta response"},
+            {Type::FetchingRemote, Match::Prefix, "Processing changes and items received from OneDrive"},
+            {Type::CreateLocalDir, Match::Prefix, "Creating local directory: ", Capture::Rest},
+            {Type::CreateRemoteDir, Match::Prefix, "Successfully created the remote directory ", Capture::Rest, " on OneDrive"},
+            {Type::Rename, Match::Prefix, "Moving ", Capture::Paths},
+            {Type::Download, Match::Contains, "Downloading new file ", Capture::RestBeforeEllipsis},
+            {Type::Download, Match::Contains, "Downloading modified file ", Capture::RestBeforeEllipsis},
+            {Type::Download, Match::Contains, "Downloading file ", Capture::RestBeforeEllipsis},
+            {Type::Upload, Match::Contains, "Uploading new file ", Capture::RestBeforeEllipsis},
+            {Type::Upload, Match::Contains, "Uploading modified file ", Capture::RestBeforeEllipsis},
+            {Type::Upload, Match::Contains, "Uploading file ", Capture::RestBeforeEllipsis},
+            {Type::Delete, Match::Contains, "Deleting item from OneDrive: ", Capture::Rest},
+            {Type::Delete, Match::Contains, "Deleting item ", Capture::Rest},
+            {Type::Throttled, Match::Contains, "HTTP 429", Capture::NumberFromNeedle},
+            {Type::Throttled, Match::Contains, "HTTP 503", Capture::NumberFromNeedle},
+            {Type::RetryAfter, Match::ContainsIgnoringCase, "retry-after value = ", Capture::NumberFromNeedle},
+            {Type::Retrying, Match::Contains, "Retrying "},
+            {Type::Error, Match::Prefix, "ERROR: ", Capture::Rest},
+            {Type::Warning, Match::Prefix, "WARNING: ", Capture::Rest},
+            {Type::FreeSpace, Match::ContainsIgnoringCase, "remaining free space", Capture::Number},
+            {Type::Finished, Match::Contains, "Sync with OneDrive is complete"},
+            {Type::LocalRootDirectoryRemoved, Match::Contains, "Monitored directory removed"},
+
+            // not all of the client's errors are prefixed with ERROR:
+            {Type::Warning, Match::Contains, "nable to ", Capture::Line},
+            {Type::Warning, Match::Contains, "ailed ", Capture::Line},
+            {Type::Warning, Match::Contains, "rror ", Capture::Line},
+    };
+
+    /**
+     * Release 2.5 and later.
+     *
+     * The 2.5 rewrite says "Microsoft OneDrive" where earlier releases said "OneDrive", puts a colon after the
+     * transfer verbs and uses British spelling in some messages. Some older wordings survive in some messages, so
+     * they're kept after the newer ones. It also reports the Retry-After header itself, and numbers its retries. The
+     * rules are ordered as for the earlier releases.
+     */
+    const std::vector<OutputGrammar::Rule> Rules25 = {
+            {Type::Starting, Match::Prefix, "Initialising the Synchronisation Engine"},
+            {Type::Starting, Match::Prefix, "Initializing the Synchronization Engine"},
+            {Type::ScanningLocal, Match::Prefix, "Performing a database consistency and integrity check"},
+            {Type::ScanningLocal, Match::Prefix, "Scanning the local file system"},
+            {Type::ScanningLocal, Match::Prefix, "Scanning local filesystem"},
+            {Type::FetchingRemote, Match::Prefix, "Fetching items from the OneDrive API"},
+            {Type::FetchingRemote, Match::Prefix, "Syncing changes from this selected path"},
+            {Type::FetchingRemote, Match::Prefix, "Syncing changes from OneDrive"},
+            {Type::CreateLocalDir, Match::Prefix, "Creating local directory: ", Capture::Rest},
+            {Type::CreateRemoteDir, Match::Prefix, "Successfully created the remote directory ", Capture::Rest, " on Microsoft OneDrive"},
+            {Type::Rename, Match::Prefix, "Moving ", Capture::Paths},
+            {Type::Download, Match::Contains, "Downloading new file: ", Capture::RestBeforeEllipsis},
+            {Type::Download, Match::Contains, "Downloading modified file: ", Capture::RestBeforeEllipsis},
+            {Type::Download, Match::Contains, "Downloading file: ", Capture::RestBeforeEllipsis},
+            {Type::Download, Match::Contains, "Downloading file ", Capture::RestBeforeEllipsis},
+            {Type::Upload, Match::Contains, "Uploading new file: ", Capture::RestBeforeEllipsis},
+            {Type::Upload, Match::Contains, "Uploading modified file: ", Capture::RestBeforeEllipsis},
+            {Type::Upload, Match::Contains, "Uploading file: ", Capture::RestBeforeEllipsis},
+            {Type::Upload, Match::Contains, "Uploading new file ", Capture::RestBeforeEllipsis},
+            {Type::Upload, Match::Contains, "Uploading modified file ", Capture::RestBeforeEllipsis},
+            {Type::Delete, Match::Contains, "Deleting item from Microsoft OneDrive: ", Capture::Rest},
+            {Type::Delete, Match::Contains, "Deleting item from OneDrive: ", Capture::Rest},
+            {Type::Delete, Match::Contains, "Deleting item ", Capture::Rest},
+            {Type::Throttled, Match::Contains, "HTTP 429", Capture::NumberFromNeedle},
+            {Type::Throttled, Match::Contains, "HTTP 503", Capture::NumberFromNeedle},
+            {Type::RetryAfter, Match::ContainsIgnoringCase, "retry-after value = ", Capture::NumberFromNeedle},
+            {Type::RetryAfter, Match::ContainsIgnoringCase, "retry-after: ", Capture::NumberFromNeedle},
+            {Type::Retrying, Match::Contains, "Retrying "},
+            {Type::Retrying, Match::Contains, "Retry attempt"},
+            {Type::Error, Match::Prefix, "ERROR: ", Capture::Rest},
+            {Type::Warning, Match::Prefix, "WARNING: ", Capture::Rest},
+            {Type::FetchingRemote, Match::Contains, "changes and items received from Microsoft OneDrive"},
+            {Type::FreeSpace, Match::ContainsIgnoringCase, "remaining free space", Capture::Number},
+            {Type::Finished, Match::Contains, "Sync with Microsoft OneDrive is complete"},
+            {Type::Finished, Match::Contains, "Sync with OneDrive is complete"},
+            {Type::LocalRootDirectoryRemoved, Match::Contains, "Monitored directory removed"},
+            {Type::Warning, Match::Contains, "nable to ", Capture::Line},
+            {Type::Warning, Match::Contains, "ailed ", Capture::Line},
+            {Type::Warning, Match::Contains, "rror ", Capture::Line},
+    };
+
+    /** Lower-case the ASCII letters in a line. */
+    QByteArray asciiLower(const QByteArray & line)
+    {
+        auto lower = line;
+
+        for (auto & byte : lower) {
+            if ('A' <= byte && 'Z' >= byte) {
+                byte = static_cast<char>(byte - 'A' + 'a');
+            }
+        }
+
+        return lower;
+    }
+}
+
+
+OutputGrammar::OutputGrammar(QString name, const std::vector<Rule> & rules)
+        : m_name(std::move(name)),
+          m_rules(),
+          m_candidates()
+{
+    m_rules.reserve(rules.size());
+
+    for (const auto & rule : rules) {
+        m_rules.push_back({rule, QByteArrayMatcher(rule.needle)});
+    }
+
+    // a prefix rule can only match lines that start with its first byte; the others can match any line
+    for (int byte = 0; byte < static_cast<int>(m_candidates.size()); ++byte) {
+        for (int index = 0; index < static_cast<int>(m_rules.size()); ++index) {
+            const auto & rule = m_rules[index].rule;
+
+            if (Match::Prefix != rule.match || static_cast<unsigned char>(rule.needle.at(0)) == byte) {
+                m_candidates[byte].push_back(index);
+            }
+        }
+    }
+}
+
+
+const OutputGrammar & OutputGrammar::forVersion(const QVersionNumber & version)
+{
+    static const OutputGrammar grammar24(QStringLiteral("2.4"), Rules24);
+    static const OutputGrammar grammar25(QStringLiteral("2.5"), Rules25);
+
+    if (!version.isNull() && version >= Version25) {
+        return grammar25;
+    }
+
+    return grammar24;
+}
+
+
+QVersionNumber OutputGrammar::parseVersion(const QByteArray & versionOutput)
+{
+    const auto start = versionOutput.indexOf(" v");
+
+    if (0 > start) {
+        return {};
+    }
+
+    // the release is followed by the packager's suffix, if any
+    auto end = start + 2;
+
+    while (end < versionOutput.size() && (('0' <= versionOutput[end] && '9' >= versionOutput[end]) || '.' == versionOutput[end])) {
+        ++end;
+    }
+
+    return QVersionNumber::fromString(QString::fromLatin1(versionOutput.mid(start + 2, end - start - 2)));
+}
+
+
+std::vector<OutputGrammar::Rule> OutputGrammar::rules() const
+{
+    std::vector<Rule> rules;
+    rules.reserve(m_rules.size());
+
+    for (const auto & compiled : m_rules) {
+        rules.push_back(compiled.rule);
+    }
+
+    return rules;
+}
+
+
+ProcessMessage OutputGrammar::parse(const QByteArray & line) const
+{
+    ProcessMessage message;
+
+    if (line.isEmpty()) {
+        return message;
+    }
+
+    // only computed if a rule needs it
+    QByteArray lowerLine;
+
+    for (const auto index : m_candidates[static_cast<unsigned char>(line.at(0))]) {
+        const auto & [rule, matcher] = m_rules[index];
+        int offset = -1;
+
+        switch (rule.match) {
+            case Match::Prefix:
+                offset = line.startsWith(rule.needle) ? 0 : -1;
+                break;
+
+            case Match::Contains:
+                offset = matcher.indexIn(line);
+                break;
+
+            case Match::ContainsIgnoringCase:
+                if (lowerLine.isNull()) {
+                    lowerLine = asciiLower(line);
+                }
+
+                offset = matcher.indexIn(lowerLine);
+                break;
+        }
+
+        if (0 > offset) {
+            continue;
+        }
+
+        message.type = rule.type;
+        capture(rule, line, offset, message);
+        break;
+    }
+
+    return message;
+}
+
+
+void OutputGrammar::capture(const Rule & rule, const QByteArray & line, int offset, ProcessMessage & message)
+{
+    const auto start = offset + rule.needle.size();
+
+    switch (rule.capture) {
+        case Capture::None:
+            break;
+
+        case Capture::Rest: {
+            auto end = line.size();
+
+            if (!rule.suffix.isEmpty() && line.endsWith(rule.suffix) && end - rule.suffix.size() >= start) {
+                end -= rule.suffix.size();
+            }
+
+            message.destination = QString::fromUtf8(line.constData() + start, end - start);
+            break;
+        }
+
+        case Capture::RestBeforeEllipsis: {
+            auto end = line.lastIndexOf(Ellipsis);
+
+            if (end < start) {
+                end = line.size();
+            }
+
+            message.destination = QString::fromUtf8(line.constData() + start, end - start);
+            break;
+        }
+
+        case Capture::Paths: {
+            // paths can contain " to ", so the source is taken to be as long as possible
+            const auto separator = line.lastIndexOf(PathSeparator);
+
+            if (separator > start) {
+                message.source = QString::fromUtf8(line.constData() + start, separator - start);
+                message.destination = QString::fromUtf8(line.mid(separator + PathSeparator.size()));
+            }
+
+            break;
+        }
+
+        case Capture::Number:
+        case Capture::NumberFromNeedle: {
+            auto first = (Capture::Number == rule.capture ? 0 : offset);
+
+            while (first < line.size() && ('0' > line[first] || '9' < line[first])) {
+                ++first;
+            }
+
+            auto last = first;
+
+            while (last < line.size() && '0' <= line[last] && '9' >= line[last]) {
+                ++last;
+            }
+
+            message.size = line.mid(first, last - first).toULongLong();
+            break;
+        }
+
+        case Capture::Line:
+            message.destination = QString::fromUtf8(line);
+            break;
+    }
+}
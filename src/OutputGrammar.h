@@ -0,0 +1,162 @@
+/**
+ * OutputGrammar.h
+ *
+ * Declaration of OutputGrammar class.
+ */
+
+#ifndef ONEDRIVETRAY_OUTPUTGRAMMAR_H
+#define ONEDRIVETRAY_OUTPUTGRAMMAR_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <QtCore/QByteArray>
+#include <QtCore/QByteArrayMatcher>
+#include <QtCore/QString>
+#include <QtCore/QVersionNumber>
+
+namespace OneDrive
+{
+    /** Enumeration of the types of message that can be parsed from the onedrive client output. */
+    enum class ProcessMessageType
+    {
+        Unknown = 0,
+        Starting,
+        ScanningLocal,
+        FetchingRemote,
+        Error,
+        Warning,
+        FreeSpace,
+        Finished,
+        LocalRootDirectoryRemoved,
+        CreateLocalDir,
+        CreateRemoteDir,
+        Rename,
+        Delete,
+        Upload,
+        Download,
+        Throttled,
+        RetryAfter,
+        Retrying,
+    };
+
+    /** A parsed message from the onedrive client. */
+    struct ProcessMessage
+    {
+        ProcessMessageType type = ProcessMessageType::Unknown;
+        uint64_t size = 0;
+        QString source;
+        QString destination;
+    };
+
+    /**
+     * The wording of the onedrive client's output for a range of client releases.
+     *
+     * A grammar is a table of rules, tried in order, each of which recognises a line by a literal prefix or a literal
+     * substring and says which part of the line is the path (or number) it reports. No regular expressions are used:
+     * the rules are compiled when the grammar is created into an index by the first byte of the line and precomputed
+     * substring matchers, so parsing a line only tries the rules that can match it.
+     */
+    class OutputGrammar
+    {
+    public:
+        /** How a rule recognises a line. */
+        enum class Match
+        {
+            /** The line starts with the needle. */
+            Prefix,
+
+            /** The line contains the needle. */
+            Contains,
+
+            /** The line contains the needle, ignoring ASCII case. The needle must be lower case. */
+            ContainsIgnoringCase,
+        };
+
+        /** Which part of a recognised line is reported. */
+        enum class Capture
+        {
+            /** Nothing. */
+            None,
+
+            /** The text after the needle, without the rule's suffix if the line ends with it. */
+            Rest,
+
+            /** The text after the needle, up to the last " ..." (the client's progress marker). */
+            RestBeforeEllipsis,
+
+            /** The text after the needle is "<source> to <destination>". */
+            Paths,
+
+            /** The first number in the line, as the size. */
+            Number,
+
+            /** The first number at or after the start of the needle, as the size. */
+            NumberFromNeedle,
+
+            /** The whole line. */
+            Line,
+        };
+
+        struct Rule
+        {
+            ProcessMessageType type;
+            Match match;
+            QByteArray needle;
+            Capture capture = Capture::None;
+            QByteArray suffix = {};
+        };
+
+        /**
+         * Compile a grammar.
+         *
+         * @param name The name of the grammar, for the log.
+         * @param rules The rules, in the order they are to be tried.
+         */
+        OutputGrammar(QString name, const std::vector<Rule> & rules);
+
+        [[nodiscard]] inline const QString & name() const
+        {
+            return m_name;
+        }
+
+        /** The rules, in the order they are tried. */
+        [[nodiscard]] std::vector<Rule> rules() const;
+
+        /** Parse a line of the client's output. */
+        [[nodiscard]] ProcessMessage parse(const QByteArray & line) const;
+
+        /**
+         * Fetch the grammar for a client release.
+         *
+         * @param version The client's version, or a null version if it isn't known, in which case the grammar for the
+         * releases before 2.5 is used.
+         */
+        [[nodiscard]] static const OutputGrammar & forVersion(const QVersionNumber & version);
+
+        /**
+         * Extract the version from the output of `onedrive --version`, e.g. "onedrive v2.4.25-1+np1".
+         *
+         * @return The version, or a null version if the output doesn't contain one.
+         */
+        [[nodiscard]] static QVersionNumber parseVersion(const QByteArray & versionOutput);
+
+    private:
+        struct CompiledRule
+        {
+            Rule rule;
+            QByteArrayMatcher matcher;
+        };
+
+        /** Extract the rule's capture from a line it has matched, the needle having been found at an offset. */
+        static void capture(const Rule & rule, const QByteArray & line, int offset, ProcessMessage & message);
+
+        QString m_name;
+        std::vector<CompiledRule> m_rules;
+
+        /** For each possible first byte of a line, the indices of the rules that can match it, in order. */
+        std::array<std::vector<int>, 256> m_candidates;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_OUTPUTGRAMMAR_H
@@ -0,0 +1,106 @@
+/**
+ * PowerMonitor.cpp
+ *
+ * Implementation of PowerMonitor class.
+ */
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtDBus/QDBusConnection>
+#include "PowerMonitor.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    const QString PowerSupplyPath = QStringLiteral("/sys/class/power_supply");
+    const QString UPowerService = QStringLiteral("org.freedesktop.UPower");
+    const QString UPowerPath = QStringLiteral("/org/freedesktop/UPower");
+    const QString UPowerDisplayDevicePath = QStringLiteral("/org/freedesktop/UPower/devices/DisplayDevice");
+    const QString PropertiesInterface = QStringLiteral("org.freedesktop.DBus.Properties");
+
+    /** Read a single-value sysfs attribute. */
+    QByteArray readAttribute(const QDir & supply, const QString & name)
+    {
+        QFile file(supply.filePath(name));
+
+        if (!file.open(QIODevice::ReadOnly)) {
+            return {};
+        }
+
+        return file.readAll().trimmed();
+    }
+}
+
+
+PowerMonitor::PowerMonitor(QObject * parent)
+        : QObject(parent),
+          m_onBattery(false),
+          m_batteryLevel(100),
+          m_timer()
+{
+    m_timer.setInterval(DefaultInterval);
+    connect(&m_timer, &QTimer::timeout, this, &PowerMonitor::refresh);
+
+    // UPower pushes changes to OnBattery on its root object and to Percentage on the display device
+    auto bus = QDBusConnection::systemBus();
+
+    if (bus.isConnected()) {
+        bus.connect(UPowerService, UPowerPath, PropertiesInterface, QStringLiteral("PropertiesChanged"), this, SLOT(onUPowerPropertiesChanged()));
+        bus.connect(UPowerService, UPowerDisplayDevicePath, PropertiesInterface, QStringLiteral("PropertiesChanged"), this, SLOT(onUPowerPropertiesChanged()));
+    }
+
+    refresh();
+    m_timer.start();
+}
+
+
+PowerMonitor::~PowerMonitor() = default;
+
+
+void PowerMonitor::onUPowerPropertiesChanged()
+{
+    refresh();
+}
+
+
+void PowerMonitor::refresh()
+{
+    bool hasMains = false;
+    bool mainsOnline = false;
+    bool discharging = false;
+    int batteries = 0;
+    int totalCapacity = 0;
+    const QDir supplies(PowerSupplyPath);
+
+    // the supplies are symlinks to their device directories
+    for (const auto & name : supplies.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        const QDir supply(supplies.filePath(name));
+        const auto type = readAttribute(supply, QStringLiteral("type"));
+
+        if ("Mains" == type || "USB" == type) {
+            hasMains = true;
+            mainsOnline = mainsOnline || "1" == readAttribute(supply, QStringLiteral("online"));
+        } else if ("Battery" == type) {
+            // ignore the batteries in wireless mice, keyboards, etc.
+            if ("Device" == readAttribute(supply, QStringLiteral("scope"))) {
+                continue;
+            }
+
+            ++batteries;
+            totalCapacity += readAttribute(supply, QStringLiteral("capacity")).toInt();
+            discharging = discharging || "Discharging" == readAttribute(supply, QStringLiteral("status"));
+        }
+    }
+
+    const auto onBattery = 0 < batteries && (hasMains ? !mainsOnline : discharging);
+    const auto batteryLevel = 0 < batteries ? totalCapacity / batteries : 100;
+
+    if (onBattery == m_onBattery && batteryLevel == m_batteryLevel) {
+        return;
+    }
+
+    m_onBattery = onBattery;
+    m_batteryLevel = batteryLevel;
+    Q_EMIT powerStateChanged(m_onBattery, m_batteryLevel);
+}
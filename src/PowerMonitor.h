@@ -0,0 +1,63 @@
+/**
+ * PowerMonitor.h
+ *
+ * Declaration of PowerMonitor class.
+ */
+
+#ifndef ONEDRIVETRAY_POWERMONITOR_H
+#define ONEDRIVETRAY_POWERMONITOR_H
+
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+
+namespace OneDrive
+{
+    /**
+     * Tracks whether the machine is running on battery, and the battery charge level.
+     *
+     * The state is read from /sys/class/power_supply. It is re-read periodically, and immediately when UPower reports a
+     * change over D-Bus if UPower is running.
+     */
+    class PowerMonitor
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** How often the power supply state is re-read (ms). */
+        static constexpr const int DefaultInterval = 60000;
+
+        explicit PowerMonitor(QObject * parent = nullptr);
+
+        ~PowerMonitor() override;
+
+        /** Whether the machine is running on battery power. */
+        [[nodiscard]] inline bool onBattery() const
+        {
+            return m_onBattery;
+        }
+
+        /** The battery charge level as a percentage. 100 if there is no battery. */
+        [[nodiscard]] inline int batteryLevel() const
+        {
+            return m_batteryLevel;
+        }
+
+        /** Re-read the power supply state, emitting powerStateChanged() if it has changed. */
+        void refresh();
+
+    Q_SIGNALS:
+        void powerStateChanged(bool onBattery, int batteryLevel);
+
+    private Q_SLOTS:
+        /** Receiver for UPower's PropertiesChanged D-Bus signal. */
+        void onUPowerPropertiesChanged();
+
+    private:
+        bool m_onBattery;
+        int m_batteryLevel;
+        QTimer m_timer;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_POWERMONITOR_H
@@ -4,10 +4,16 @@
  * Implementation of Process class.
  */
 
-#include <iostream>
-#include <QtCore/QRegularExpression>
+#include <algorithm>
+#include <csignal>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
 #include "Process.h"
-#include "Application.h"
+#include "Logger.h"
 
 using namespace OneDrive;
 
@@ -16,100 +22,66 @@ namespace
     const QString DefaultExecutablePath = QLatin1String("/usr/bin/onedrive");
     const QStringList DefaultArguments = {QLatin1String("--verbose"), QLatin1String("--monitor")};
 
-    /** Enumeration of the types of message that can be parsed from the onedrive client output. */
-    enum class ProcessMessageType
-    {
-        Unknown = 0,
-        FreeSpace,
-        Finished,
-        LocalRootDirectoryRemoved,
-        CreateLocalDir,
-        CreateRemoteDir,
-        Rename,
-        Delete,
-        Upload,
-        Download,
-    };
-
-    /** A parsed message from the onedrive client. */
-    struct ProcessMessage
-    {
-        ProcessMessageType type = ProcessMessageType::Unknown;
-        uint64_t size = 0;
-        QString source;
-        QString destination;
-    };
+    /** How long to wait for the client to report its version (ms). */
+    constexpr const int VersionTimeout = 5000;
+
+    /** The name of the cgroup the client is run in, when enabled. */
+    const QString CGroupName = QStringLiteral("onedrive");
 
+    /** Values for the ioprio_set() system call, which has no glibc wrapper (see linux/ioprio.h). */
+    constexpr const int IoPriorityWhoProcess = 1;
+    constexpr const int IoPriorityClassShift = 13;
+    constexpr const int IoPriorityClassBestEffort = 2;
+    constexpr const int IoPriorityClassIdle = 3;
 
-    ProcessMessage parseProcessOutputLine(const QByteArray &line)
+    /** Encode the I/O priority in the form ioprio_set() expects. 0 resets to the default for the nice value. */
+    int ioPriorityValue(const ResourceLimits & limits)
     {
-        ProcessMessage message;
+        switch (limits.ioPriorityClass) {
+            case IoPriorityClass::Default:
+                break;
 
-        if (line.toLower().contains("remaining free space")) {
-            message.type = ProcessMessageType::FreeSpace;
+            case IoPriorityClass::BestEffort:
+                return (IoPriorityClassBestEffort << IoPriorityClassShift) | std::clamp(limits.ioPriorityLevel, 0, ResourceLimits::MaximumIoPriorityLevel);
 
-            if (auto match = QRegularExpression("([0-9]+)").match(line); match.hasMatch()) {
-                message.size = match.captured(1).toLongLong();
-            }
-        } else if (line.contains("Sync with OneDrive is complete")) {
-            message.type = ProcessMessageType::Finished;
-        } else if (line.contains("Monitored directory removed")) {
-            message.type = ProcessMessageType::LocalRootDirectoryRemoved;
-        } else if (line.left(26) == "Creating local directory: ") {
-            message.type = ProcessMessageType::CreateLocalDir;
-            message.destination = line.right(line.size() - 26);
-        } else if (line.left(42) == "Successfully created the remote directory ") {
-            message.type = ProcessMessageType::CreateRemoteDir;
-            // Remove " on OneDrive" at the end
-            message.destination = line.mid(42, line.size() - 54);
-        } else if (line.left(7) == "Moving ") {
-            message.type = ProcessMessageType::Rename;
-
-            if (const auto match = QRegularExpression("^Moving (.+) to (.+)$").match(line); match.hasMatch()) {
-                message.source = match.captured(1);
-                message.destination = match.captured(2);
+            case IoPriorityClass::Idle:
+                return IoPriorityClassIdle << IoPriorityClassShift;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Parse a CPU list in cpuset format (e.g. "0-3,6").
+     *
+     * @return The CPU set, or nothing if the list is empty or invalid.
+     */
+    std::optional<cpu_set_t> parseCpuList(const std::string & list)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+
+        for (const auto & range : QString::fromStdString(list).split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+            const auto bounds = range.trimmed().split(QLatin1Char('-'));
+            bool firstOk = false;
+            bool lastOk = false;
+            const auto first = bounds.first().toInt(&firstOk);
+            const auto last = bounds.last().toInt(&lastOk);
+
+            if (2 < bounds.size() || !firstOk || !lastOk || 0 > first || last < first || CPU_SETSIZE <= last) {
+                return {};
             }
-        } else if (auto match = QRegularExpression(
-                    "(Downloading (?:new |modified)?file|Uploading (?:new |modified )?file|Deleting item)").match(
-                    line); match.hasMatch()) {
-            const auto type = match.captured(1);
-
-            if (type == "Deleting item") {
-                message.type = ProcessMessageType::Delete;
-
-                if (match = QRegularExpression("(?: item from OneDrive:| item) (.+)$").match(line); match.hasMatch()) {
-                    message.destination = match.captured(1);
-                }
-            } else if (type.contains("Uploading")) {
-                message.type = ProcessMessageType::Upload;
-
-                if (match = QRegularExpression(R"((?:Uploading (?:new |modified )?file) (.+) \.\.\.)").match(
-                            line); match.hasMatch()) {
-                    auto fileName = match.captured(1);
-
-                    if (fileName.endsWith(" ...")) {
-                        fileName.truncate(fileName.size() - 4);
-                    }
-
-                    message.destination = fileName;
-                }
-            } else if (line.contains("Downloading")) {
-                message.type = ProcessMessageType::Download;
-
-                if (match = QRegularExpression(R"((?:Downloading (?:new |modified )?file) (.+) \.\.\.)").match(
-                            line); match.hasMatch()) {
-                    auto fileName = match.captured(1);
-
-                    if (fileName.endsWith(" ...")) {
-                        fileName.truncate(fileName.size() - 4);
-                    }
-
-                    message.destination = fileName;
-                }
+
+            for (auto cpu = first; cpu <= last; ++cpu) {
+                CPU_SET(cpu, &cpus);
             }
         }
 
-        return message;
+        if (0 == CPU_COUNT(&cpus)) {
+            return {};
+        }
+
+        return cpus;
     }
 }
 
@@ -118,103 +90,479 @@ Process::Process(const std::optional<QString> &executable, const std::optional<Q
         : QProcess(),
           m_executablePath(static_cast<bool>(executable) ? *executable : DefaultExecutablePath),
           m_args(static_cast<bool>(args) ? *args : DefaultArguments),
-          m_syncState(SynchronisationState::Idle)
+          m_syncState(SynchronisationState::Stopped),
+          m_idleTimer(),
+          m_phaseTimer(),
+          m_cycleTimer(),
+          m_currentCycle(),
+          m_lastCycle(),
+          m_paused(false),
+          m_pausedByFreezer(false),
+          m_outputBuffer(),
+          m_errorBuffer(),
+          m_outputTimestamp(),
+          m_discardingOutputLine(false),
+          m_discardingErrorLine(false),
+          m_versionProbe(nullptr),
+          m_clientVersion(),
+          m_grammar(&OutputGrammar::forVersion({}))
 {
     connect(this, &QProcess::readyReadStandardOutput, this, &Process::readOutput);
     connect(this, &QProcess::readyReadStandardError, this, &Process::readError);
+
+    m_idleTimer.setSingleShot(true);
+
+    connect(&m_idleTimer, &QTimer::timeout, this, [this]() {
+        setSynchronisationState(SynchronisationState::Idle);
+    });
+
+    connect(this, &QProcess::started, this, [this]() {
+        enterActivePhase(SynchronisationState::Starting);
+    });
+
+    connect(this, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, [this]() {
+        m_outputBuffer.clear();
+        m_errorBuffer.clear();
+        m_discardingOutputLine = false;
+        m_discardingErrorLine = false;
+        m_paused = false;
+        m_pausedByFreezer = false;
+        m_idleTimer.stop();
+        setSynchronisationState(SynchronisationState::Stopped);
+    });
+
     connect(this, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, &Process::stopped);
+    connect(this, &QProcess::started, this, &Process::applyCgroupLimits);
 }
 
 
 Process::~Process() = default;
 
 
-void Process::readOutput()
+QString Process::synchronisationStateName(SynchronisationState state)
+{
+    switch (state) {
+        case SynchronisationState::Idle:
+            return tr("Idle");
+
+        case SynchronisationState::Stopped:
+            return tr("Stopped");
+
+        case SynchronisationState::Starting:
+            return tr("Starting");
+
+        case SynchronisationState::ScanningLocal:
+            return tr("Scanning local files");
+
+        case SynchronisationState::FetchingRemote:
+            return tr("Fetching remote changes");
+
+        case SynchronisationState::Transferring:
+            return tr("Transferring");
+
+        case SynchronisationState::Error:
+            return tr("Error");
+    }
+
+    throw std::logic_error("Unhandled sync state in Process::synchronisationStateName()");
+}
+
+
+void Process::detectClientVersion()
+{
+    // the probe that's already running chooses the grammar when it finishes
+    if (m_versionProbe) {
+        return;
+    }
+
+    m_versionProbe = new QProcess(this);
+    connect(m_versionProbe, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, &Process::onVersionProbeFinished);
+
+    connect(m_versionProbe, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        // finished() is never emitted for a client that can't be run at all
+        if (QProcess::FailedToStart == error) {
+            onVersionProbeFinished();
+        }
+    });
+
+    // killing a client that doesn't answer emits finished(), with no version in the output
+    QTimer::singleShot(VersionTimeout, m_versionProbe, &QProcess::kill);
+    m_versionProbe->start(program().isEmpty() ? m_executablePath : program(), {QStringLiteral("--version")}, QIODevice::ReadOnly);
+}
+
+
+void Process::onVersionProbeFinished()
+{
+    m_clientVersion = OutputGrammar::parseVersion(m_versionProbe->readAllStandardOutput());
+    m_grammar = &OutputGrammar::forVersion(m_clientVersion);
+    m_versionProbe->deleteLater();
+    m_versionProbe = nullptr;
+
+    if (m_clientVersion.isNull()) {
+        Logger::log(LogLevel::Warning, LogCategory::Process, QStringLiteral("could not determine the onedrive client version, assuming the %1 output grammar").arg(m_grammar->name()));
+    } else {
+        Logger::log(LogLevel::Info, LogCategory::Process, QStringLiteral("onedrive client version %1, using the %2 output grammar").arg(m_clientVersion.toString(), m_grammar->name()));
+    }
+}
+
+
+void Process::setSynchronisationState(SynchronisationState state)
+{
+    if (state == m_syncState) {
+        return;
+    }
+
+    const auto previous = m_syncState;
+    const auto phaseDuration = m_phaseTimer.isValid() ? m_phaseTimer.restart() : 0;
+    m_syncState = state;
+
+    if (!m_phaseTimer.isValid()) {
+        m_phaseTimer.start();
+    }
+
+    if (isSynchronising(previous)) {
+        m_currentCycle.phaseDurations[static_cast<int>(previous)] += phaseDuration;
+    }
+
+    Q_EMIT phaseCompleted(previous, phaseDuration);
+    Q_EMIT synchronisationStateChanged(state, previous);
+
+    if (!isSynchronising(previous) && isSynchronising(state)) {
+        m_currentCycle = {};
+        m_cycleTimer.start();
+    } else if (isSynchronising(previous) && !isSynchronising(state)) {
+        m_currentCycle.duration = m_cycleTimer.elapsed();
+        m_currentCycle.end = currentTimestamp();
+        m_lastCycle = m_currentCycle;
+        Q_EMIT synchronisationCycleCompleted(m_lastCycle);
+    }
+}
+
+
+Process::SynchronisationState Process::currentActivePhase() const
+{
+    return isSynchronising(m_syncState) ? m_syncState : SynchronisationState::FetchingRemote;
+}
+
+
+void Process::enterActivePhase(SynchronisationState state)
+{
+    // if the client goes quiet without reporting the end of the sync, eventually assume it's idle
+    m_idleTimer.start(QuietTimeout);
+    setSynchronisationState(state);
+}
+
+
+bool Process::pause()
+{
+    if (!isRunning()) {
+        return false;
+    }
+
+    if (m_paused) {
+        return true;
+    }
+
+    // the freezer stops all the client's threads atomically and without the client being able to observe it
+    if (m_cgroup && m_resourceLimits.useCgroup && m_cgroup->setFrozen(true)) {
+        m_pausedByFreezer = true;
+    } else if (0 != ::kill(static_cast<pid_t>(processId()), SIGSTOP)) {
+        return false;
+    }
+
+    m_paused = true;
+    Q_EMIT paused();
+    return true;
+}
+
+
+bool Process::resume()
+{
+    if (!isRunning()) {
+        return false;
+    }
+
+    if (!m_paused) {
+        return true;
+    }
+
+    if (m_pausedByFreezer) {
+        if (!m_cgroup->setFrozen(false)) {
+            return false;
+        }
+    } else if (0 != ::kill(static_cast<pid_t>(processId()), SIGCONT)) {
+        return false;
+    }
+
+    m_paused = false;
+    m_pausedByFreezer = false;
+    Q_EMIT resumed();
+    return true;
+}
+
+
+void Process::setResourceLimits(const ResourceLimits & limits)
 {
-    static QByteArray buffer;
+    m_resourceLimits = limits;
+    m_resourceLimits.niceValue = std::clamp(m_resourceLimits.niceValue, ResourceLimits::MinimumNiceValue, ResourceLimits::MaximumNiceValue);
+    m_cpuAffinity = parseCpuList(m_resourceLimits.cpuAffinity);
 
-    buffer += readAllStandardOutput();
+    if (!isRunning()) {
+        return;
+    }
+
+    applySchedulingLimits();
+    applyCgroupLimits();
+}
+
+
+void Process::setupChildProcess()
+{
+    // this runs in the forked child before exec(), so only plain system calls are made here; the settings are
+    // inherited by all the threads the client creates
+    if (0 != m_resourceLimits.niceValue) {
+        setpriority(PRIO_PROCESS, 0, m_resourceLimits.niceValue);
+    }
+
+    if (const auto ioPriority = ioPriorityValue(m_resourceLimits); 0 != ioPriority) {
+        syscall(SYS_ioprio_set, IoPriorityWhoProcess, 0, ioPriority);
+    }
+
+    if (m_cpuAffinity) {
+        sched_setaffinity(0, sizeof(cpu_set_t), &*m_cpuAffinity);
+    }
+}
+
+
+void Process::applySchedulingLimits() const
+{
+    cpu_set_t cpus;
+
+    if (m_cpuAffinity) {
+        cpus = *m_cpuAffinity;
+    } else if (0 != sched_getaffinity(0, sizeof(cpu_set_t), &cpus)) {
+        // restore the client to the CPUs the tray can use
+        CPU_ZERO(&cpus);
+    }
+
+    const auto ioPriority = ioPriorityValue(m_resourceLimits);
+    bool success = true;
+
+    // the scheduling attributes are per-thread, so each of the client's threads must be updated
+    for (const auto & task : QDir(QStringLiteral("/proc/%1/task").arg(processId())).entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        const auto tid = task.toInt();
+        success = 0 == setpriority(PRIO_PROCESS, static_cast<id_t>(tid), m_resourceLimits.niceValue) && success;
+        success = 0 == syscall(SYS_ioprio_set, IoPriorityWhoProcess, tid, ioPriority) && success;
+
+        if (0 < CPU_COUNT(&cpus)) {
+            success = 0 == sched_setaffinity(tid, sizeof(cpu_set_t), &cpus) && success;
+        }
+    }
+
+    if (!success) {
+        Logger::log(LogLevel::Warning, LogCategory::Process, QStringLiteral("failed to apply some scheduling limits to the onedrive process"));
+    }
+}
+
+
+void Process::applyCgroupLimits()
+{
+    if (!m_resourceLimits.useCgroup) {
+        if (m_cgroup) {
+            // a process can't be moved back out of a delegated subtree, so just lift the limits
+            m_cgroup->setCpuMax(0);
+            m_cgroup->setCpuWeight(ResourceLimits::DefaultCgroupCpuWeight);
+            m_cgroup->setMemoryHigh(0);
+            m_cgroup->setIoMax({});
+        }
+
+        return;
+    }
+
+    if (!m_cgroup) {
+        m_cgroup = CGroup::create(CGroupName);
+
+        if (!m_cgroup) {
+            Logger::log(LogLevel::Warning, LogCategory::Process, QStringLiteral("cgroup v2 delegation is not available, cgroup limits will not be applied"));
+            return;
+        }
+    }
+
+    auto success = m_cgroup->addProcess(processId());
+    success = m_cgroup->setCpuMax(m_resourceLimits.cgroupCpuMax) && success;
+    success = m_cgroup->setCpuWeight(m_resourceLimits.cgroupCpuWeight) && success;
+    success = m_cgroup->setMemoryHigh(m_resourceLimits.cgroupMemoryHigh) && success;
+    success = m_cgroup->setIoMax(QString::fromStdString(m_resourceLimits.cgroupIoMax)) && success;
+
+    if (!success) {
+        Logger::log(LogLevel::Warning, LogCategory::Process, QStringLiteral("failed to apply some cgroup limits to the onedrive process in %1").arg(m_cgroup->path()));
+    }
+}
+
+
+QList<QByteArray> Process::takeLines(QByteArray & buffer, bool & discarding)
+{
+    QList<QByteArray> lines;
+    int start = 0;
+
+    for (auto end = buffer.indexOf('\n'); 0 <= end; end = buffer.indexOf('\n', start)) {
+        if (discarding) {
+            // the end of a line whose start has already been discarded
+            discarding = false;
+        } else {
+            lines.append(buffer.mid(start, std::min(end - start, MaximumLineLength)));
+        }
 
-    if (oneDriveApp->inDebugMode()) {
-        std::cerr << qPrintable(buffer) << std::flush;
+        start = end + 1;
     }
 
-    for (const QByteArray &line: buffer.split('\n')) {
-        const auto previousSyncState = synchronisationState();
-        const auto message = parseProcessOutputLine(line);
+    buffer.remove(0, start);
 
+    if (MaximumLineLength < buffer.size()) {
+        if (!discarding) {
+            Logger::log(LogLevel::Warning, LogCategory::Process, QStringLiteral("discarding a line of more than %1 bytes from the onedrive process").arg(MaximumLineLength));
+        }
+
+        discarding = true;
+        buffer.clear();
+    }
+
+    return lines;
+}
+
+
+Process::Timestamp Process::currentTimestamp()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return {QDateTime::currentMSecsSinceEpoch(), clock.msecsSinceReference()};
+}
+
+
+void Process::readOutput()
+{
+    m_outputTimestamp = currentTimestamp();
+    m_outputBuffer += readAllStandardOutput();
+
+    // only complete lines are parsed - the partial line at the end is kept until the rest of it arrives. the lines are
+    // taken out of the buffer first in case a receiver re-enters the event loop
+    const auto lines = takeLines(m_outputBuffer, m_discardingOutputLine);
+    const auto logLines = Logger::isEnabled(LogLevel::Debug);
+
+    for (const QByteArray &line: lines) {
+        if (logLines) {
+            Logger::log(LogLevel::Debug, LogCategory::ClientOutput, line);
+        }
+
+        const auto message = m_grammar->parse(line);
+
+        // lines that don't indicate a phase leave the state alone; the end of a sync only takes effect once the client
+        // has stayed quiet for IdleHysteresis, so the state doesn't flicker between cycles
         switch (message.type) {
             case ProcessMessageType::Unknown:
-                m_syncState = SynchronisationState::Idle;
+                break;
+
+            case ProcessMessageType::Starting:
+                enterActivePhase(SynchronisationState::Starting);
+                break;
+
+            case ProcessMessageType::ScanningLocal:
+                enterActivePhase(SynchronisationState::ScanningLocal);
+                break;
+
+            case ProcessMessageType::FetchingRemote:
+                enterActivePhase(SynchronisationState::FetchingRemote);
+                break;
+
+            case ProcessMessageType::Error:
+                enterActivePhase(SynchronisationState::Error);
+                Q_EMIT errorReported(message.destination);
+                break;
+
+            case ProcessMessageType::Warning:
+                Q_EMIT errorReported(message.destination);
                 break;
 
             case ProcessMessageType::FreeSpace:
-                m_syncState = SynchronisationState::Idle;
                 Q_EMIT freeSpaceUpdated(message.size);
                 Q_EMIT synchronisationComplete();
                 break;
 
             case ProcessMessageType::Finished:
-                m_syncState = SynchronisationState::Idle;
+                m_idleTimer.start(IdleHysteresis);
                 Q_EMIT synchronisationComplete();
                 break;
 
             case ProcessMessageType::LocalRootDirectoryRemoved:
-                m_syncState = SynchronisationState::Idle;
+                m_idleTimer.start(IdleHysteresis);
                 Q_EMIT localRootDirectoryRemoved();
                 break;
 
             case ProcessMessageType::CreateLocalDir:
-                m_syncState = SynchronisationState::Syncing;
+                enterActivePhase(SynchronisationState::Transferring);
                 Q_EMIT localDirectoryCreated(message.destination);
                 break;
 
             case ProcessMessageType::CreateRemoteDir:
-                m_syncState = SynchronisationState::Syncing;
+                enterActivePhase(SynchronisationState::Transferring);
                 Q_EMIT remoteDirectoryCreated(message.destination);
                 break;
 
             case ProcessMessageType::Delete:
-                m_syncState = SynchronisationState::Syncing;
+                enterActivePhase(SynchronisationState::Transferring);
                 Q_EMIT fileDeleted(message.destination);
                 break;
 
             case ProcessMessageType::Rename:
-                m_syncState = SynchronisationState::Syncing;
+                enterActivePhase(SynchronisationState::Transferring);
                 Q_EMIT fileRenamed(message.source, message.destination);
                 break;
 
             case ProcessMessageType::Upload:
-                m_syncState = SynchronisationState::Syncing;
+                enterActivePhase(SynchronisationState::Transferring);
                 Q_EMIT fileUploaded(message.destination);
                 break;
 
             case ProcessMessageType::Download:
-                m_syncState = SynchronisationState::Syncing;
+                enterActivePhase(SynchronisationState::Transferring);
                 Q_EMIT fileDownloaded(message.destination);
                 break;
-        }
 
-        if (previousSyncState != synchronisationState()) {
-            Q_EMIT synchronisationStateChanged(synchronisationState(), previousSyncState);
-        }
-    }
+            // the client is still busy while it waits to retry, so these keep the current phase
+            case ProcessMessageType::Throttled:
+                enterActivePhase(currentActivePhase());
+                Q_EMIT throttled(static_cast<int>(message.size));
+                break;
 
-    if (const int lastLineEnd = buffer.lastIndexOf('\n'); 0 <= lastLineEnd) {
-        buffer = buffer.right(buffer.size() - lastLineEnd);
-    } else {
-        buffer.clear();
+            case ProcessMessageType::RetryAfter: {
+                const auto delay = static_cast<qint64>(std::min<uint64_t>(message.size, MaximumRetryAfter)) * 1000;
+
+                // the client is quiet while it waits, which mustn't be taken for the end of the sync
+                enterActivePhase(currentActivePhase());
+                m_idleTimer.start(static_cast<int>(QuietTimeout + delay));
+                Q_EMIT backingOff(delay);
+                break;
+            }
+
+            case ProcessMessageType::Retrying:
+                enterActivePhase(currentActivePhase());
+                Q_EMIT retrying();
+                break;
+        }
     }
 }
 
 
 void Process::readError()
 {
-    const auto errors = readAllStandardError();
-
-    if (!oneDriveApp->inDebugMode()) {
-        return;
+    m_outputTimestamp = currentTimestamp();
+    m_errorBuffer += readAllStandardError();
+    const auto lines = takeLines(m_errorBuffer, m_discardingErrorLine);
+
+    for (const auto & line : lines) {
+        if (!line.isEmpty()) {
+            Logger::log(LogLevel::Warning, LogCategory::ClientError, line);
+            Q_EMIT errorReported(QString::fromUtf8(line));
+        }
     }
-
-    std::cerr << qPrintable(errors) << std::flush;
 }
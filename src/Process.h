@@ -7,10 +7,18 @@
 #ifndef ONEDRIVETRAY_PROCESS_H
 #define ONEDRIVETRAY_PROCESS_H
 
+#include <array>
 #include <optional>
+#include <sched.h>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QProcess>
 #include <QtCore/QString>
 #include <QtCore/QStringList>
+#include <QtCore/QTimer>
+#include <QtCore/QVersionNumber>
+#include "OutputGrammar.h"
+#include "ResourceLimits.h"
+#include "CGroup.h"
 
 namespace OneDrive
 {
@@ -21,10 +29,67 @@ namespace OneDrive
     Q_OBJECT
 
     public:
+        /**
+         * The phases the client goes through.
+         *
+         * A synchronisation cycle is the time spent in the phases between leaving Idle (or Stopped) and returning to
+         * it.
+         */
         enum class SynchronisationState
         {
             Idle = 0,
-            Syncing,
+            Stopped,
+            Starting,
+            ScanningLocal,
+            FetchingRemote,
+            Transferring,
+            Error,
+        };
+
+        static constexpr const int SynchronisationStateCount = 7;
+
+        /**
+         * How long the client must have reported the end of a sync without further activity before it is considered
+         * idle (ms).
+         */
+        static constexpr const int IdleHysteresis = 2000;
+
+        /** How long the client can be quiet during a sync before it is assumed to be idle (ms). */
+        static constexpr const int QuietTimeout = 10 * 60 * 1000;
+
+        /** The longest Retry-After the client is believed to wait for (s). Longer values are clamped to this. */
+        static constexpr const int MaximumRetryAfter = 60 * 60;
+
+        /**
+         * The longest line of the client's output that is parsed, in bytes.
+         *
+         * Longer lines are truncated, and a partial line that grows beyond this is discarded up to its end, so that
+         * the time taken to parse a line and the memory used to buffer the output are bounded whatever the client
+         * writes.
+         */
+        static constexpr const int MaximumLineLength = 64 * 1024;
+
+        /** When something happened, by both the wall clock and the monotonic clock. */
+        struct Timestamp
+        {
+            /** The wall-clock time, in ms since the epoch. For display. */
+            qint64 wallTime = 0;
+
+            /** The monotonic time, in ms since QElapsedTimer's reference. For measuring intervals. */
+            qint64 monotonicTime = 0;
+        };
+
+        /** The time spent in a synchronisation cycle. */
+        struct SynchronisationCycle
+        {
+            /** The total duration of the cycle (ms). */
+            qint64 duration = 0;
+
+            /** The time spent in each phase of the cycle (ms), indexed by SynchronisationState. */
+            std::array<qint64, SynchronisationStateCount> phaseDurations = {};
+
+            /** When the cycle ended. */
+            Timestamp end;
         };
 
         explicit Process(const std::optional<QString> &executable = {}, const std::optional<QStringList> &args = {});
@@ -41,11 +106,106 @@ namespace OneDrive
             return m_syncState;
         }
 
+        /** Whether a state is part of a synchronisation cycle (i.e. not Idle or Stopped). */
+        [[nodiscard]] static constexpr bool isSynchronising(SynchronisationState state)
+        {
+            return SynchronisationState::Idle != state && SynchronisationState::Stopped != state;
+        }
+
+        /** Fetch the timings for the most recently completed synchronisation cycle. */
+        [[nodiscard]] inline const SynchronisationCycle & lastSynchronisationCycle() const
+        {
+            return m_lastCycle;
+        }
+
+        /** Fetch a translated, human-readable name for a synchronisation state. */
+        [[nodiscard]] static QString synchronisationStateName(SynchronisationState state);
+
+        /** Whether the running client is currently paused. */
+        [[nodiscard]] inline bool isPaused() const
+        {
+            return m_paused;
+        }
+
+        /**
+         * Freeze the running client without terminating it.
+         *
+         * The client keeps its state (including its inotify watches) so that it can continue immediately when resumed.
+         * The cgroup freezer is used if the client is running in its own cgroup, otherwise it is sent SIGSTOP.
+         *
+         * @return true if the client is paused, false if it's not running or could not be paused.
+         */
+        bool pause();
+
+        /**
+         * Continue running a paused client.
+         *
+         * @return true if the client is running and not paused, false if it could not be resumed.
+         */
+        bool resume();
+
+        /** The version of the client, as determined by detectClientVersion(), or a null version if it isn't known. */
+        [[nodiscard]] inline const QVersionNumber & clientVersion() const
+        {
+            return m_clientVersion;
+        }
+
+        /**
+         * Ask the client for its version and choose the grammar its output is parsed with.
+         *
+         * The client is run briefly with --version in the background, and the grammar is chosen when it finishes, so
+         * this doesn't block. Call this before starting the client; until the version is known the output is parsed as
+         * if it came from a release before 2.5.
+         */
+        void detectClientVersion();
+
+        /** Fetch the current time. */
+        [[nodiscard]] static Timestamp currentTimestamp();
+
+        /**
+         * Take the complete lines from the front of an output buffer, truncated to MaximumLineLength.
+         *
+         * @param buffer The buffer. The partial line at the end is left in it.
+         * @param discarding Whether the start of the partial line was discarded because it was too long. Updated.
+         */
+        static QList<QByteArray> takeLines(QByteArray & buffer, bool & discarding);
+
+        /**
+         * When the output currently being handled was read from the client.
+         *
+         * The time is taken once for each read, before the lines are parsed, so receivers of the signals for the
+         * client's output see when the client produced the line rather than when they got round to handling it.
+         */
+        [[nodiscard]] inline const Timestamp & outputTimestamp() const
+        {
+            return m_outputTimestamp;
+        }
+
+        /** Fetch the scheduling and resource limits the client is run under. */
+        [[nodiscard]] inline const ResourceLimits & resourceLimits() const
+        {
+            return m_resourceLimits;
+        }
+
+        /**
+         * Set the scheduling and resource limits the client is run under.
+         *
+         * The limits are applied when the client is started and, if it is already running, to all its threads
+         * immediately. Reducing the nice value of a running client usually requires privileges the tray doesn't have.
+         */
+        void setResourceLimits(const ResourceLimits & limits);
+
     Q_SIGNALS:
 
         /** Emitted when the onedrive process has stopped/been suspended. */
         void stopped();
 
+        /** Emitted when the onedrive process has been paused. */
+        void paused();
+
+        /** Emitted when the paused onedrive process has been resumed. */
+        void resumed();
+
         /** Emitted when the onedrive process has completed its current sync. */
         void synchronisationComplete();
 
@@ -73,16 +233,104 @@ namespace OneDrive
         /** Emitted when the onedrive process deletes a file. */
         void fileDeleted(const QString &fileName);
 
+        /** Emitted for each line the onedrive process writes to stderr, and each error or warning in its output. */
+        void errorReported(const QString &message);
+
+        /** Emitted when the client reports that the server throttled it (HTTP 429) or was unavailable (HTTP 503). */
+        void throttled(int httpStatus);
+
+        /** Emitted when the client reports how long the server has told it to wait before retrying (ms). */
+        void backingOff(qint64 delay);
+
+        /** Emitted when the client reports that it is retrying a request. */
+        void retrying();
+
+        /** Emitted only when the client genuinely moves from one phase to another. */
         void synchronisationStateChanged(SynchronisationState to, SynchronisationState from) const;
 
+        /** Emitted when the client leaves a phase, with the time spent in it (ms). */
+        void phaseCompleted(SynchronisationState phase, qint64 duration) const;
+
+        /** Emitted when the client returns to Idle or Stopped at the end of a synchronisation cycle. */
+        void synchronisationCycleCompleted(const SynchronisationCycle & cycle) const;
+
     protected:
         void readOutput();
         void readError();
 
+        /** Apply the nice value, I/O priority and CPU affinity in the child before the client is executed. */
+        void setupChildProcess() override;
+
     private:
+        /** Choose the grammar from the output of the version probe, and dispose of the probe. */
+        void onVersionProbeFinished();
+
+        /**
+         * Move to a new synchronisation phase, recording the time spent in the current one.
+         *
+         * Nothing happens if the state is unchanged.
+         */
+        void setSynchronisationState(SynchronisationState state);
+
+        /** Enter an active phase, and keep it from being treated as idle while the client is busy. */
+        void enterActivePhase(SynchronisationState state);
+
+        /** The current phase if the client is synchronising, otherwise FetchingRemote, for activity with no phase. */
+        [[nodiscard]] SynchronisationState currentActivePhase() const;
+
+        /** Apply the nice value, I/O priority and CPU affinity to all threads of the running client. */
+        void applySchedulingLimits() const;
+
+        /** Move the running client into its cgroup and apply the cgroup limits. */
+        void applyCgroupLimits();
+
         QString m_executablePath;
         QStringList m_args;
         SynchronisationState m_syncState;
+
+        /** Moves the client to Idle once it has been quiet for long enough. */
+        QTimer m_idleTimer;
+
+        /** Time spent in the current phase. */
+        QElapsedTimer m_phaseTimer;
+
+        /** Time spent in the current cycle. */
+        QElapsedTimer m_cycleTimer;
+
+        SynchronisationCycle m_currentCycle;
+        SynchronisationCycle m_lastCycle;
+        bool m_paused;
+
+        /** Whether the current pause used the cgroup freezer rather than SIGSTOP. */
+        bool m_pausedByFreezer;
+
+        ResourceLimits m_resourceLimits;
+
+        /** The parsed ResourceLimits::cpuAffinity, if any. */
+        std::optional<cpu_set_t> m_cpuAffinity;
+
+        /** The client's cgroup, once created. */
+        std::optional<CGroup> m_cgroup;
+
+        /** Output from the client that doesn't yet form a complete line. */
+        QByteArray m_outputBuffer;
+        QByteArray m_errorBuffer;
+
+        /** When the output being handled was read. */
+        Timestamp m_outputTimestamp;
+
+        /** Whether the rest of an overlong line is being discarded. */
+        bool m_discardingOutputLine;
+        bool m_discardingErrorLine;
+
+        /** The client run with --version, while detectClientVersion() is waiting for it. */
+        QProcess * m_versionProbe;
+
+        /** The client's version, if known. */
+        QVersionNumber m_clientVersion;
+
+        /** The grammar for the client's version. Never null. */
+        const OutputGrammar * m_grammar;
     };
 
 } // OneDrive
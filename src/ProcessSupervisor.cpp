@@ -0,0 +1,333 @@
+/**
+ * ProcessSupervisor.cpp
+ *
+ * Implementation of ProcessSupervisor class.
+ */
+
+#include <algorithm>
+#include <QtCore/QFile>
+#include <QtCore/QRandomGenerator>
+#include "ProcessSupervisor.h"
+#include "Process.h"
+#include "Logger.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /** How long to wait for the client to terminate before killing it (ms). */
+    constexpr const int TerminateGracePeriod = 10000;
+
+    /** The longest interval between watchdog checks (ms). */
+    constexpr const int MaximumWatchdogCheckInterval = 30000;
+
+    /** The proportion by which the restart delay is randomly varied either way. */
+    constexpr const double RestartDelayJitter = 0.2;
+}
+
+
+ProcessSupervisor::ProcessSupervisor(Process & process, QObject * parent)
+        : QObject(parent),
+          m_process(process),
+          m_supervising(false),
+          m_stopping(false),
+          m_restarting(false),
+          m_autoRestart(true),
+          m_watchdogTimeout(DefaultWatchdogTimeout),
+          m_watchdogAction(WatchdogAction::Notify),
+          m_restartAttempt(0),
+          m_clock(),
+          m_recentExits(),
+          m_uptime(),
+          m_lastActivity(),
+          m_lastCpuTicks(),
+          m_restartTimer(),
+          m_watchdogTimer()
+{
+    m_clock.start();
+    m_restartTimer.setSingleShot(true);
+
+    connect(&m_restartTimer, &QTimer::timeout, this, &ProcessSupervisor::restartProcess);
+    connect(&m_watchdogTimer, &QTimer::timeout, this, &ProcessSupervisor::checkWatchdog);
+
+    connect(&m_process, &QProcess::started, this, [this]() {
+        m_uptime.start();
+        recordActivity();
+        m_lastCpuTicks.reset();
+
+        if (0 < m_watchdogTimeout) {
+            m_watchdogTimer.start();
+        }
+    });
+
+    connect(&m_process, &QProcess::readyReadStandardOutput, this, &ProcessSupervisor::recordActivity);
+    connect(&m_process, &QProcess::readyReadStandardError, this, &ProcessSupervisor::recordActivity);
+    connect(&m_process, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, &ProcessSupervisor::onProcessFinished);
+    connect(&m_process, &QProcess::errorOccurred, this, &ProcessSupervisor::onProcessError);
+
+    setWatchdogTimeout(m_watchdogTimeout);
+}
+
+
+ProcessSupervisor::~ProcessSupervisor() = default;
+
+
+void ProcessSupervisor::start()
+{
+    m_restartTimer.stop();
+    m_restartAttempt = 0;
+    m_recentExits.clear();
+    m_supervising = true;
+    m_stopping = false;
+    m_restarting = false;
+
+    if (!m_process.isRunning()) {
+        m_process.start();
+    }
+}
+
+
+void ProcessSupervisor::stop()
+{
+    m_supervising = false;
+    m_restarting = false;
+    m_restartTimer.stop();
+    m_watchdogTimer.stop();
+
+    if (!m_process.isRunning()) {
+        return;
+    }
+
+    m_stopping = true;
+
+    // a paused client would not act on the termination request until it was resumed
+    m_process.resume();
+    terminateProcess();
+}
+
+
+void ProcessSupervisor::restart()
+{
+    if (!m_process.isRunning()) {
+        start();
+        return;
+    }
+
+    stop();
+    m_restarting = true;
+}
+
+
+void ProcessSupervisor::setAutoRestart(bool restart)
+{
+    m_autoRestart = restart;
+
+    if (!m_autoRestart) {
+        m_restartTimer.stop();
+    }
+}
+
+
+void ProcessSupervisor::setWatchdogTimeout(int seconds)
+{
+    m_watchdogTimeout = std::max(0, seconds);
+
+    if (0 == m_watchdogTimeout) {
+        m_watchdogTimer.stop();
+        return;
+    }
+
+    // check often enough that a hang is detected reasonably close to the timeout
+    m_watchdogTimer.setInterval(std::clamp(m_watchdogTimeout * 1000 / 4, 1000, MaximumWatchdogCheckInterval));
+
+    if (m_process.isRunning()) {
+        recordActivity();
+        m_watchdogTimer.start();
+    }
+}
+
+
+void ProcessSupervisor::onProcessFinished()
+{
+    m_watchdogTimer.stop();
+
+    if (m_stopping || !m_supervising) {
+        m_stopping = false;
+
+        if (m_restarting) {
+            // started from the event loop, so that the other receivers of finished() see the client as stopped
+            m_restarting = false;
+            m_supervising = true;
+            m_restartTimer.start(0);
+        }
+
+        return;
+    }
+
+    handleUnexpectedExit();
+}
+
+
+void ProcessSupervisor::onProcessError(QProcess::ProcessError error)
+{
+    // crashes are also reported through finished(), so only failure to start needs handling here
+    if (QProcess::ProcessError::FailedToStart != error || !m_supervising) {
+        return;
+    }
+
+    handleUnexpectedExit();
+}
+
+
+void ProcessSupervisor::handleUnexpectedExit()
+{
+    if (m_uptime.isValid() && StableRunTime <= m_uptime.elapsed()) {
+        m_restartAttempt = 0;
+    }
+
+    m_uptime.invalidate();
+
+    if (!m_autoRestart) {
+        return;
+    }
+
+    const auto now = m_clock.elapsed();
+    m_recentExits.erase(
+            std::remove_if(m_recentExits.begin(), m_recentExits.end(), [now](qint64 exitTime) -> bool {
+                return CrashLoopWindow < now - exitTime;
+            }),
+            m_recentExits.end()
+    );
+    m_recentExits.append(now);
+
+    if (CrashLoopExitCount <= m_recentExits.size()) {
+        m_supervising = false;
+        Logger::log(LogLevel::Error, LogCategory::Supervisor, QStringLiteral("onedrive exited %1 times in quick succession, not restarting").arg(m_recentExits.size()));
+        Q_EMIT crashLoopDetected(m_recentExits.size());
+        return;
+    }
+
+    ++m_restartAttempt;
+    const auto delay = nextRestartDelay();
+    m_restartTimer.start(delay);
+    Logger::log(LogLevel::Warning, LogCategory::Supervisor, QStringLiteral("onedrive exited unexpectedly (exit code %1), restart attempt %2 in %3ms").arg(m_process.exitCode()).arg(m_restartAttempt).arg(delay));
+    Q_EMIT restartScheduled(m_restartAttempt, delay);
+}
+
+
+int ProcessSupervisor::nextRestartDelay() const
+{
+    // InitialRestartDelay * 2^(attempt - 1), capped, with the shift bounded to avoid overflow
+    const auto shift = std::min(m_restartAttempt - 1, 16);
+    const auto delay = std::min<qint64>(static_cast<qint64>(InitialRestartDelay) << shift, MaximumRestartDelay);
+    const auto jitter = 1.0 + RestartDelayJitter * (2.0 * QRandomGenerator::global()->generateDouble() - 1.0);
+    return static_cast<int>(static_cast<double>(delay) * jitter);
+}
+
+
+void ProcessSupervisor::restartProcess()
+{
+    if (!m_supervising || m_process.isRunning()) {
+        return;
+    }
+
+    m_process.start();
+}
+
+
+void ProcessSupervisor::recordActivity()
+{
+    m_lastActivity.start();
+}
+
+
+void ProcessSupervisor::checkWatchdog()
+{
+    if (!m_process.isRunning() || 0 == m_watchdogTimeout) {
+        return;
+    }
+
+    // a paused client is expected to be inactive
+    if (m_process.isPaused()) {
+        recordActivity();
+        return;
+    }
+
+    if (const auto ticks = readCpuTicks(); ticks) {
+        if (m_lastCpuTicks && *m_lastCpuTicks != *ticks) {
+            recordActivity();
+        }
+
+        m_lastCpuTicks = ticks;
+    }
+
+    const auto idleSeconds = static_cast<int>(m_lastActivity.elapsed() / 1000);
+
+    if (idleSeconds < m_watchdogTimeout) {
+        return;
+    }
+
+    // only report each hang once
+    recordActivity();
+    Logger::log(LogLevel::Warning, LogCategory::Supervisor, QStringLiteral("onedrive has been inactive for %1s").arg(idleSeconds));
+    Q_EMIT hangDetected(idleSeconds);
+
+    if (WatchdogAction::Restart != m_watchdogAction || !m_supervising) {
+        return;
+    }
+
+    // the exit is treated as unexpected so the restart goes through the usual backoff
+    terminateProcess();
+}
+
+
+void ProcessSupervisor::terminateProcess()
+{
+    const auto pid = m_process.processId();
+    m_process.terminate();
+
+    // only the same client is killed, not one started again in the meantime
+    QTimer::singleShot(TerminateGracePeriod, this, [this, pid]() {
+        if (m_process.isRunning() && pid == m_process.processId()) {
+            Logger::log(LogLevel::Warning, LogCategory::Supervisor, QStringLiteral("onedrive did not terminate within %1ms, killing it").arg(TerminateGracePeriod));
+            m_process.kill();
+        }
+    });
+}
+
+
+std::optional<quint64> ProcessSupervisor::readCpuTicks() const
+{
+    QFile stat(QStringLiteral("/proc/%1/stat").arg(m_process.processId()));
+
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    const auto line = stat.readAll();
+
+    // the command name can contain spaces and parentheses, so fields are counted from the last ')'
+    const auto commandEnd = line.lastIndexOf(')');
+
+    if (0 > commandEnd) {
+        return {};
+    }
+
+    // fields[0] is field 3 (state); utime and stime are fields 14 and 15
+    const auto fields = line.mid(commandEnd + 2).split(' ');
+
+    if (13 > fields.size()) {
+        return {};
+    }
+
+    bool utimeOk = false;
+    bool stimeOk = false;
+    const auto utime = fields[11].toULongLong(&utimeOk);
+    const auto stime = fields[12].toULongLong(&stimeOk);
+
+    if (!utimeOk || !stimeOk) {
+        return {};
+    }
+
+    return utime + stime;
+}
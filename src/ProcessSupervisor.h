@@ -0,0 +1,209 @@
+/**
+ * ProcessSupervisor.h
+ *
+ * Declaration of ProcessSupervisor class.
+ */
+
+#ifndef ONEDRIVETRAY_PROCESSSUPERVISOR_H
+#define ONEDRIVETRAY_PROCESSSUPERVISOR_H
+
+#include <optional>
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QVector>
+#include <QtCore/QProcess>
+
+namespace OneDrive
+{
+    class Process;
+
+    /**
+     * Keeps the onedrive client running.
+     *
+     * When the client exits without being asked to it is restarted after an exponentially increasing, jittered delay.
+     * If it exits too often in a short period it is considered to be crash-looping and is left stopped. A watchdog
+     * detects a client that is still running but has produced no output and consumed no CPU time for a configurable
+     * period, and either reports it or restarts it.
+     */
+    class ProcessSupervisor
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** What the watchdog does when it detects a hung client. */
+        enum class WatchdogAction
+        {
+            Notify = 0,
+            Restart,
+        };
+
+        /** The delay before the first automatic restart (ms). */
+        static constexpr const int InitialRestartDelay = 1000;
+
+        /** The upper bound for the delay before an automatic restart (ms). */
+        static constexpr const int MaximumRestartDelay = 5 * 60 * 1000;
+
+        /** The number of unexpected exits within the crash-loop window that cause the supervisor to give up. */
+        static constexpr const int CrashLoopExitCount = 5;
+
+        /** The window within which unexpected exits are counted towards a crash loop (ms). */
+        static constexpr const int CrashLoopWindow = 2 * 60 * 1000;
+
+        /** How long the client must run before the restart backoff is reset (ms). */
+        static constexpr const int StableRunTime = 60 * 1000;
+
+        /** The default period of inactivity after which the watchdog fires (s). */
+        static constexpr const int DefaultWatchdogTimeout = 30 * 60;
+
+        /**
+         * Initialise a new supervisor for a process.
+         *
+         * The process must outlive the supervisor. Its program and arguments must be set before start() is called.
+         *
+         * @param process The process to supervise.
+         * @param parent The owning QObject.
+         */
+        explicit ProcessSupervisor(Process & process, QObject * parent = nullptr);
+
+        ~ProcessSupervisor() override;
+
+        /**
+         * Start the client (if it's not already running) and begin supervising it.
+         *
+         * Any pending restart is cancelled and the backoff and crash-loop counters are reset.
+         */
+        void start();
+
+        /**
+         * Stop supervising the client and ask it to terminate.
+         *
+         * The client is killed if it hasn't terminated after a grace period. It will not be restarted until start() is
+         * called again.
+         */
+        void stop();
+
+        /**
+         * Stop the client and start it again once it has exited, continuing to supervise it.
+         *
+         * The exit doesn't count as unexpected, so it doesn't add to the backoff or the crash-loop count. If the
+         * client isn't running this is the same as start().
+         */
+        void restart();
+
+        /** Whether the supervisor is currently responsible for keeping the client running. */
+        [[nodiscard]] inline bool isSupervising() const
+        {
+            return m_supervising;
+        }
+
+        /** Whether an automatic restart is pending. */
+        [[nodiscard]] inline bool restartPending() const
+        {
+            return m_restartTimer.isActive();
+        }
+
+        [[nodiscard]] inline bool autoRestart() const
+        {
+            return m_autoRestart;
+        }
+
+        /** Set whether the client is restarted automatically when it exits unexpectedly. */
+        void setAutoRestart(bool restart);
+
+        /** The watchdog timeout in seconds. 0 means the watchdog is disabled. */
+        [[nodiscard]] inline int watchdogTimeout() const
+        {
+            return m_watchdogTimeout;
+        }
+
+        /** Set the watchdog timeout in seconds. Use 0 to disable the watchdog. */
+        void setWatchdogTimeout(int seconds);
+
+        [[nodiscard]] inline WatchdogAction watchdogAction() const
+        {
+            return m_watchdogAction;
+        }
+
+        void setWatchdogAction(WatchdogAction action)
+        {
+            m_watchdogAction = action;
+        }
+
+    Q_SIGNALS:
+        /** Emitted when the client has exited unexpectedly and a restart has been scheduled. */
+        void restartScheduled(int attempt, int delay);
+
+        /** Emitted when the client has exited too many times in a short period and will not be restarted. */
+        void crashLoopDetected(int exitCount);
+
+        /** Emitted when the client has produced no output and consumed no CPU time for the watchdog timeout. */
+        void hangDetected(int idleSeconds);
+
+    private:
+        /** Handle the client exiting. */
+        void onProcessFinished();
+
+        /** Handle the client failing to start or crashing. */
+        void onProcessError(QProcess::ProcessError error);
+
+        /** Record an unexpected exit and schedule a restart if appropriate. */
+        void handleUnexpectedExit();
+
+        /** Timer slot to restart the client after the backoff delay. */
+        void restartProcess();
+
+        /** Note that the client has shown signs of life. */
+        void recordActivity();
+
+        /** Periodic check for a hung client. */
+        void checkWatchdog();
+
+        /** Ask the client to terminate, and kill it if it hasn't after a grace period. */
+        void terminateProcess();
+
+        /**
+         * Read the total CPU time (user + system, in clock ticks) consumed by the client.
+         *
+         * @return The tick count, or nothing if it can't be read.
+         */
+        [[nodiscard]] std::optional<quint64> readCpuTicks() const;
+
+        /** Calculate the delay before the next restart attempt. */
+        [[nodiscard]] int nextRestartDelay() const;
+
+        Process & m_process;
+        bool m_supervising;
+        bool m_stopping;
+
+        /** Whether the client is to be started again once the requested stop is complete. */
+        bool m_restarting;
+        bool m_autoRestart;
+        int m_watchdogTimeout;
+        WatchdogAction m_watchdogAction;
+
+        /** The number of consecutive unexpected exits, used to calculate the backoff. */
+        int m_restartAttempt;
+
+        /** Monotonic clock used to timestamp exits. */
+        QElapsedTimer m_clock;
+
+        /** Times (on m_clock) of recent unexpected exits. */
+        QVector<qint64> m_recentExits;
+
+        /** How long the current client has been running. */
+        QElapsedTimer m_uptime;
+
+        /** Time since the client last produced output or consumed CPU time. */
+        QElapsedTimer m_lastActivity;
+
+        /** The CPU time reported at the last watchdog check. */
+        std::optional<quint64> m_lastCpuTicks;
+
+        QTimer m_restartTimer;
+        QTimer m_watchdogTimer;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_PROCESSSUPERVISOR_H
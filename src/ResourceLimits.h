@@ -0,0 +1,92 @@
+/**
+ * ResourceLimits.h
+ *
+ * Declaration of ResourceLimits struct.
+ */
+
+#ifndef ONEDRIVETRAY_RESOURCELIMITS_H
+#define ONEDRIVETRAY_RESOURCELIMITS_H
+
+#include <cstdint>
+#include <string>
+
+namespace OneDrive
+{
+    /** The I/O scheduling classes the onedrive client can be run under (see ionice(1)). */
+    enum class IoPriorityClass
+    {
+        Default = 0,
+        BestEffort,
+        Idle,
+    };
+
+    /** The scheduling and resource limits applied to the onedrive client. */
+    struct ResourceLimits
+    {
+        /** The lowest (most favourable) nice value the client is given. */
+        static constexpr const int MinimumNiceValue = 0;
+
+        /** The highest (least favourable) nice value the client can be given. */
+        static constexpr const int MaximumNiceValue = 19;
+
+        /** The default cgroup CPU weight (cpu.weight). */
+        static constexpr const int DefaultCgroupCpuWeight = 100;
+
+        /** The lowest cgroup CPU weight. */
+        static constexpr const int MinimumCgroupCpuWeight = 1;
+
+        /** The highest (least favourable) best-effort I/O priority level. */
+        static constexpr const int MaximumIoPriorityLevel = 7;
+
+        /** The CPU nice value, 0 to 19. */
+        int niceValue = 0;
+
+        IoPriorityClass ioPriorityClass = IoPriorityClass::Default;
+
+        /** The I/O priority level within the best-effort class, 0 (highest) to 7 (lowest). */
+        int ioPriorityLevel = 4;
+
+        /** The CPUs the client may run on, in cpuset list format (e.g. "0-3,6"). Empty for all CPUs. */
+        std::string cpuAffinity;
+
+        /** Whether to run the client in its own cgroup (v2) so the limits below can be applied. */
+        bool useCgroup = false;
+
+        /** The CPU limit as a percentage of one CPU (cpu.max). 0 for no limit. */
+        int cgroupCpuMax = 0;
+
+        /**
+         * The client's share of the CPU relative to the tray's other cgroups (cpu.weight).
+         *
+         * Not a user setting: it is only lowered while the battery policy deprioritises the client. Unlike the nice
+         * value it can be raised again without privileges.
+         */
+        int cgroupCpuWeight = DefaultCgroupCpuWeight;
+
+        /** The memory usage above which the client is throttled and reclaimed (memory.high), in bytes. 0 for no limit. */
+        uint64_t cgroupMemoryHigh = 0;
+
+        /** Raw io.max content, one "MAJ:MIN key=value ..." line per device. Empty for no limit. */
+        std::string cgroupIoMax;
+
+        [[nodiscard]] bool operator==(const ResourceLimits & other) const
+        {
+            return niceValue == other.niceValue
+                   && ioPriorityClass == other.ioPriorityClass
+                   && ioPriorityLevel == other.ioPriorityLevel
+                   && cpuAffinity == other.cpuAffinity
+                   && useCgroup == other.useCgroup
+                   && cgroupCpuMax == other.cgroupCpuMax
+                   && cgroupCpuWeight == other.cgroupCpuWeight
+                   && cgroupMemoryHigh == other.cgroupMemoryHigh
+                   && cgroupIoMax == other.cgroupIoMax;
+        }
+
+        [[nodiscard]] bool operator!=(const ResourceLimits & other) const
+        {
+            return !(*this == other);
+        }
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_RESOURCELIMITS_H
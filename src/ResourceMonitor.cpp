@@ -0,0 +1,189 @@
+/**
+ * ResourceMonitor.cpp
+ *
+ * Implementation of ResourceMonitor class.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <fcntl.h>
+#include <unistd.h>
+#include <QtCore/QLocale>
+#include "ResourceMonitor.h"
+#include "Process.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /**
+     * Parse the unsigned value that follows a key in a /proc key-value file (e.g. status, io).
+     *
+     * @param buffer The null-terminated file content.
+     * @param key The key, including its leading newline and trailing colon, so that it only matches a whole key.
+     *
+     * @return The value, or nothing if the key isn't present.
+     */
+    std::optional<quint64> procFieldValue(const char * buffer, const char * key)
+    {
+        const char * field = std::strstr(buffer, key);
+
+        if (!field) {
+            return {};
+        }
+
+        return std::strtoull(field + std::strlen(key), nullptr, 10);
+    }
+}
+
+
+ResourceMonitor::ResourceMonitor(const Process & process, QObject * parent)
+        : QObject(parent),
+          m_process(process),
+          m_statFd(-1),
+          m_statusFd(-1),
+          m_ioFd(-1),
+          m_ticksPerSecond(sysconf(_SC_CLK_TCK)),
+          m_usage(),
+          m_sampleClock(),
+          m_timer(),
+          m_buffer()
+{
+    m_timer.setInterval(DefaultInterval);
+    connect(&m_timer, &QTimer::timeout, this, &ResourceMonitor::sample);
+
+    connect(&m_process, &QProcess::started, this, [this]() {
+        openFiles();
+        sample();
+        m_timer.start();
+    });
+
+    connect(&m_process, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, [this]() {
+        m_timer.stop();
+        closeFiles();
+        m_usage = {};
+        Q_EMIT usageUpdated(m_usage);
+    });
+}
+
+
+ResourceMonitor::~ResourceMonitor()
+{
+    closeFiles();
+}
+
+
+QString ResourceMonitor::describe(const ResourceUsage & usage)
+{
+    const auto locale = QLocale::system();
+
+    return tr("CPU %1%, memory %2, %3 threads, read %4, written %5").arg(
+            locale.toString(usage.cpuPercent, 'f', 1),
+            locale.formattedDataSize(static_cast<qint64>(usage.residentBytes), 1, QLocale::DataSizeTraditionalFormat),
+            locale.toString(usage.threadCount),
+            locale.formattedDataSize(static_cast<qint64>(usage.readBytes), 1, QLocale::DataSizeTraditionalFormat),
+            locale.formattedDataSize(static_cast<qint64>(usage.writtenBytes), 1, QLocale::DataSizeTraditionalFormat)
+    );
+}
+
+
+void ResourceMonitor::openFiles()
+{
+    closeFiles();
+    m_usage = {};
+    m_sampleClock.invalidate();
+
+    const auto procDir = QByteArrayLiteral("/proc/") + QByteArray::number(m_process.processId());
+    m_statFd = ::open((procDir + "/stat").constData(), O_RDONLY | O_CLOEXEC);
+    m_statusFd = ::open((procDir + "/status").constData(), O_RDONLY | O_CLOEXEC);
+
+    // not readable under some hardening configurations, in which case I/O is just not reported
+    m_ioFd = ::open((procDir + "/io").constData(), O_RDONLY | O_CLOEXEC);
+}
+
+
+void ResourceMonitor::closeFiles()
+{
+    for (auto * fd : {&m_statFd, &m_statusFd, &m_ioFd}) {
+        if (0 <= *fd) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+
+ssize_t ResourceMonitor::readFile(int fd)
+{
+    if (0 > fd) {
+        return -1;
+    }
+
+    // /proc files regenerate their content when read from offset 0, so the descriptor can be reused
+    const auto bytes = ::pread(fd, m_buffer.data(), m_buffer.size() - 1, 0);
+    m_buffer[0 > bytes ? 0 : bytes] = 0;
+    return bytes;
+}
+
+
+void ResourceMonitor::sample()
+{
+    if (0 >= readFile(m_statFd)) {
+        return;
+    }
+
+    // the command name can contain spaces and parentheses, so fields are counted from the last ')'
+    const char * field = std::strrchr(m_buffer.data(), ')');
+
+    if (!field) {
+        return;
+    }
+
+    // field 3 (state) follows ") "; utime, stime are fields 14 and 15, num_threads is field 20
+    quint64 ticks = 0;
+
+    for (int fieldNumber = 3; fieldNumber <= 20 && *field; ++fieldNumber) {
+        field = std::strchr(field + 1, ' ');
+
+        if (!field) {
+            return;
+        }
+
+        if (14 == fieldNumber || 15 == fieldNumber) {
+            ticks += std::strtoull(field + 1, nullptr, 10);
+        } else if (20 == fieldNumber) {
+            m_usage.threadCount = static_cast<int>(std::strtol(field + 1, nullptr, 10));
+        }
+    }
+
+    if (m_sampleClock.isValid() && 0 < m_ticksPerSecond) {
+        const auto elapsedMs = m_sampleClock.restart();
+
+        if (0 < elapsedMs && ticks >= m_usage.cpuTicks) {
+            m_usage.cpuPercent = 100000.0 * static_cast<double>(ticks - m_usage.cpuTicks) / static_cast<double>(m_ticksPerSecond) / static_cast<double>(elapsedMs);
+        }
+    } else {
+        m_sampleClock.start();
+    }
+
+    m_usage.cpuTicks = ticks;
+
+    if (0 < readFile(m_statusFd)) {
+        if (const auto rss = procFieldValue(m_buffer.data(), "\nVmRSS:"); rss) {
+            m_usage.residentBytes = *rss * 1024;
+        }
+    }
+
+    if (0 < readFile(m_ioFd)) {
+        if (const auto bytes = procFieldValue(m_buffer.data(), "\nread_bytes:"); bytes) {
+            m_usage.readBytes = *bytes;
+        }
+
+        if (const auto bytes = procFieldValue(m_buffer.data(), "\nwrite_bytes:"); bytes) {
+            m_usage.writtenBytes = *bytes;
+        }
+    }
+
+    Q_EMIT usageUpdated(m_usage);
+}
@@ -0,0 +1,125 @@
+/**
+ * ResourceMonitor.h
+ *
+ * Declaration of ResourceMonitor class.
+ */
+
+#ifndef ONEDRIVETRAY_RESOURCEMONITOR_H
+#define ONEDRIVETRAY_RESOURCEMONITOR_H
+
+#include <array>
+#include <sys/types.h>
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+#include <QtCore/QElapsedTimer>
+
+namespace OneDrive
+{
+    class Process;
+
+    /** A sample of the resources used by the onedrive client. */
+    struct ResourceUsage
+    {
+        /** CPU usage since the previous sample, as a percentage of one core. */
+        double cpuPercent = 0.0;
+
+        /** Total CPU time (user + system) consumed, in clock ticks. */
+        quint64 cpuTicks = 0;
+
+        /** Resident set size in bytes. */
+        quint64 residentBytes = 0;
+
+        int threadCount = 0;
+
+        /** Bytes read from storage. */
+        quint64 readBytes = 0;
+
+        /** Bytes written to storage. */
+        quint64 writtenBytes = 0;
+    };
+
+    /**
+     * Periodically samples the resource usage of the onedrive client from /proc.
+     *
+     * The /proc files for the client are opened once when it starts and re-read in place for each sample, into a fixed
+     * buffer, so sampling does not allocate.
+     */
+    class ResourceMonitor
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** The default sampling interval (ms). */
+        static constexpr const int DefaultInterval = 2000;
+
+        explicit ResourceMonitor(const Process & process, QObject * parent = nullptr);
+
+        ~ResourceMonitor() override;
+
+        /** Fetch the most recent sample. */
+        [[nodiscard]] inline const ResourceUsage & usage() const
+        {
+            return m_usage;
+        }
+
+        /** Whether the monitor currently has a sample for a running client. */
+        [[nodiscard]] inline bool hasUsage() const
+        {
+            return 0 <= m_statFd;
+        }
+
+        [[nodiscard]] inline int interval() const
+        {
+            return m_timer.interval();
+        }
+
+        /** Set the sampling interval in ms. */
+        void setInterval(int interval)
+        {
+            m_timer.setInterval(interval);
+        }
+
+        /**
+         * Format a sample for display to the user.
+         *
+         * @param usage The sample.
+         *
+         * @return A single-line, translated description.
+         */
+        [[nodiscard]] static QString describe(const ResourceUsage & usage);
+
+    Q_SIGNALS:
+        /** Emitted when a new sample has been taken. */
+        void usageUpdated(const ResourceUsage & usage);
+
+    private:
+        /** Open the /proc files for the client's current PID. */
+        void openFiles();
+
+        /** Close any open /proc files. */
+        void closeFiles();
+
+        /** Take a sample and emit usageUpdated(). */
+        void sample();
+
+        /**
+         * Re-read a /proc file from the start into the sample buffer.
+         *
+         * @return The number of bytes read, or -1 on error. The buffer is null-terminated.
+         */
+        ssize_t readFile(int fd);
+
+        const Process & m_process;
+        int m_statFd;
+        int m_statusFd;
+        int m_ioFd;
+        long m_ticksPerSecond;
+        ResourceUsage m_usage;
+        QElapsedTimer m_sampleClock;
+        QTimer m_timer;
+        std::array<char, 4096> m_buffer;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_RESOURCEMONITOR_H
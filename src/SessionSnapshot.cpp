@@ -0,0 +1,147 @@
+/**
+ * SessionSnapshot.cpp
+ *
+ * Implementation of SessionSnapshot class.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include "SessionSnapshot.h"
+#include "StatusPagePublisher.h"
+#include "Logger.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    const QString SnapshotFileName = QStringLiteral("/session-snapshot");
+
+    /** Read a NUL-terminated UTF-8 field that may have been truncated without its NUL. */
+    template<std::size_t size>
+    QString fieldText(const char (& field)[size])
+    {
+        return QString::fromUtf8(field, static_cast<int>(::strnlen(field, size)));
+    }
+}
+
+
+SessionSnapshot::SessionSnapshot(QString path)
+        : m_path(std::move(path))
+{
+}
+
+
+QString SessionSnapshot::defaultPath(const QString & instanceKey)
+{
+    const auto path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + SnapshotFileName;
+    return instanceKey.isEmpty() ? path : path + QLatin1Char('-') + instanceKey;
+}
+
+
+std::optional<SessionSnapshot::Session> SessionSnapshot::load() const
+{
+    const auto fileName = QFile::encodeName(m_path);
+    const auto fd = ::open(fileName.constData(), O_RDONLY | O_CLOEXEC);
+
+    if (0 > fd) {
+        if (ENOENT != errno) {
+            Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to open session snapshot %1: %2").arg(m_path, QString::fromLocal8Bit(std::strerror(errno))));
+        }
+
+        return {};
+    }
+
+    struct stat info = {};
+
+    // a file of any other size was written by another version, or truncated
+    if (0 != ::fstat(fd, &info) || sizeof(Layout) != static_cast<std::size_t>(info.st_size)) {
+        ::close(fd);
+        return {};
+    }
+
+    const auto * address = ::mmap(nullptr, sizeof(Layout), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (MAP_FAILED == address) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to map session snapshot %1: %2").arg(m_path, QString::fromLocal8Bit(std::strerror(errno))));
+        return {};
+    }
+
+    const auto * snapshot = static_cast<const Layout *>(address);
+    std::optional<Session> session;
+
+    if (Magic == snapshot->magic && Version == snapshot->version && static_cast<std::uint32_t>(EventCapacity) >= snapshot->eventCount) {
+        session.emplace();
+        std::memcpy(&session->status, &snapshot->status, sizeof(StatusPage::Status));
+        session->status.currentFile[StatusPage::TextSize - 1] = '\0';
+        session->status.status[StatusPage::TextSize - 1] = '\0';
+        session->events.reserve(static_cast<int>(snapshot->eventCount));
+
+        for (std::uint32_t index = 0; index < snapshot->eventCount; ++index) {
+            const auto & event = snapshot->events[index];
+
+            if (static_cast<std::uint32_t>(EventBus::EventTypeCount) <= event.type) {
+                continue;
+            }
+
+            session->events.append({
+                    event.time,
+                    0,
+                    static_cast<EventBus::EventType>(event.type),
+                    fieldText(event.path),
+                    fieldText(event.detail),
+                    event.size,
+            });
+        }
+    }
+
+    ::munmap(const_cast<void *>(address), sizeof(Layout));
+    return session;
+}
+
+
+bool SessionSnapshot::save(const StatusPage::Status & status, const QVector<EventBus::Event> & events) const
+{
+    // too big for the stack, and value-initialised so that the padding and unused events are zero
+    auto snapshot = std::make_unique<Layout>();
+    snapshot->magic = Magic;
+    snapshot->version = Version;
+    snapshot->status = status;
+
+    const auto first = std::max(0, events.size() - EventCapacity);
+
+    for (auto index = first; index < events.size(); ++index) {
+        const auto & event = events.at(index);
+        auto & record = snapshot->events[snapshot->eventCount];
+        record.time = event.time;
+        record.size = event.size;
+        record.type = static_cast<std::uint32_t>(event.type);
+        StatusPagePublisher::copyText(record.path, event.path);
+        StatusPagePublisher::copyText(record.detail, event.detail);
+        ++snapshot->eventCount;
+    }
+
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    QSaveFile file(m_path);
+
+    if (!file.open(QIODevice::WriteOnly)
+        || static_cast<qint64>(sizeof(Layout)) != file.write(reinterpret_cast<const char *>(snapshot.get()), sizeof(Layout))
+        || !file.commit()) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to save session snapshot %1: %2").arg(m_path, file.errorString()));
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,119 @@
+/**
+ * SessionSnapshot.h
+ *
+ * Declaration of SessionSnapshot class.
+ */
+
+#ifndef ONEDRIVETRAY_SESSIONSNAPSHOT_H
+#define ONEDRIVETRAY_SESSIONSNAPSHOT_H
+
+#include <cstdint>
+#include <optional>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include "EventBus.h"
+#include "StatusPageLayout.h"
+
+namespace OneDrive
+{
+    /**
+     * Keeps the status of the last session on disk, so that it can be shown at startup before the client reports.
+     *
+     * The snapshot is a fixed-size binary file: the status, laid out as in the shared-memory status page, followed by
+     * the most recent events. It is replaced atomically when it is saved, and mapped rather than parsed when it is
+     * loaded. It is only ever read by the instance of the program that wrote it or a later one for the same user, so
+     * it isn't portable between machines.
+     */
+    class SessionSnapshot
+    {
+    public:
+        /** Identifies the file as a snapshot ("ODSS"). */
+        static constexpr const std::uint32_t Magic = 0x5353444fu;
+
+        /** Incremented when the layout changes. A snapshot with a different version is ignored. */
+        static constexpr const std::uint32_t Version = 2;
+
+        /** The number of events kept. */
+        static constexpr const int EventCapacity = 50;
+
+        /** The size of an event's path fields, including the terminating NUL. */
+        static constexpr const std::size_t PathSize = 256;
+
+        struct Event
+        {
+            /** When the event happened, in ms since the epoch. */
+            std::int64_t time;
+
+            /** The free space, for FreeSpaceUpdated. */
+            std::uint64_t size;
+
+            std::uint32_t type;
+            std::uint32_t reserved;
+            char path[PathSize];
+            char detail[PathSize];
+        };
+
+        struct Layout
+        {
+            std::uint32_t magic;
+            std::uint32_t version;
+            std::uint32_t eventCount;
+            std::uint32_t reserved;
+            StatusPage::Status status;
+
+            /** The events, oldest first. */
+            Event events[EventCapacity];
+        };
+
+        /** A snapshot read back from disk. */
+        struct Session
+        {
+            /** The status when the snapshot was saved. status.updated is when that was. */
+            StatusPage::Status status;
+
+            /** The most recent events, oldest first. They have no monotonic time. */
+            QVector<EventBus::Event> events;
+        };
+
+        explicit SessionSnapshot(QString path);
+
+        /**
+         * The snapshot file in the user's cache directory.
+         *
+         * @param instanceKey The key of the instance, from ControlProtocol::instanceKey(), so that instances for
+         * different config directories keep separate snapshots.
+         */
+        [[nodiscard]] static QString defaultPath(const QString & instanceKey = {});
+
+        [[nodiscard]] inline const QString & path() const
+        {
+            return m_path;
+        }
+
+        inline void setPath(const QString & path)
+        {
+            m_path = path;
+        }
+
+        /**
+         * Read the snapshot.
+         *
+         * @return The session, or nullopt if there is no snapshot or it isn't one this version understands.
+         */
+        [[nodiscard]] std::optional<Session> load() const;
+
+        /**
+         * Write the snapshot, replacing the previous one atomically.
+         *
+         * Only the last EventCapacity events are kept. Failure is logged.
+         *
+         * @param events The events, oldest first.
+         */
+        bool save(const StatusPage::Status & status, const QVector<EventBus::Event> & events) const;
+
+    private:
+        QString m_path;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_SESSIONSNAPSHOT_H
@@ -6,6 +6,9 @@
 #define ONEDRIVETRAY_SETTINGS_H
 
 #include "IconStyle.h"
+#include "BatteryPolicy.h"
+#include "ResourceLimits.h"
+#include <optional>
 #include <string>
 
 namespace OneDrive
@@ -77,6 +80,115 @@ namespace OneDrive
             m_socketPath = std::move(path);
         }
 
+        [[nodiscard]] bool autoRestart() const
+        {
+            return m_autoRestart;
+        }
+
+        void setAutoRestart(bool restart)
+        {
+            m_autoRestart = restart;
+        }
+
+        [[nodiscard]] int watchdogTimeout() const
+        {
+            return m_watchdogTimeout;
+        }
+
+        void setWatchdogTimeout(int seconds)
+        {
+            m_watchdogTimeout = seconds;
+        }
+
+        [[nodiscard]] bool watchdogRestarts() const
+        {
+            return m_watchdogRestarts;
+        }
+
+        void setWatchdogRestarts(bool restart)
+        {
+            m_watchdogRestarts = restart;
+        }
+
+        [[nodiscard]] const ResourceLimits & resourceLimits() const
+        {
+            return m_resourceLimits;
+        }
+
+        void setResourceLimits(const ResourceLimits & limits)
+        {
+            m_resourceLimits = limits;
+        }
+
+        [[nodiscard]] BatteryPolicy batteryPolicy() const
+        {
+            return m_batteryPolicy;
+        }
+
+        void setBatteryPolicy(BatteryPolicy policy)
+        {
+            m_batteryPolicy = policy;
+        }
+
+        /** The battery charge level (%) at or below which the battery policy applies. */
+        [[nodiscard]] int batteryThreshold() const
+        {
+            return m_batteryThreshold;
+        }
+
+        void setBatteryThreshold(int percent)
+        {
+            m_batteryThreshold = percent;
+        }
+
+        /** Whether to show (aggregated) notifications of uploads, downloads and deletions. */
+        [[nodiscard]] bool notifyTransfers() const
+        {
+            return m_notifyTransfers;
+        }
+
+        void setNotifyTransfers(bool notify)
+        {
+            m_notifyTransfers = notify;
+        }
+
+        /** Whether to adapt the onedrive client's check interval to how often things change. */
+        [[nodiscard]] bool adaptiveMonitorInterval() const
+        {
+            return m_adaptiveMonitorInterval;
+        }
+
+        void setAdaptiveMonitorInterval(bool adapt)
+        {
+            m_adaptiveMonitorInterval = adapt;
+        }
+
+        /**
+         * The onedrive client's monitor_interval to restore when the check interval stops being adapted.
+         *
+         * This is the user's own setting, or nullopt for the client's default.
+         */
+        [[nodiscard]] const std::optional<int> & userMonitorInterval() const
+        {
+            return m_userMonitorInterval;
+        }
+
+        void setUserMonitorInterval(const std::optional<int> & interval)
+        {
+            m_userMonitorInterval = interval;
+        }
+
+        /** The onedrive client's monitor_fullscan_frequency to restore, as for userMonitorInterval(). */
+        [[nodiscard]] const std::optional<int> & userMonitorFullscanFrequency() const
+        {
+            return m_userMonitorFullscanFrequency;
+        }
+
+        void setUserMonitorFullscanFrequency(const std::optional<int> & frequency)
+        {
+            m_userMonitorFullscanFrequency = frequency;
+        }
+
     private:
         IconStyle m_iconStyle;
         bool m_startOwnOneDrive;
@@ -84,6 +196,16 @@ namespace OneDrive
         std::string m_oneDrivePath;
         bool m_useCustomSocket;
         std::string m_socketPath;
+        bool m_autoRestart;
+        int m_watchdogTimeout;
+        bool m_watchdogRestarts;
+        ResourceLimits m_resourceLimits;
+        BatteryPolicy m_batteryPolicy;
+        int m_batteryThreshold;
+        bool m_notifyTransfers;
+        bool m_adaptiveMonitorInterval;
+        std::optional<int> m_userMonitorInterval;
+        std::optional<int> m_userMonitorFullscanFrequency;
     };
 
 } // OneDrive
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "SettingsWidget.h"
 #include "ui/ui_settingswidget.h"
 #include "Settings.h"
@@ -6,7 +7,8 @@ using namespace OneDrive;
 
 SettingsWidget::SettingsWidget(const Settings & settings, QWidget *parent) :
     QWidget(parent),
-    m_ui(std::make_unique<Ui::SettingsWidget>())
+    m_ui(std::make_unique<Ui::SettingsWidget>()),
+    m_performanceSettings()
 {
     m_ui->setupUi(this);
     connectComponents();
@@ -22,6 +24,7 @@ SettingsWidget::SettingsWidget(const Settings & settings, QWidget *parent) :
     m_ui->useCustomSocket->setChecked(settings.useCustomSocket());
     m_ui->customSocketPath->setText(QString::fromStdString(settings.customSocketPath()));
     synchroniseWidgetStates();
+    validatePerformanceSettings();
 }
 
 
@@ -88,6 +91,82 @@ void SettingsWidget::setCustomSocketPath(const QString & path)
 }
 
 
+PerformanceSettings SettingsWidget::performanceSettings() const
+{
+    // each spin box's minimum, shown as "Default", leaves the setting out of the config file
+    PerformanceSettings settings;
+
+    if (0 < m_ui->threads->value()) {
+        settings.threads = m_ui->threads->value();
+    }
+
+    if (0 <= m_ui->rateLimit->value()) {
+        settings.rateLimit = static_cast<quint64>(m_ui->rateLimit->value()) * 1024;
+    }
+
+    if (0 < m_ui->monitorInterval->value()) {
+        settings.monitorInterval = m_ui->monitorInterval->value();
+    }
+
+    if (0 <= m_ui->monitorFullscanFrequency->value()) {
+        settings.monitorFullscanFrequency = m_ui->monitorFullscanFrequency->value();
+    }
+
+    if (0 < m_ui->classifyAsBigDelete->value()) {
+        settings.classifyAsBigDelete = m_ui->classifyAsBigDelete->value();
+    }
+
+    switch (m_ui->skipDotfiles->currentIndex()) {
+        case 1:
+            settings.skipDotfiles = true;
+            break;
+
+        case 2:
+            settings.skipDotfiles = false;
+            break;
+    }
+
+    return settings;
+}
+
+
+void SettingsWidget::setPerformanceSettings(const PerformanceSettings & settings)
+{
+    m_performanceSettings = settings;
+    m_ui->threads->setValue(settings.threads.value_or(m_ui->threads->minimum()));
+    m_ui->rateLimit->setValue(settings.rateLimit ? static_cast<int>(std::min<quint64>(*settings.rateLimit / 1024, m_ui->rateLimit->maximum())) : m_ui->rateLimit->minimum());
+    m_ui->monitorInterval->setValue(settings.monitorInterval.value_or(m_ui->monitorInterval->minimum()));
+    m_ui->monitorFullscanFrequency->setValue(settings.monitorFullscanFrequency.value_or(m_ui->monitorFullscanFrequency->minimum()));
+    m_ui->classifyAsBigDelete->setValue(settings.classifyAsBigDelete.value_or(m_ui->classifyAsBigDelete->minimum()));
+    m_ui->skipDotfiles->setCurrentIndex(settings.skipDotfiles ? (*settings.skipDotfiles ? 1 : 2) : 0);
+    validatePerformanceSettings();
+}
+
+
+void SettingsWidget::validatePerformanceSettings()
+{
+    const auto settings = performanceSettings();
+    const auto problems = OneDriveConfig::validate(settings);
+    m_ui->performanceProblems->setText(problems.join(QLatin1Char('\n')));
+    m_ui->performanceProblems->setVisible(!problems.isEmpty());
+    m_ui->applyPerformanceSettings->setEnabled(problems.isEmpty() && settings != m_performanceSettings);
+}
+
+
+void SettingsWidget::applyPerformanceSettings()
+{
+    const auto settings = performanceSettings();
+
+    if (!OneDriveConfig::validate(settings).isEmpty()) {
+        return;
+    }
+
+    m_performanceSettings = settings;
+    validatePerformanceSettings();
+    Q_EMIT performanceSettingsApplied(settings);
+}
+
+
 void SettingsWidget::connectComponents()
 {
     connect(m_ui->startOwnOneDrive, &QRadioButton::toggled, this, &SettingsWidget::synchroniseWidgetStates);
@@ -99,6 +178,13 @@ void SettingsWidget::connectComponents()
     connect(m_ui->useCustomSocket, &QCheckBox::toggled, this, &SettingsWidget::changed);
     connect(m_ui->customOneDrivePath, &QLineEdit::textChanged, this, &SettingsWidget::changed);
     connect(m_ui->customSocketPath, &QLineEdit::textChanged, this, &SettingsWidget::changed);
+
+    for (auto * spinBox : {m_ui->threads, m_ui->rateLimit, m_ui->monitorInterval, m_ui->monitorFullscanFrequency, m_ui->classifyAsBigDelete}) {
+        connect(spinBox, qOverload<int>(&QSpinBox::valueChanged), this, &SettingsWidget::validatePerformanceSettings);
+    }
+
+    connect(m_ui->skipDotfiles, qOverload<int>(&QComboBox::currentIndexChanged), this, &SettingsWidget::validatePerformanceSettings);
+    connect(m_ui->applyPerformanceSettings, &QPushButton::clicked, this, &SettingsWidget::applyPerformanceSettings);
 }
 
 
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <QtWidgets/QWidget>
+#include "OneDriveConfig.h"
 
 namespace Ui
 {
@@ -38,16 +39,30 @@ namespace OneDrive
         [[nodiscard]] QString customSocketPath() const;
         void setCustomSocketPath(const QString & socketFile);
 
+        /** The performance settings as edited. */
+        [[nodiscard]] PerformanceSettings performanceSettings() const;
+
+        /** Show the performance settings from the onedrive config file, replacing any edits. */
+        void setPerformanceSettings(const PerformanceSettings & settings);
+
     Q_SIGNALS:
         void changed() const;
 
+        /** Emitted when the user applies valid, changed performance settings. */
+        void performanceSettingsApplied(const PerformanceSettings & settings) const;
+
     protected:
         void synchroniseWidgetStates();
 
     private:
         void connectComponents();
+        void validatePerformanceSettings();
+        void applyPerformanceSettings();
 
         std::unique_ptr<Ui::SettingsWidget> m_ui;
+
+        /** The performance settings last set or applied, to tell whether they've been edited. */
+        PerformanceSettings m_performanceSettings;
     };
 }
 
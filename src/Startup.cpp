@@ -0,0 +1,187 @@
+/**
+ * Startup.cpp
+ *
+ * Implementation of helpers shared by the tray and headless applications at startup.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QLatin1String>
+#include <QtCore/QLibraryInfo>
+#include <QtCore/QLocale>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QTranslator>
+#include "Startup.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    const QStringList FixedOneDriveArguments = {"--verbose", "--monitor"};
+    const QString LogFileName = QStringLiteral("/onedrive-tray.log");
+
+    /** The values accepted by --log-level. */
+    const QStringList LogLevelNames = {QStringLiteral("debug"), QStringLiteral("info"), QStringLiteral("warning"), QStringLiteral("error")};
+}
+
+
+bool OneDrive::isHeadlessRequested(int argc, char ** argv)
+{
+    for (int index = 1; index < argc; ++index) {
+        if (0 == std::strcmp(argv[index], "--")) {
+            break;
+        }
+
+        if (0 == std::strcmp(argv[index], "--headless")) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void OneDrive::setApplicationDetails()
+{
+    QCoreApplication::setOrganizationDomain(QLatin1String("dev.equit"));
+    QCoreApplication::setOrganizationName(QLatin1String("Équit"));
+    QCoreApplication::setApplicationVersion(QLatin1String("3.0"));
+}
+
+
+CommandLineOptions OneDrive::parseCommandLine(const QCoreApplication & app, const QString & description)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(description);
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    parser.addOption(QCommandLineOption(
+            {"p" , "onedrive-path"},
+            "Path to the OneDrive program.",
+            "path"
+    ));
+
+    parser.addOption(QCommandLineOption(
+            {"a", "onedrive-args"},
+            "Custom arguments to pass to the onedrive client. The arguments --verbose and --monitor are always passed",
+            "args"
+    ));
+
+    parser.addOption(QCommandLineOption(
+            {"s", "silent-fail"},
+            QCoreApplication::translate("Startup", "Silently quit if no system tray is available rather than showing a notification first.")
+    ));
+
+    parser.addOption(QCommandLineOption(
+            {"d", "debug"},
+            QCoreApplication::translate("Startup", "Output more information to stdout while running.")
+    ));
+
+    parser.addOption(QCommandLineOption(
+            {"l", "log-level"},
+            QCoreApplication::translate("Startup", "The least severe messages to write to the log file: debug, info, warning or error. Defaults to debug with --debug, info otherwise."),
+            "level"
+    ));
+
+    parser.addOption(QCommandLineOption(
+            QStringLiteral("headless"),
+            QCoreApplication::translate("Startup", "Run the onedrive client without the tray icon or a connection to the display.")
+    ));
+
+    parser.addOption(QCommandLineOption(
+            InstanceLock::intentName(InstanceLock::Intent::ShowMessages),
+            QCoreApplication::translate("Startup", "Show the synchronisation messages window.")
+    ));
+
+    parser.addOption(QCommandLineOption(
+            InstanceLock::intentName(InstanceLock::Intent::Pause),
+            QCoreApplication::translate("Startup", "Pause synchronisation.")
+    ));
+
+    parser.addOption(QCommandLineOption(
+            InstanceLock::intentName(InstanceLock::Intent::OpenFolder),
+            QCoreApplication::translate("Startup", "Open the local OneDrive folder.")
+    ));
+
+    parser.process(app);
+
+    CommandLineOptions options;
+    options.oneDrivePath = parser.value(QLatin1String("p"));
+    options.oneDriveArguments = FixedOneDriveArguments;
+
+    if (const auto args = parser.value(QLatin1String("a")); !args.isEmpty()) {
+        options.oneDriveArguments.append(args.split(QRegularExpression(QLatin1String(" +")), Qt::SplitBehaviorFlags::SkipEmptyParts));
+    }
+
+    options.silentFail = parser.isSet(QLatin1String("silent-fail"));
+    options.headless = parser.isSet(QLatin1String("headless"));
+
+    for (const auto intent : {InstanceLock::Intent::ShowMessages, InstanceLock::Intent::Pause, InstanceLock::Intent::OpenFolder}) {
+        if (parser.isSet(InstanceLock::intentName(intent))) {
+            options.intents.append(intent);
+        }
+    }
+
+#if defined(NDEBUG)
+    options.debug = parser.isSet(QLatin1String("debug"));
+#else
+    options.debug = true;
+#endif
+
+    options.logLevel = options.debug ? LogLevel::Debug : LogLevel::Info;
+
+    if (const auto levelName = parser.value(QLatin1String("log-level")).toLower(); !levelName.isEmpty()) {
+        if (const auto index = LogLevelNames.indexOf(levelName); 0 <= index) {
+            options.logLevel = static_cast<LogLevel>(index);
+        } else {
+            std::cerr << "unexpected log level " << qPrintable(levelName) << " - defaulting to '" << Logger::levelName(options.logLevel) << "'\n";
+        }
+    }
+
+    return options;
+}
+
+
+void OneDrive::installTranslators(QTranslator & qtTranslator, QTranslator & appTranslator)
+{
+    if (qtTranslator.load("qt_" + QLocale::system().name(), QLibraryInfo::location(QLibraryInfo::TranslationsPath))) {
+        QCoreApplication::installTranslator(&qtTranslator);
+    }
+
+    // Loads path + filename + prefix + ui language name + suffix (".qm" if the suffix is not specified)
+    if (appTranslator.load(QLocale(), QCoreApplication::applicationName(), "_", QCoreApplication::applicationDirPath())) {
+        QCoreApplication::installTranslator(&appTranslator);
+    } else {
+        std::cerr <<
+            "Translation not found for " <<
+            qPrintable(QLocale::languageToString(QLocale::system().language())) <<
+            " language (" <<
+            qPrintable(std::reduce(
+                    QLocale::system().uiLanguages().cbegin(),
+                    QLocale::system().uiLanguages().cend(),
+                    QString(),
+                    [](QString init, const QString & isoLanguage) -> QString {
+                        if (!init.isNull()) {
+                            init += ", ";
+                        }
+
+                        init += isoLanguage;
+                        return init;
+                    }
+            ))
+            << ")\n";
+    }
+}
+
+
+void OneDrive::startLogging(const CommandLineOptions & options)
+{
+    Logger::setMinimumLevel(options.logLevel);
+    Logger::setEchoToStderr(options.debug);
+    Logger::start(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + LogFileName);
+}
@@ -0,0 +1,73 @@
+/**
+ * Startup.h
+ *
+ * Declaration of helpers shared by the tray and headless applications at startup.
+ */
+
+#ifndef ONEDRIVETRAY_STARTUP_H
+#define ONEDRIVETRAY_STARTUP_H
+
+#include <QtCore/QString>
+#include <QtCore/QList>
+#include <QtCore/QStringList>
+#include "InstanceLock.h"
+#include "Logger.h"
+
+QT_BEGIN_NAMESPACE
+class QCoreApplication;
+class QTranslator;
+QT_END_NAMESPACE
+
+namespace OneDrive
+{
+    /** The options read from the command line. */
+    struct CommandLineOptions
+    {
+        /** The path to the onedrive client. */
+        QString oneDrivePath;
+
+        /** The arguments for the onedrive client, including those that are always passed. */
+        QStringList oneDriveArguments;
+
+        /** Quit without a notification if no system tray is available. */
+        bool silentFail = false;
+
+        /** Output more information while running. */
+        bool debug = false;
+
+        /** The least severe messages to write to the log file. */
+        LogLevel logLevel = LogLevel::Info;
+
+        /** Run without the tray icon or any other widgets. */
+        bool headless = false;
+
+        /** What to do once running. These are forwarded to the running instance if there is one. */
+        QList<InstanceLock::Intent> intents;
+    };
+
+    /**
+     * Check whether --headless is on the command line.
+     *
+     * This must be known before the application object is created so that a QCoreApplication can be used instead of a
+     * QApplication, which would connect to the display server.
+     */
+    bool isHeadlessRequested(int argc, char ** argv);
+
+    /** Set the organisation and version details used for the settings and --version. */
+    void setApplicationDetails();
+
+    /**
+     * Read the command line.
+     *
+     * Exits the application if --help or --version is given, or the command line is invalid.
+     */
+    CommandLineOptions parseCommandLine(const QCoreApplication & app, const QString & description);
+
+    /** Load and install the translators for Qt's strings and the application's strings. */
+    void installTranslators(QTranslator & qtTranslator, QTranslator & appTranslator);
+
+    /** Start writing the log file, using the log options from the command line. */
+    void startLogging(const CommandLineOptions & options);
+}
+
+#endif //ONEDRIVETRAY_STARTUP_H
@@ -0,0 +1,151 @@
+/**
+ * StatusPageLayout.h
+ *
+ * The layout of the shared-memory status page, for the tray and for readers.
+ *
+ * This header doesn't use Qt so that status-bar widgets and other readers can include it without depending on Qt.
+ *
+ * The tray publishes its status in the POSIX shared-memory object named by statusPageName(). Readers open it
+ * read-only, map it, and take snapshots with readStatusPage(). Reading takes no system calls and never wakes the tray.
+ * The page is protected by a seqlock: the tray makes the sequence odd while it writes and even again when it has
+ * finished, and a reader retries if the sequence was odd or changed while it copied the page.
+ */
+
+#ifndef ONEDRIVETRAY_STATUSPAGELAYOUT_H
+#define ONEDRIVETRAY_STATUSPAGELAYOUT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+namespace OneDrive::StatusPage
+{
+    /** Identifies the object as a status page ("ODTS"). */
+    constexpr const std::uint32_t Magic = 0x5354444fu;
+
+    /** Incremented when the layout changes incompatibly. */
+    constexpr const std::uint32_t Version = 2;
+
+    /** The size of the text fields, including the terminating NUL. */
+    constexpr const std::size_t TextSize = 512;
+
+    /** The synchronisation states, as stored in Status::state. */
+    enum State : std::uint32_t
+    {
+        Stopped = 0,
+        Idle,
+        Starting,
+        ScanningLocal,
+        FetchingRemote,
+        Transferring,
+        Error,
+    };
+
+    /** Values for Status::flags. */
+    enum Flag : std::uint32_t
+    {
+        Running = 1u << 0,
+        Paused = 1u << 1,
+    };
+
+    /** The fields of the page, apart from the sequence. */
+    struct Status
+    {
+        std::uint32_t state;
+        std::uint32_t flags;
+
+        /** The free space in the OneDrive account in bytes, or -1 if the client hasn't reported it. */
+        std::int64_t freeSpace;
+
+        std::uint64_t uploaded;
+        std::uint64_t downloaded;
+        std::uint64_t deleted;
+        std::uint64_t errors;
+
+        /** The client's CPU usage over the last sample, as a percentage of one core. 0 while it isn't running. */
+        double cpuPercent;
+
+        /** The client's resident set size in bytes. */
+        std::uint64_t residentBytes;
+
+        /** The bytes the client has read from and written to storage. */
+        std::uint64_t readBytes;
+        std::uint64_t writtenBytes;
+
+        std::uint32_t threads;
+        std::uint32_t reserved;
+
+        /** When the page was last written, in ms since the epoch. */
+        std::int64_t updated;
+
+        /** The file most recently transferred, relative to the sync directory, in UTF-8. Empty when idle. */
+        char currentFile[TextSize];
+
+        /** A one-line, translated description of what the client is doing, in UTF-8. */
+        char status[TextSize];
+    };
+
+    struct Layout
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+
+        /** Odd while the tray is writing the status. */
+        std::atomic<std::uint32_t> sequence;
+
+        std::uint32_t reserved;
+        Status status;
+    };
+
+    static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "the sequence must be lock-free to be shared between processes");
+
+    /**
+     * The name of the shared-memory object, for shm_open().
+     *
+     * @param instanceKey The key of the instance, from ControlProtocol::instanceKey(). The instance for the onedrive
+     * client's default config directory has an empty key.
+     */
+    inline std::string statusPageName(const std::string & instanceKey = {})
+    {
+        return "/onedrive-tray-" + std::to_string(::getuid()) + (instanceKey.empty() ? std::string() : "-" + instanceKey);
+    }
+
+    /**
+     * Take a consistent copy of the status.
+     *
+     * @param page The mapped page.
+     * @param status Receives the copy.
+     * @param attempts How many times to try if the tray is writing.
+     *
+     * @return false if the page isn't a status page this reader understands, or no consistent copy could be taken.
+     */
+    inline bool readStatusPage(const Layout * page, Status & status, int attempts = 100)
+    {
+        if (Magic != page->magic || Version != page->version) {
+            return false;
+        }
+
+        for (; 0 < attempts; --attempts) {
+            const auto before = page->sequence.load(std::memory_order_acquire);
+
+            if (before & 1u) {
+                continue;
+            }
+
+            std::memcpy(&status, &page->status, sizeof(Status));
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (before == page->sequence.load(std::memory_order_relaxed)) {
+                status.currentFile[TextSize - 1] = '\0';
+                status.status[TextSize - 1] = '\0';
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+#endif //ONEDRIVETRAY_STATUSPAGELAYOUT_H
@@ -0,0 +1,94 @@
+/**
+ * StatusPagePublisher.cpp
+ *
+ * Implementation of StatusPagePublisher class.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <QtCore/QString>
+#include "StatusPagePublisher.h"
+#include "Logger.h"
+
+using namespace OneDrive;
+
+
+StatusPagePublisher::StatusPagePublisher()
+        : m_name(),
+          m_page(nullptr)
+{
+}
+
+
+StatusPagePublisher::~StatusPagePublisher()
+{
+    close();
+}
+
+
+bool StatusPagePublisher::open(const std::string & name)
+{
+    if (m_page) {
+        return true;
+    }
+
+    const auto fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+    if (0 > fd) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to open status page %1: %2").arg(QString::fromStdString(name), QString::fromLocal8Bit(std::strerror(errno))));
+        return false;
+    }
+
+    // the page is zeroed when it is sized, so a reader never sees the previous instance's status
+    if (0 != ::ftruncate(fd, 0) || 0 != ::ftruncate(fd, sizeof(StatusPage::Layout))) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to size status page %1: %2").arg(QString::fromStdString(name), QString::fromLocal8Bit(std::strerror(errno))));
+        ::close(fd);
+        return false;
+    }
+
+    auto * address = ::mmap(nullptr, sizeof(StatusPage::Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (MAP_FAILED == address) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("failed to map status page %1: %2").arg(QString::fromStdString(name), QString::fromLocal8Bit(std::strerror(errno))));
+        ::shm_unlink(name.c_str());
+        return false;
+    }
+
+    m_name = name;
+    m_page = new (address) StatusPage::Layout{};
+    m_page->version = StatusPage::Version;
+    m_page->magic = StatusPage::Magic;
+    return true;
+}
+
+
+void StatusPagePublisher::close()
+{
+    if (!m_page) {
+        return;
+    }
+
+    ::munmap(m_page, sizeof(StatusPage::Layout));
+    ::shm_unlink(m_name.c_str());
+    m_page = nullptr;
+}
+
+
+void StatusPagePublisher::publish(const StatusPage::Status & status)
+{
+    if (!m_page) {
+        return;
+    }
+
+    // there is only one writer, so the sequence doesn't need a read-modify-write
+    const auto sequence = m_page->sequence.load(std::memory_order_relaxed);
+    m_page->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&m_page->status, &status, sizeof(StatusPage::Status));
+    m_page->sequence.store(sequence + 2, std::memory_order_release);
+}
@@ -0,0 +1,96 @@
+/**
+ * StatusPagePublisher.h
+ *
+ * Declaration of StatusPagePublisher class.
+ */
+
+#ifndef ONEDRIVETRAY_STATUSPAGEPUBLISHER_H
+#define ONEDRIVETRAY_STATUSPAGEPUBLISHER_H
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include "StatusPageLayout.h"
+
+namespace OneDrive
+{
+    /**
+     * Publishes the status in a POSIX shared-memory page for readers that poll it, such as status-bar widgets.
+     *
+     * The page is laid out as described in StatusPageLayout.h. Publishing writes the page in place and makes no system
+     * calls, so it is cheap enough to do on every status change. The page is removed when the publisher is closed or
+     * destroyed.
+     */
+    class StatusPagePublisher
+    {
+    public:
+        StatusPagePublisher();
+        StatusPagePublisher(const StatusPagePublisher &) = delete;
+        StatusPagePublisher(StatusPagePublisher &&) = delete;
+        void operator=(const StatusPagePublisher &) = delete;
+        void operator=(StatusPagePublisher &&) = delete;
+
+        /** Destructor. Removes the page. */
+        ~StatusPagePublisher();
+
+        /** Whether the page is open. */
+        [[nodiscard]] inline bool isOpen() const
+        {
+            return nullptr != m_page;
+        }
+
+        /**
+         * Create the page, replacing any left behind by a previous instance.
+         *
+         * The page is readable only by the user. Failure is logged.
+         *
+         * @param name The name of the shared-memory object, from StatusPage::statusPageName().
+         *
+         * @return true if the page is open.
+         */
+        bool open(const std::string & name);
+
+        /** Remove the page. Readers that have it mapped keep the last status published. */
+        void close();
+
+        /**
+         * Write a new status to the page.
+         *
+         * Does nothing if the page isn't open.
+         */
+        void publish(const StatusPage::Status & status);
+
+        /**
+         * Copy text into a fixed-size, NUL-terminated UTF-8 field of the status page.
+         *
+         * Text that doesn't fit is truncated at a character boundary.
+         */
+        template<std::size_t size>
+        static void copyText(char (& field)[size], const QString & text)
+        {
+            const auto utf8 = text.toUtf8();
+            auto length = std::min<std::size_t>(static_cast<std::size_t>(utf8.size()), size - 1);
+
+            if (length < static_cast<std::size_t>(utf8.size())) {
+                // don't leave half a multi-byte sequence at the end
+                while (0 < length && 0x80 == (static_cast<unsigned char>(utf8[static_cast<int>(length)]) & 0xc0)) {
+                    --length;
+                }
+            }
+
+            std::memcpy(field, utf8.constData(), length);
+            field[length] = '\0';
+        }
+
+    private:
+        /** The name of the open page. */
+        std::string m_name;
+
+        /** The mapped page, or nullptr if it isn't open. */
+        StatusPage::Layout * m_page;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_STATUSPAGEPUBLISHER_H
@@ -0,0 +1,568 @@
+/**
+ * SyncDirectoryScanner.cpp
+ *
+ * Implementation of SyncDirectoryScanner class.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QQueue>
+#include <QtCore/QStringList>
+#include "SyncDirectoryScanner.h"
+#include "EventBus.h"
+#include "Process.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    using DirectoryTotals = SyncDirectoryScanner::DirectoryTotals;
+
+    /** The most threads used to walk the tree; beyond this the storage rather than the CPU is the bottleneck. */
+    constexpr const unsigned MaximumScanThreads = 16;
+
+    const QString InotifyWatchLimitFile = QStringLiteral("/proc/sys/fs/inotify/max_user_watches");
+
+    /** How often a thread waiting for work checks whether the walk has been cancelled. */
+    constexpr const std::chrono::milliseconds CancelCheckInterval(100);
+
+    /** One thread's queue of directories to read, from which other threads may steal. */
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<std::string> directories;
+    };
+
+    /**
+     * Read the entries of one directory.
+     *
+     * Only regular files are counted; symlinks and special files are ignored, and subdirectories are not descended
+     * into.
+     *
+     * @param rootFd A descriptor for the root directory.
+     * @param directory The directory to read, relative to the root.
+     * @param totals Receives the files and bytes in the directory.
+     * @param subdirectories Receives the paths of the subdirectories, relative to the root.
+     *
+     * @return false if the path is not a readable directory.
+     */
+    bool readDirectory(int rootFd, const std::string & directory, DirectoryTotals & totals, std::vector<std::string> & subdirectories)
+    {
+        const auto fd = ::openat(rootFd, directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+        if (0 > fd) {
+            return false;
+        }
+
+        auto * dir = ::fdopendir(fd);
+
+        if (!dir) {
+            ::close(fd);
+            return false;
+        }
+
+        const auto prefix = directory.empty() ? std::string() : directory + '/';
+
+        while (const auto * entry = ::readdir(dir)) {
+            const auto * name = entry->d_name;
+
+            if ('.' == name[0] && ('\0' == name[1] || ('.' == name[1] && '\0' == name[2]))) {
+                continue;
+            }
+
+            auto type = entry->d_type;
+            struct stat info{};
+
+            // the type is usually known from the directory entry, so only files (for their size) need a stat
+            if (DT_REG == type || DT_UNKNOWN == type) {
+                if (0 != ::fstatat(fd, name, &info, AT_SYMLINK_NOFOLLOW)) {
+                    continue;
+                }
+
+                type = S_ISDIR(info.st_mode) ? DT_DIR : (S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN);
+            }
+
+            if (DT_DIR == type) {
+                subdirectories.push_back(prefix + name);
+            } else if (DT_REG == type) {
+                ++totals.files;
+                totals.bytes += static_cast<quint64>(info.st_size);
+            }
+        }
+
+        ::closedir(dir);
+        return true;
+    }
+
+    /**
+     * Fetch the next directory for a thread to read.
+     *
+     * The thread's own queue is used as a stack so that it works depth-first through the part of the tree it has
+     * discovered; other threads' queues are stolen from the other end, where the directories nearest the root (and so
+     * likely the largest subtrees) are.
+     */
+    bool takeDirectory(std::vector<WorkQueue> & queues, std::size_t index, std::string & directory)
+    {
+        {
+            auto & own = queues[index];
+            std::lock_guard lock(own.mutex);
+
+            if (!own.directories.empty()) {
+                directory = std::move(own.directories.back());
+                own.directories.pop_back();
+                return true;
+            }
+        }
+
+        for (std::size_t offset = 1; offset < queues.size(); ++offset) {
+            auto & victim = queues[(index + offset) % queues.size()];
+            std::lock_guard lock(victim.mutex);
+
+            if (!victim.directories.empty()) {
+                directory = std::move(victim.directories.front());
+                victim.directories.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * Walk a tree with a pool of work-stealing threads.
+     *
+     * @return The totals for each directory, keyed by path relative to the root.
+     */
+    QHash<QString, DirectoryTotals> walkTree(const QString & root, const std::atomic_bool & cancel)
+    {
+        QHash<QString, DirectoryTotals> directories;
+        const auto rootFd = ::open(QFile::encodeName(root).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        if (0 > rootFd) {
+            return directories;
+        }
+
+        const auto threadCount = std::clamp(std::thread::hardware_concurrency(), 2u, MaximumScanThreads);
+        std::vector<WorkQueue> queues(threadCount);
+        std::vector<std::vector<std::pair<std::string, DirectoryTotals>>> results(threadCount);
+
+        // directories queued or being read; the walk is finished when this reaches 0
+        std::atomic_size_t outstanding(1);
+        queues[0].directories.emplace_back();
+
+        // threads with nothing to steal sleep until another thread queues directories or the walk finishes. pushes
+        // counts the times directories have been queued, so that a thread can tell whether any have been since it
+        // last looked
+        std::mutex idleMutex;
+        std::condition_variable workAvailable;
+        std::atomic_uint64_t pushes(0);
+
+        const auto wake = [&]() {
+            // taking the mutex means a thread between checking for work and waiting can't miss the notification
+            { std::lock_guard lock(idleMutex); }
+            workAvailable.notify_all();
+        };
+
+        const auto work = [&](std::size_t index) {
+            std::string directory;
+            std::vector<std::string> subdirectories;
+
+            while (!cancel.load(std::memory_order_relaxed)) {
+                const auto seen = pushes.load(std::memory_order_acquire);
+
+                if (!takeDirectory(queues, index, directory)) {
+                    if (0 == outstanding.load(std::memory_order_acquire)) {
+                        break;
+                    }
+
+                    std::unique_lock lock(idleMutex);
+
+                    workAvailable.wait_for(lock, CancelCheckInterval, [&]() {
+                        return seen != pushes.load(std::memory_order_acquire) || 0 == outstanding.load(std::memory_order_acquire);
+                    });
+
+                    continue;
+                }
+
+                DirectoryTotals totals;
+                subdirectories.clear();
+
+                if (readDirectory(rootFd, directory, totals, subdirectories)) {
+                    results[index].emplace_back(std::move(directory), totals);
+                }
+
+                if (!subdirectories.empty()) {
+                    // counted before this directory is finished so that outstanding can't reach 0 early
+                    outstanding.fetch_add(subdirectories.size(), std::memory_order_relaxed);
+
+                    {
+                        auto & own = queues[index];
+                        std::lock_guard lock(own.mutex);
+                        std::move(subdirectories.begin(), subdirectories.end(), std::back_inserter(own.directories));
+                    }
+
+                    pushes.fetch_add(1, std::memory_order_release);
+                    wake();
+                }
+
+                // the last directory of the walk releases the threads waiting for work
+                if (1 == outstanding.fetch_sub(1, std::memory_order_acq_rel)) {
+                    wake();
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+
+        for (std::size_t index = 1; index < threadCount; ++index) {
+            threads.emplace_back(work, index);
+        }
+
+        work(0);
+
+        for (auto & thread : threads) {
+            thread.join();
+        }
+
+        ::close(rootFd);
+
+        if (cancel) {
+            return directories;
+        }
+
+        std::size_t directoryCount = 0;
+
+        for (const auto & threadResults : results) {
+            directoryCount += threadResults.size();
+        }
+
+        directories.reserve(static_cast<int>(directoryCount));
+
+        for (const auto & threadResults : results) {
+            for (const auto & [path, totals] : threadResults) {
+                directories.insert(QFile::decodeName(path.c_str()), totals);
+            }
+        }
+
+        return directories;
+    }
+
+    /**
+     * Re-read changed directories and adjust the totals.
+     *
+     * A directory that can no longer be read is removed along with everything under it. A directory that wasn't known
+     * before is walked in full, since anything inside it (e.g. if it was moved in) is new too.
+     *
+     * @param root The local sync directory.
+     * @param changed The directories to re-read, relative to the root.
+     * @param directories The totals for each directory, updated in place.
+     * @param fileCount The total number of files, updated in place.
+     * @param totalBytes The total size of the files, updated in place.
+     * @param cancel Set to abandon the update.
+     */
+    void updateDirectories(const QString & root, const QStringList & changed, QHash<QString, SyncDirectoryScanner::DirectoryTotals> & directories, quint64 & fileCount, quint64 & totalBytes, const std::atomic_bool & cancel)
+    {
+        const auto rootFd = ::open(QFile::encodeName(root).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        if (0 > rootFd) {
+            return;
+        }
+
+        QQueue<QString> queue;
+
+        for (const auto & directory : changed) {
+            queue.enqueue(directory);
+        }
+
+        std::vector<std::string> subdirectories;
+
+        while (!queue.isEmpty() && !cancel.load(std::memory_order_relaxed)) {
+            const auto directory = queue.dequeue();
+            const auto existing = directories.find(directory);
+            SyncDirectoryScanner::DirectoryTotals totals;
+            subdirectories.clear();
+
+            if (!readDirectory(rootFd, QFile::encodeName(directory).toStdString(), totals, subdirectories)) {
+                if (existing == directories.end()) {
+                    // a file, or something that has already gone
+                    continue;
+                }
+
+                // a directory that has been deleted or moved away, along with everything under it
+                const auto prefix = directory + QLatin1Char('/');
+
+                for (auto it = directories.begin(); it != directories.end();) {
+                    if (it.key() == directory || it.key().startsWith(prefix)) {
+                        fileCount -= it->files;
+                        totalBytes -= it->bytes;
+                        it = directories.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+
+                continue;
+            }
+
+            if (existing == directories.end()) {
+                for (const auto & subdirectory : subdirectories) {
+                    if (const auto path = QFile::decodeName(subdirectory.c_str()); !directories.contains(path)) {
+                        queue.enqueue(path);
+                    }
+                }
+
+                directories.insert(directory, totals);
+            } else {
+                fileCount -= existing->files;
+                totalBytes -= existing->bytes;
+                *existing = totals;
+            }
+
+            fileCount += totals.files;
+            totalBytes += totals.bytes;
+        }
+
+        ::close(rootFd);
+    }
+}
+
+
+SyncDirectoryScanner::SyncDirectoryScanner(const Process & process, QObject * parent)
+        : QObject(parent),
+          m_root(),
+          m_hasTotals(false),
+          m_fileCount(0),
+          m_totalBytes(0),
+          m_directories(),
+          m_changedDirectories(),
+          m_updateTimer(),
+          m_updating(false),
+          m_generation(0),
+          m_cancel(),
+          m_scanThread()
+{
+    m_updateTimer.setSingleShot(true);
+    m_updateTimer.setInterval(UpdateDelay);
+    connect(&m_updateTimer, &QTimer::timeout, this, &SyncDirectoryScanner::updateChangedDirectories);
+
+    connect(&process, &Process::localDirectoryCreated, this, &SyncDirectoryScanner::markChanged);
+    connect(&process, &Process::remoteDirectoryCreated, this, &SyncDirectoryScanner::markChanged);
+    connect(&process, &Process::fileDownloaded, this, &SyncDirectoryScanner::markChanged);
+    connect(&process, &Process::fileUploaded, this, &SyncDirectoryScanner::markChanged);
+    connect(&process, &Process::fileDeleted, this, &SyncDirectoryScanner::markChanged);
+
+    connect(&process, &Process::fileRenamed, this, [this](const QString & from, const QString & to) {
+        markChanged(from);
+        markChanged(to);
+    });
+}
+
+
+SyncDirectoryScanner::~SyncDirectoryScanner()
+{
+    cancelScan();
+}
+
+
+void SyncDirectoryScanner::cancelScan()
+{
+    if (m_cancel) {
+        *m_cancel = true;
+    }
+
+    if (m_scanThread.joinable()) {
+        m_scanThread.join();
+    }
+
+    m_updating = false;
+}
+
+
+void SyncDirectoryScanner::scan(const QString & root)
+{
+    cancelScan();
+    m_root = QDir::cleanPath(root);
+    m_hasTotals = false;
+    m_fileCount = 0;
+    m_totalBytes = 0;
+    m_directories.clear();
+    m_changedDirectories.clear();
+    m_updateTimer.stop();
+
+    if (m_root.isEmpty()) {
+        return;
+    }
+
+    const auto generation = ++m_generation;
+    m_cancel = std::make_shared<std::atomic_bool>(false);
+
+    m_scanThread = std::thread([this, generation, root = m_root, cancel = m_cancel]() {
+        QElapsedTimer timer;
+        timer.start();
+        auto directories = walkTree(root, *cancel);
+
+        if (*cancel) {
+            return;
+        }
+
+        // the destructor joins this thread, so the object outlives the call being queued
+        QMetaObject::invokeMethod(this, [this, generation, directories = std::move(directories), duration = timer.elapsed()]() mutable {
+            onScanComplete(generation, std::move(directories), duration);
+        }, Qt::QueuedConnection);
+    });
+}
+
+
+void SyncDirectoryScanner::onScanComplete(quint64 generation, QHash<QString, DirectoryTotals> directories, qint64 duration)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    if (m_scanThread.joinable()) {
+        m_scanThread.join();
+    }
+
+    m_directories = std::move(directories);
+    m_fileCount = 0;
+    m_totalBytes = 0;
+
+    for (const auto & totals : m_directories) {
+        m_fileCount += totals.files;
+        m_totalBytes += totals.bytes;
+    }
+
+    m_hasTotals = true;
+
+    // changes reported during the walk might not have been seen by it
+    if (!m_changedDirectories.isEmpty()) {
+        m_updateTimer.start();
+    }
+
+    Q_EMIT scanComplete(duration);
+    Q_EMIT totalsChanged();
+}
+
+
+QString SyncDirectoryScanner::relativePath(const QString & path) const
+{
+    // normalised as the events are, so that a name with spaces at either end is re-read under its own name
+    auto relative = EventBus::normalisePath(path);
+
+    if (relative == m_root) {
+        return {};
+    }
+
+    if (relative.startsWith(m_root + QLatin1Char('/'))) {
+        relative.remove(0, m_root.size() + 1);
+    } else if (relative == QLatin1String(".")) {
+        return {};
+    }
+
+    return relative;
+}
+
+
+void SyncDirectoryScanner::markChanged(const QString & path)
+{
+    if (m_root.isEmpty()) {
+        return;
+    }
+
+    const auto relative = relativePath(path);
+
+    // the path itself only matters if it is (or was) a directory, which is sorted out when it's re-read
+    m_changedDirectories.insert(relative);
+    const auto separator = relative.lastIndexOf(QLatin1Char('/'));
+    m_changedDirectories.insert(0 > separator ? QString() : relative.left(separator));
+
+    if (m_hasTotals && !m_updateTimer.isActive()) {
+        m_updateTimer.start();
+    }
+}
+
+
+void SyncDirectoryScanner::updateChangedDirectories()
+{
+    // an update already under way picks up the rest of the changes when it finishes
+    if (!m_hasTotals || m_changedDirectories.isEmpty() || m_updating) {
+        return;
+    }
+
+    if (m_scanThread.joinable()) {
+        m_scanThread.join();
+    }
+
+    m_updating = true;
+    const auto changed = m_changedDirectories.values();
+    m_changedDirectories.clear();
+
+    // the hash is shared with the thread until it makes its first change, so the copy costs nothing here
+    m_scanThread = std::thread([this, generation = m_generation, root = m_root, cancel = m_cancel, changed, directories = m_directories, fileCount = m_fileCount, totalBytes = m_totalBytes]() mutable {
+        updateDirectories(root, changed, directories, fileCount, totalBytes, *cancel);
+
+        if (*cancel) {
+            return;
+        }
+
+        // the destructor joins this thread, so the object outlives the call being queued
+        QMetaObject::invokeMethod(this, [this, generation, directories = std::move(directories), fileCount, totalBytes]() mutable {
+            onUpdateComplete(generation, std::move(directories), fileCount, totalBytes);
+        }, Qt::QueuedConnection);
+    });
+}
+
+
+void SyncDirectoryScanner::onUpdateComplete(quint64 generation, QHash<QString, DirectoryTotals> directories, quint64 fileCount, quint64 totalBytes)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    if (m_scanThread.joinable()) {
+        m_scanThread.join();
+    }
+
+    m_updating = false;
+    const auto changed = fileCount != m_fileCount || totalBytes != m_totalBytes || directories.size() != m_directories.size();
+    m_directories = std::move(directories);
+    m_fileCount = fileCount;
+    m_totalBytes = totalBytes;
+
+    // changes reported while the directories were being re-read
+    if (!m_changedDirectories.isEmpty()) {
+        m_updateTimer.start();
+    }
+
+    if (changed) {
+        Q_EMIT totalsChanged();
+    }
+}
+
+
+quint64 SyncDirectoryScanner::inotifyWatchLimit()
+{
+    QFile limitFile(InotifyWatchLimitFile);
+
+    if (!limitFile.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    bool ok = false;
+    const auto limit = limitFile.readAll().trimmed().toULongLong(&ok);
+    return ok ? limit : 0;
+}
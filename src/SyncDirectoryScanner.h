@@ -0,0 +1,138 @@
+/**
+ * SyncDirectoryScanner.h
+ *
+ * Declaration of SyncDirectoryScanner class.
+ */
+
+#ifndef ONEDRIVETRAY_SYNCDIRECTORYSCANNER_H
+#define ONEDRIVETRAY_SYNCDIRECTORYSCANNER_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+
+namespace OneDrive
+{
+    class Process;
+
+    /**
+     * Counts the files, directories and bytes in the local sync directory.
+     *
+     * The tree is walked once, in parallel, by a pool of threads that steal directories from each other's queues. The
+     * totals for each directory are kept so that afterwards the figures can be kept up to date by re-reading only the
+     * directories the onedrive client reports changes in, rather than walking the whole tree again. Those directories
+     * are re-read on a background thread too, since a directory moved into the tree is walked in full.
+     */
+    class SyncDirectoryScanner
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** The files and bytes directly inside one directory. */
+        struct DirectoryTotals
+        {
+            quint64 files = 0;
+            quint64 bytes = 0;
+        };
+
+        /** How long after the client reports a change the affected directories are re-read (ms). */
+        static constexpr const int UpdateDelay = 1000;
+
+        explicit SyncDirectoryScanner(const Process & process, QObject * parent = nullptr);
+
+        ~SyncDirectoryScanner() override;
+
+        /**
+         * Walk a directory tree in the background.
+         *
+         * Any scan in progress is abandoned. scanComplete() is emitted when the walk finishes.
+         *
+         * @param root The local sync directory.
+         */
+        void scan(const QString & root);
+
+        /** Whether the initial walk has completed. */
+        [[nodiscard]] inline bool hasTotals() const
+        {
+            return m_hasTotals;
+        }
+
+        [[nodiscard]] inline quint64 fileCount() const
+        {
+            return m_fileCount;
+        }
+
+        [[nodiscard]] inline quint64 directoryCount() const
+        {
+            return static_cast<quint64>(m_directories.size());
+        }
+
+        [[nodiscard]] inline quint64 totalBytes() const
+        {
+            return m_totalBytes;
+        }
+
+        /**
+         * Read the per-user inotify watch limit.
+         *
+         * @return The limit, or 0 if it can't be read.
+         */
+        [[nodiscard]] static quint64 inotifyWatchLimit();
+
+    Q_SIGNALS:
+        /** Emitted when the initial walk completes, with the time it took (ms). */
+        void scanComplete(qint64 duration);
+
+        /** Emitted whenever the totals change. */
+        void totalsChanged();
+
+    private:
+        /** Receive the results of a background walk. */
+        void onScanComplete(quint64 generation, QHash<QString, DirectoryTotals> directories, qint64 duration);
+
+        /** Mark the directory containing a path, and the path itself, as needing to be re-read. */
+        void markChanged(const QString & path);
+
+        /** Re-read the directories marked as changed in the background. */
+        void updateChangedDirectories();
+
+        /** Receive the adjusted totals from a background update. */
+        void onUpdateComplete(quint64 generation, QHash<QString, DirectoryTotals> directories, quint64 fileCount, quint64 totalBytes);
+
+        /** Abandon any background walk or update and wait for its threads to finish. */
+        void cancelScan();
+
+        /** Normalise a path reported by the client to be relative to the root. */
+        [[nodiscard]] QString relativePath(const QString & path) const;
+
+        QString m_root;
+        bool m_hasTotals;
+        quint64 m_fileCount;
+        quint64 m_totalBytes;
+
+        /** The totals for each directory, keyed by path relative to the root ("" is the root). */
+        QHash<QString, DirectoryTotals> m_directories;
+
+        /** Directories to re-read (relative to the root). */
+        QSet<QString> m_changedDirectories;
+        QTimer m_updateTimer;
+
+        /** Whether changed directories are being re-read in the background. */
+        bool m_updating;
+
+        /** Identifies the current walk, so that the results of abandoned walks are ignored. */
+        quint64 m_generation;
+        std::shared_ptr<std::atomic_bool> m_cancel;
+
+        /** The thread walking the tree or re-reading changed directories. */
+        std::thread m_scanThread;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_SYNCDIRECTORYSCANNER_H
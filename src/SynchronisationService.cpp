@@ -0,0 +1,1026 @@
+/**
+ * SynchronisationService.cpp
+ *
+ * Implementation of SynchronisationService class.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QLatin1String>
+#include <QtCore/QLocale>
+#include <QtCore/QSettings>
+#include <QtCore/QStandardPaths>
+#include "SynchronisationService.h"
+#include "ControlProtocol.h"
+#include "DBusAdaptor.h"
+#include "Logger.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    const QString DefaultOneDriveConfigDirectory = QStringLiteral("/onedrive");
+    const QString DefaultOneDrivePath = QStringLiteral("/usr/bin/onedrive");
+
+    /** How often the session snapshot is saved, if it has changed (ms). */
+    constexpr const int SnapshotInterval = 5 * 60 * 1000;
+
+    /** The events that are fed to the transfer notifications. */
+    constexpr const EventBus::EventTypes TransferEventTypes = EventBus::typeMask(EventBus::EventType::Uploaded)
+            | EventBus::typeMask(EventBus::EventType::Downloaded)
+            | EventBus::typeMask(EventBus::EventType::Deleted);
+
+    Notifier::Transfer transferFor(EventBus::EventType type)
+    {
+        switch (type) {
+            case EventBus::EventType::Uploaded:
+                return Notifier::Transfer::Upload;
+
+            case EventBus::EventType::Downloaded:
+                return Notifier::Transfer::Download;
+
+            case EventBus::EventType::Deleted:
+                return Notifier::Transfer::Delete;
+
+            default:
+                break;
+        }
+
+        throw std::logic_error("Unhandled event type in transferFor()");
+    }
+
+    /** Store an optional value in the settings, removing the key if there's no value. */
+    void setOptionalSetting(QSettings & settingsStore, const QString & key, const std::optional<int> & value)
+    {
+        if (value) {
+            settingsStore.setValue(key, *value);
+        } else {
+            settingsStore.remove(key);
+        }
+    }
+
+    std::optional<int> optionalIntSetting(const QSettings & settingsStore, const QString & key)
+    {
+        bool ok = false;
+        const auto value = settingsStore.value(key).toInt(&ok);
+        return ok ? std::optional<int>(value) : std::nullopt;
+    }
+}
+
+
+SynchronisationService::SynchronisationService(QObject * parent)
+        : QObject(parent),
+          m_oneDrivePath(DefaultOneDrivePath),
+          m_oneDriveArguments(),
+          m_syncDirectory(),
+          m_settings(),
+          m_process(),
+          m_supervisor(m_process),
+          m_resourceMonitor(m_process),
+          m_latencyTracker(m_process),
+          m_directoryScanner(m_process),
+          m_watchBudgetWarned(false),
+          m_errorClassifier(m_process),
+          m_throttleMonitor(m_process),
+          m_eventBus(m_process),
+          m_eventHistory(m_eventBus),
+          m_monitorTuner(m_eventBus),
+          m_powerMonitor(),
+          m_batteryRestricted(false),
+          m_niceRaisedForBattery(false),
+          m_pausedForBattery(false),
+          m_resumeTimer(),
+          m_notifier(),
+          m_status(tr("Not started")),
+          m_currentFile(),
+          m_freeSpace(-1),
+          m_uploadCount(0),
+          m_downloadCount(0),
+          m_deleteCount(0),
+          m_restartPending(false),
+          m_pausePending(false),
+          m_restartWhenIdle(false),
+          m_dbusAdaptor(nullptr),
+          m_controlServer(*this),
+          m_statusPage(),
+          m_sessionSnapshot(SessionSnapshot::defaultPath(instanceKey())),
+          m_lastSession(m_sessionSnapshot.load()),
+          m_snapshotTimer(),
+          m_snapshotChanged(false)
+{
+    m_resumeTimer.setSingleShot(true);
+    connect(&m_resumeTimer, &QTimer::timeout, this, &SynchronisationService::resumeSynchronisation);
+    connect(&m_monitorTuner, &MonitorIntervalTuner::levelChanged, this, &SynchronisationService::onMonitorLevelChanged);
+    connectProcess();
+
+    // everything that readers of the page can see changes with one of these
+    connect(this, &SynchronisationService::stateChanged, this, &SynchronisationService::publishStatusPage);
+    connect(this, &SynchronisationService::statusChanged, this, &SynchronisationService::publishStatusPage);
+    connect(this, &SynchronisationService::statisticsChanged, this, &SynchronisationService::publishStatusPage);
+    connect(&m_errorClassifier, &ErrorClassifier::statisticsChanged, this, &SynchronisationService::publishStatusPage);
+    connect(&m_resourceMonitor, &ResourceMonitor::usageUpdated, this, &SynchronisationService::publishStatusPage);
+
+    // the snapshot holds the same as the page, so it changes with the same signals, except that a new resource sample
+    // alone isn't worth writing it for
+    const auto snapshotChanged = [this]() {
+        m_snapshotChanged = true;
+    };
+
+    connect(this, &SynchronisationService::stateChanged, this, snapshotChanged);
+    connect(this, &SynchronisationService::statusChanged, this, snapshotChanged);
+    connect(this, &SynchronisationService::statisticsChanged, this, snapshotChanged);
+    connect(&m_errorClassifier, &ErrorClassifier::statisticsChanged, this, snapshotChanged);
+
+    m_snapshotTimer.setInterval(SnapshotInterval);
+    connect(&m_snapshotTimer, &QTimer::timeout, this, &SynchronisationService::saveSessionSnapshot);
+
+    // the adaptor must be a child of the object it is registered with, which takes ownership
+    m_dbusAdaptor = new DBusAdaptor(this);
+}
+
+
+SynchronisationService::~SynchronisationService()
+{
+    shutDown();
+}
+
+
+void SynchronisationService::shutDown()
+{
+    // before the client is stopped, so that the snapshot has the state it was last seen in
+    m_snapshotTimer.stop();
+    saveSessionSnapshot();
+    m_process.disconnect(this);
+    m_supervisor.disconnect(this);
+    m_supervisor.stop();
+    int giveUp = 5;
+
+    while (QProcess::ProcessState::Running == m_process.state() && 0 < giveUp) {
+        if (m_process.waitForFinished(1000)) {
+            break;
+        }
+
+        Logger::log(LogLevel::Info, LogCategory::Application, QStringLiteral("waited 1s for onedrive process to finish"));
+        --giveUp;
+    }
+
+    if (0 == giveUp) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("onedrive process did not terminate cleanly"));
+    }
+}
+
+
+void SynchronisationService::setOneDrivePath(const QString & path)
+{
+    m_oneDrivePath = path.isEmpty() ? DefaultOneDrivePath : path;
+}
+
+
+void SynchronisationService::setOneDriveArgs(const QStringList & args)
+{
+    m_oneDriveArguments = args;
+
+    // the snapshot belongs to the config directory, which the arguments can change
+    const auto snapshotPath = SessionSnapshot::defaultPath(instanceKey());
+
+    if (snapshotPath != m_sessionSnapshot.path()) {
+        m_sessionSnapshot.setPath(snapshotPath);
+        m_lastSession = m_sessionSnapshot.load();
+    }
+}
+
+
+void SynchronisationService::showNotification(const QString & message, int timeout, NotificationType type)
+{
+    const auto summary = m_notifier.displayName();
+
+    switch (type) {
+        case NotificationType::Message:
+            m_notifier.notify(QStringLiteral("message"), summary, message, Notifier::Urgency::Normal, timeout);
+            break;
+
+        case NotificationType::Warning:
+            m_notifier.notify(QStringLiteral("warning"), summary, message, Notifier::Urgency::Normal, timeout);
+            break;
+
+        case NotificationType::Error:
+            m_notifier.notify(QStringLiteral("error"), summary, message, Notifier::Urgency::Critical, timeout);
+            break;
+    }
+}
+
+
+void SynchronisationService::setStatus(const QString & status)
+{
+    if (status == m_status) {
+        return;
+    }
+
+    m_status = status;
+    Q_EMIT statusChanged(m_status);
+}
+
+
+void SynchronisationService::setCurrentFile(const QString & fileName)
+{
+    // the status always changes with the current file, so there's no need for a separate signal
+    m_currentFile = fileName;
+}
+
+
+StatusPage::Status SynchronisationService::currentStatus() const
+{
+    StatusPage::Status page = {};
+    page.state = statusPageState();
+    page.flags = (m_process.isRunning() ? StatusPage::Running : 0u) | (m_process.isRunning() && m_process.isPaused() ? StatusPage::Paused : 0u);
+    page.freeSpace = m_freeSpace;
+    page.uploaded = m_uploadCount;
+    page.downloaded = m_downloadCount;
+    page.deleted = m_deleteCount;
+    page.errors = m_errorClassifier.totalCount();
+    const auto & usage = m_resourceMonitor.usage();
+    page.cpuPercent = usage.cpuPercent;
+    page.residentBytes = usage.residentBytes;
+    page.readBytes = usage.readBytes;
+    page.writtenBytes = usage.writtenBytes;
+    page.threads = static_cast<std::uint32_t>(usage.threadCount);
+    page.updated = QDateTime::currentMSecsSinceEpoch();
+    StatusPagePublisher::copyText(page.currentFile, m_currentFile);
+    StatusPagePublisher::copyText(page.status, m_status);
+    return page;
+}
+
+
+void SynchronisationService::publishStatusPage()
+{
+    if (!m_statusPage.isOpen()) {
+        return;
+    }
+
+    m_statusPage.publish(currentStatus());
+}
+
+
+void SynchronisationService::saveSessionSnapshot()
+{
+    if (!m_snapshotChanged) {
+        return;
+    }
+
+    auto status = currentStatus();
+    auto events = m_eventHistory.eventsFor({}, SessionSnapshot::EventCapacity);
+
+    if (m_lastSession) {
+        // what this session doesn't know yet is still best described by the last one
+        if (0 > status.freeSpace) {
+            status.freeSpace = m_lastSession->status.freeSpace;
+        }
+
+        if (SessionSnapshot::EventCapacity > events.size()) {
+            events = m_lastSession->events + events;
+        }
+    }
+
+    if (m_sessionSnapshot.save(status, events)) {
+        m_snapshotChanged = false;
+    }
+}
+
+
+void SynchronisationService::start()
+{
+    m_syncDirectory = locateSyncDirectory();
+    m_process.setProgram(m_oneDrivePath);
+    m_process.setArguments(m_oneDriveArguments);
+    m_process.detectClientVersion();
+
+    // the client reads its intervals when it starts, so they must be in its config first
+    m_monitorTuner.setEnabled(m_settings.adaptiveMonitorInterval());
+    m_supervisor.start();
+    m_snapshotTimer.start();
+    m_latencyTracker.setRoot(m_syncDirectory);
+    m_directoryScanner.scan(m_syncDirectory);
+    m_dbusAdaptor->registerOnSessionBus();
+    m_controlServer.listen();
+
+    if (m_statusPage.open(StatusPage::statusPageName(instanceKey().toStdString()))) {
+        publishStatusPage();
+    }
+}
+
+
+void SynchronisationService::stop()
+{
+    m_restartPending = false;
+    m_pausePending = false;
+    m_restartWhenIdle = false;
+    m_supervisor.stop();
+}
+
+
+void SynchronisationService::restart()
+{
+    // the supervisor starts it again once it has stopped, without treating the exit as a crash
+    m_restartPending = m_process.isRunning();
+    m_supervisor.restart();
+}
+
+
+void SynchronisationService::restartWhenIdle()
+{
+    if (!m_process.isRunning()) {
+        return;
+    }
+
+    const auto state = m_process.synchronisationState();
+
+    if (!m_process.isPaused() && (Process::SynchronisationState::Idle == state || Process::SynchronisationState::Stopped == state)) {
+        m_restartWhenIdle = false;
+        restart();
+        return;
+    }
+
+    // onSynchronisationStateChanged() or onProcessResumed() restarts it
+    m_restartWhenIdle = true;
+}
+
+
+bool SynchronisationService::applyPerformanceSettings(const PerformanceSettings & settings, QString & error)
+{
+    const auto problems = OneDriveConfig::validate(settings);
+
+    if (!problems.isEmpty()) {
+        error = problems.join(QLatin1Char('\n'));
+        return false;
+    }
+
+    OneDriveConfig config(configDirectory() + QStringLiteral("/config"));
+
+    if (!config.load()) {
+        error = tr("The onedrive config file %1 could not be read: %2").arg(config.path(), config.errorString());
+        return false;
+    }
+
+    if (config.performanceSettings() == settings) {
+        return true;
+    }
+
+    config.setPerformanceSettings(settings);
+
+    if (!config.save()) {
+        error = tr("The onedrive config file %1 could not be written: %2").arg(config.path(), config.errorString());
+        return false;
+    }
+
+    Logger::log(LogLevel::Info, LogCategory::Application, QStringLiteral("performance settings written to %1").arg(config.path()));
+    restartWhenIdle();
+    return true;
+}
+
+
+QString SynchronisationService::stateName() const
+{
+    if (!m_process.isRunning()) {
+        return QStringLiteral("stopped");
+    }
+
+    switch (m_process.synchronisationState()) {
+        case Process::SynchronisationState::Idle:
+            return QStringLiteral("idle");
+
+        case Process::SynchronisationState::Stopped:
+            return QStringLiteral("stopped");
+
+        case Process::SynchronisationState::Starting:
+            return QStringLiteral("starting");
+
+        case Process::SynchronisationState::ScanningLocal:
+            return QStringLiteral("scanning-local");
+
+        case Process::SynchronisationState::FetchingRemote:
+            return QStringLiteral("fetching-remote");
+
+        case Process::SynchronisationState::Transferring:
+            return QStringLiteral("transferring");
+
+        case Process::SynchronisationState::Error:
+            return QStringLiteral("error");
+    }
+
+    throw std::logic_error("Unhandled sync state in SynchronisationService::stateName()");
+}
+
+
+std::uint32_t SynchronisationService::statusPageState() const
+{
+    if (!m_process.isRunning()) {
+        return StatusPage::Stopped;
+    }
+
+    switch (m_process.synchronisationState()) {
+        case Process::SynchronisationState::Idle:
+            return StatusPage::Idle;
+
+        case Process::SynchronisationState::Stopped:
+            return StatusPage::Stopped;
+
+        case Process::SynchronisationState::Starting:
+            return StatusPage::Starting;
+
+        case Process::SynchronisationState::ScanningLocal:
+            return StatusPage::ScanningLocal;
+
+        case Process::SynchronisationState::FetchingRemote:
+            return StatusPage::FetchingRemote;
+
+        case Process::SynchronisationState::Transferring:
+            return StatusPage::Transferring;
+
+        case Process::SynchronisationState::Error:
+            return StatusPage::Error;
+    }
+
+    throw std::logic_error("Unhandled sync state in SynchronisationService::statusPageState()");
+}
+
+
+QDateTime SynchronisationService::resumeTime() const
+{
+    if (!m_resumeTimer.isActive()) {
+        return {};
+    }
+
+    return QDateTime::currentDateTime().addMSecs(m_resumeTimer.remainingTime());
+}
+
+
+void SynchronisationService::pauseSynchronisation(int duration)
+{
+    if (0 < duration) {
+        m_resumeTimer.start(duration);
+    } else {
+        m_resumeTimer.stop();
+    }
+
+    if (!m_process.isRunning()) {
+        m_resumeTimer.stop();
+        m_pausePending = 0 >= duration;
+        return;
+    }
+
+    if (m_process.isPaused()) {
+        // already paused - just refresh the status to show the new duration
+        onProcessPaused();
+        return;
+    }
+
+    if (!m_process.pause()) {
+        m_resumeTimer.stop();
+    }
+}
+
+
+void SynchronisationService::resumeSynchronisation()
+{
+    m_resumeTimer.stop();
+    m_pausePending = false;
+    m_process.resume();
+}
+
+
+void SynchronisationService::setOneDrivePriority(int niceValue, IoPriorityClass ioClass, int ioLevel)
+{
+    auto limits = m_settings.resourceLimits();
+    limits.niceValue = niceValue;
+    limits.ioPriorityClass = ioClass;
+    limits.ioPriorityLevel = ioLevel;
+    m_settings.setResourceLimits(limits);
+    saveSettings();
+    applyPowerPolicy();
+}
+
+
+void SynchronisationService::setBatteryPolicy(BatteryPolicy policy)
+{
+    m_settings.setBatteryPolicy(policy);
+    saveSettings();
+    applyPowerPolicy();
+}
+
+
+void SynchronisationService::setNotifyTransfers(bool notify)
+{
+    m_settings.setNotifyTransfers(notify);
+    saveSettings();
+}
+
+
+void SynchronisationService::setAdaptiveMonitorInterval(bool adapt)
+{
+    if (adapt == m_settings.adaptiveMonitorInterval()) {
+        return;
+    }
+
+    if (adapt) {
+        // the tuner overwrites the user's intervals, so they're kept to be put back when it's turned off
+        OneDriveConfig config(configDirectory() + QStringLiteral("/config"));
+
+        if (config.load()) {
+            const auto settings = config.performanceSettings();
+            m_settings.setUserMonitorInterval(settings.monitorInterval);
+            m_settings.setUserMonitorFullscanFrequency(settings.monitorFullscanFrequency);
+        } else {
+            Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("could not read %1, the client's default check interval will be restored: %2").arg(config.path(), config.errorString()));
+            m_settings.setUserMonitorInterval(std::nullopt);
+            m_settings.setUserMonitorFullscanFrequency(std::nullopt);
+        }
+    }
+
+    m_settings.setAdaptiveMonitorInterval(adapt);
+    saveSettings();
+    m_monitorTuner.setEnabled(adapt);
+
+    if (!adapt) {
+        applyMonitorIntervals(m_settings.userMonitorInterval(), m_settings.userMonitorFullscanFrequency());
+    }
+}
+
+
+void SynchronisationService::applyPowerPolicy()
+{
+    const auto policy = m_settings.batteryPolicy();
+    const auto restricted = BatteryPolicy::None != policy && m_powerMonitor.onBattery() && m_powerMonitor.batteryLevel() <= m_settings.batteryThreshold();
+    auto limits = m_settings.resourceLimits();
+    auto niceRaised = false;
+
+    if (restricted && BatteryPolicy::Deprioritise == policy) {
+        // the cgroup's weight can be restored afterwards, but the tray can't lower a running client's nice value again
+        if (limits.useCgroup) {
+            limits.cgroupCpuWeight = ResourceLimits::MinimumCgroupCpuWeight;
+        } else {
+            niceRaised = limits.niceValue < ResourceLimits::MaximumNiceValue;
+            limits.niceValue = ResourceLimits::MaximumNiceValue;
+        }
+
+        limits.ioPriorityClass = IoPriorityClass::Idle;
+    }
+
+    if (limits != m_process.resourceLimits()) {
+        const auto niceLowered = m_process.isRunning() && limits.niceValue < m_process.resourceLimits().niceValue;
+
+        // the I/O priority, CPU affinity and cgroup limits take effect straight away, only the nice value can't
+        m_process.setResourceLimits(limits);
+
+        if (niceLowered && m_niceRaisedForBattery) {
+            // a restarted client gets the configured nice value from the start
+            Logger::log(LogLevel::Info, LogCategory::Application, QStringLiteral("restarting onedrive to restore its priority"));
+            restartWhenIdle();
+        } else if (niceLowered) {
+            // the user chose a higher priority, which isn't worth interrupting a synchronisation for
+            Logger::log(LogLevel::Info, LogCategory::Application, QStringLiteral("the onedrive process keeps its nice value until it is restarted"));
+            showNotification(tr("OneDrive's CPU priority will be raised the next time it is restarted"));
+        }
+    }
+
+    m_niceRaisedForBattery = niceRaised;
+
+    if (restricted == m_batteryRestricted) {
+        return;
+    }
+
+    m_batteryRestricted = restricted;
+
+    if (restricted && BatteryPolicy::Pause == policy) {
+        pauseForBattery();
+    } else if (!restricted && m_pausedForBattery) {
+        resumeSynchronisation();
+    }
+}
+
+
+void SynchronisationService::pauseForBattery()
+{
+    if (!m_process.isRunning() || m_process.isPaused()) {
+        return;
+    }
+
+    m_resumeTimer.stop();
+
+    if (m_process.pause()) {
+        m_pausedForBattery = true;
+        setStatus(tr("Synchronization paused while on battery"));
+    }
+}
+
+
+void SynchronisationService::checkInotifyWatchBudget()
+{
+    const auto limit = SyncDirectoryScanner::inotifyWatchLimit();
+
+    if (0 == limit) {
+        return;
+    }
+
+    // other applications need watches too, so warn before the limit is actually reached
+    const auto needed = m_directoryScanner.directoryCount() * 2;
+    const auto tight = needed > limit - limit / 10;
+
+    if (!tight) {
+        m_watchBudgetWarned = false;
+        return;
+    }
+
+    if (m_watchBudgetWarned) {
+        return;
+    }
+
+    m_watchBudgetWarned = true;
+    const auto locale = QLocale::system();
+
+    showNotification(
+            tr("Your OneDrive folder contains %1 folders, but the system only allows %2 of them to be watched for changes. OneDrive will not notice local changes in some folders until it is restarted. To fix this, increase the limit, for example with \"sysctl fs.inotify.max_user_watches=%3\".")
+                    .arg(locale.toString(m_directoryScanner.directoryCount()), locale.toString(limit / 2), QString::number(needed * 2)),
+            NotificationType::Warning
+    );
+}
+
+
+void SynchronisationService::saveSettings() const
+{
+    QSettings settingsStore;
+    settingsStore.beginGroup(QLatin1String("Application"));
+    settingsStore.setValue("iconStyle", static_cast<int>(m_settings.iconStyle()));
+    settingsStore.setValue("startOwnOneDrive", m_settings.startOwnOneDrive());
+    settingsStore.setValue("useCustomOneDrive", m_settings.useCustomOneDrive());
+    settingsStore.setValue("customOneDrivePath", QString::fromStdString(m_settings.customOneDrivePath()));
+    settingsStore.setValue("useCustomSocket", m_settings.useCustomSocket());
+    settingsStore.setValue("customSocketPath", QString::fromStdString(m_settings.customSocketPath()));
+    settingsStore.setValue("autoRestart", m_settings.autoRestart());
+    settingsStore.setValue("watchdogTimeout", m_settings.watchdogTimeout());
+    settingsStore.setValue("watchdogRestarts", m_settings.watchdogRestarts());
+    settingsStore.setValue("batteryPolicy", static_cast<int>(m_settings.batteryPolicy()));
+    settingsStore.setValue("batteryThreshold", m_settings.batteryThreshold());
+    settingsStore.setValue("notifyTransfers", m_settings.notifyTransfers());
+    settingsStore.setValue("adaptiveMonitorInterval", m_settings.adaptiveMonitorInterval());
+    setOptionalSetting(settingsStore, "userMonitorInterval", m_settings.userMonitorInterval());
+    setOptionalSetting(settingsStore, "userMonitorFullscanFrequency", m_settings.userMonitorFullscanFrequency());
+    settingsStore.endGroup();
+
+    const auto & limits = m_settings.resourceLimits();
+    settingsStore.beginGroup(QLatin1String("ResourceLimits"));
+    settingsStore.setValue("niceValue", limits.niceValue);
+    settingsStore.setValue("ioPriorityClass", static_cast<int>(limits.ioPriorityClass));
+    settingsStore.setValue("ioPriorityLevel", limits.ioPriorityLevel);
+    settingsStore.setValue("cpuAffinity", QString::fromStdString(limits.cpuAffinity));
+    settingsStore.setValue("useCgroup", limits.useCgroup);
+    settingsStore.setValue("cgroupCpuMax", limits.cgroupCpuMax);
+    settingsStore.setValue("cgroupMemoryHigh", static_cast<qulonglong>(limits.cgroupMemoryHigh));
+    settingsStore.setValue("cgroupIoMax", QString::fromStdString(limits.cgroupIoMax));
+    settingsStore.endGroup();
+}
+
+
+void SynchronisationService::loadSettings()
+{
+    QSettings settingsStore;
+    settingsStore.beginGroup(QLatin1String("Application"));
+
+    switch (settingsStore.value("iconStyle", 0).value<int>()) {
+        default:
+            std::cerr << "unexpected icon style " << settingsStore.value("iconStyle", 0).value<int>() << " in m_settings file - defaulting to 'colourful'\n";
+            [[fallthrough]];
+        case static_cast<int>(IconStyle::colourful):
+            m_settings.setIconStyle(IconStyle::colourful);
+            break;
+
+        case static_cast<int>(IconStyle::monochrome):
+            m_settings.setIconStyle(IconStyle::monochrome);
+            break;
+    }
+
+    m_settings.setStartOwnOneDrive(settingsStore.value("startOwnOneDrive", true).value<bool>());
+    m_settings.setUseCustomOneDrive(settingsStore.value("useCustomOneDrive", true).value<bool>());
+    m_settings.setCustomOneDrivePath(settingsStore.value("customOneDrivePath", "").value<QString>().toStdString());
+    m_settings.setUseCustomSocket(settingsStore.value("useCustomSocket", true).value<bool>());
+    m_settings.setCustomSocketPath(settingsStore.value("customSocketPath", "").value<QString>().toStdString());
+    m_settings.setAutoRestart(settingsStore.value("autoRestart", true).value<bool>());
+    m_settings.setWatchdogTimeout(settingsStore.value("watchdogTimeout", ProcessSupervisor::DefaultWatchdogTimeout).value<int>());
+    m_settings.setWatchdogRestarts(settingsStore.value("watchdogRestarts", false).value<bool>());
+
+    switch (settingsStore.value("batteryPolicy", static_cast<int>(BatteryPolicy::Deprioritise)).value<int>()) {
+        default:
+            std::cerr << "unexpected battery policy " << settingsStore.value("batteryPolicy", 0).value<int>() << " in m_settings file - defaulting to 'deprioritise'\n";
+            [[fallthrough]];
+        case static_cast<int>(BatteryPolicy::Deprioritise):
+            m_settings.setBatteryPolicy(BatteryPolicy::Deprioritise);
+            break;
+
+        case static_cast<int>(BatteryPolicy::None):
+            m_settings.setBatteryPolicy(BatteryPolicy::None);
+            break;
+
+        case static_cast<int>(BatteryPolicy::Pause):
+            m_settings.setBatteryPolicy(BatteryPolicy::Pause);
+            break;
+    }
+
+    m_settings.setBatteryThreshold(std::clamp(settingsStore.value("batteryThreshold", 100).value<int>(), 0, 100));
+    m_settings.setNotifyTransfers(settingsStore.value("notifyTransfers", false).value<bool>());
+    m_settings.setAdaptiveMonitorInterval(settingsStore.value("adaptiveMonitorInterval", false).value<bool>());
+    m_settings.setUserMonitorInterval(optionalIntSetting(settingsStore, "userMonitorInterval"));
+    m_settings.setUserMonitorFullscanFrequency(optionalIntSetting(settingsStore, "userMonitorFullscanFrequency"));
+    settingsStore.endGroup();
+    applySupervisorSettings();
+
+    ResourceLimits limits;
+    settingsStore.beginGroup(QLatin1String("ResourceLimits"));
+    limits.niceValue = std::clamp(settingsStore.value("niceValue", 0).value<int>(), ResourceLimits::MinimumNiceValue, ResourceLimits::MaximumNiceValue);
+
+    switch (settingsStore.value("ioPriorityClass", 0).value<int>()) {
+        default:
+            std::cerr << "unexpected I/O priority class " << settingsStore.value("ioPriorityClass", 0).value<int>() << " in m_settings file - defaulting to 'default'\n";
+            [[fallthrough]];
+        case static_cast<int>(IoPriorityClass::Default):
+            limits.ioPriorityClass = IoPriorityClass::Default;
+            break;
+
+        case static_cast<int>(IoPriorityClass::BestEffort):
+            limits.ioPriorityClass = IoPriorityClass::BestEffort;
+            break;
+
+        case static_cast<int>(IoPriorityClass::Idle):
+            limits.ioPriorityClass = IoPriorityClass::Idle;
+            break;
+    }
+
+    limits.ioPriorityLevel = std::clamp(settingsStore.value("ioPriorityLevel", 4).value<int>(), 0, ResourceLimits::MaximumIoPriorityLevel);
+    limits.cpuAffinity = settingsStore.value("cpuAffinity", "").value<QString>().toStdString();
+    limits.useCgroup = settingsStore.value("useCgroup", false).value<bool>();
+    limits.cgroupCpuMax = std::max(0, settingsStore.value("cgroupCpuMax", 0).value<int>());
+    limits.cgroupMemoryHigh = settingsStore.value("cgroupMemoryHigh", 0).value<qulonglong>();
+    limits.cgroupIoMax = settingsStore.value("cgroupIoMax", "").value<QString>().toStdString();
+    settingsStore.endGroup();
+    m_settings.setResourceLimits(limits);
+    applyPowerPolicy();
+}
+
+
+void SynchronisationService::applySupervisorSettings()
+{
+    m_supervisor.setAutoRestart(m_settings.autoRestart());
+    m_supervisor.setWatchdogTimeout(m_settings.watchdogTimeout());
+    m_supervisor.setWatchdogAction(m_settings.watchdogRestarts() ? ProcessSupervisor::WatchdogAction::Restart : ProcessSupervisor::WatchdogAction::Notify);
+}
+
+
+QString SynchronisationService::configDirectory() const
+{
+    auto it = std::find(m_oneDriveArguments.cbegin(), m_oneDriveArguments.cend(), QStringLiteral("--confdir"));
+
+    if (it == m_oneDriveArguments.cend() || it + 1 == m_oneDriveArguments.cend()) {
+        return QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + DefaultOneDriveConfigDirectory;
+    }
+
+    ++it;
+    return expandHomeShortcut(*it);
+}
+
+
+QString SynchronisationService::instanceKey() const
+{
+    const auto defaultDirectory = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + DefaultOneDriveConfigDirectory;
+    return QString::fromStdString(ControlProtocol::instanceKey(QFile::encodeName(configDirectory()).toStdString(), QFile::encodeName(defaultDirectory).toStdString()));
+}
+
+
+QString SynchronisationService::locateSyncDirectory() const
+{
+    QSettings oneDriveConfig(configDirectory() + QStringLiteral("/config"), QSettings::IniFormat);
+    return expandHomeShortcut(oneDriveConfig.value("sync_dir", QDir::homePath() + "/OneDrive").toString());
+}
+
+
+QString SynchronisationService::expandHomeShortcut(const QString & path)
+{
+    if (path.startsWith(QLatin1String("~/"))) {
+        return QString(path).replace(0, 1, QDir::homePath());
+    } else if (path.startsWith(QLatin1String("$HOME/"))) {
+        return QString(path).replace(0, 5, QDir::homePath());
+    } else if (path.startsWith(QLatin1String("${HOME}/"))) {
+        return QString(path).replace(0, 7, QDir::homePath());
+    }
+
+    return path;
+}
+
+
+void SynchronisationService::connectProcess()
+{
+    connect(&m_process, &Process::started, this, [this]() {
+        setStatus(tr("Idle"));
+
+        if (m_pausePending) {
+            m_pausePending = false;
+            m_process.pause();
+        } else if (m_batteryRestricted && BatteryPolicy::Pause == m_settings.batteryPolicy()) {
+            pauseForBattery();
+        }
+    });
+
+    connect(&m_process, &Process::stopped, this, &SynchronisationService::onProcessStopped);
+    connect(&m_process, &Process::synchronisationStateChanged, this, &SynchronisationService::onSynchronisationStateChanged);
+    connect(&m_process, &Process::paused, this, &SynchronisationService::onProcessPaused);
+    connect(&m_process, &Process::resumed, this, &SynchronisationService::onProcessResumed);
+
+    connect(&m_process, &Process::synchronisationComplete, this, [this]() {
+        setCurrentFile({});
+        setStatus(tr("Sync complete"));
+    });
+
+    connect(&m_process, &Process::localRootDirectoryRemoved, this, [this]() {
+        setStatus(tr("Sync complete"));
+    });
+
+    connect(&m_process, &Process::localDirectoryCreated, this, [this](const QString & directoryName) {
+        setStatus(tr("Local directory %1 created").arg(directoryName));
+    });
+
+    connect(&m_process, &Process::remoteDirectoryCreated, this, [this](const QString & directoryName) {
+        setStatus(tr("Remote directory %1 created").arg(directoryName));
+    });
+
+    connect(&m_process, &Process::fileRenamed, this, [this](const QString & from, const QString & to) {
+        setStatus(tr("File %1 renamed as %2").arg(from, to));
+    });
+
+    connect(&m_process, &Process::freeSpaceUpdated, this, [this](quint64 space) {
+        m_freeSpace = static_cast<qint64>(std::min<quint64>(space, std::numeric_limits<qint64>::max()));
+        Q_EMIT statisticsChanged();
+    });
+
+    connect(&m_process, &Process::fileDeleted, this, [this](const QString & fileName) {
+        setCurrentFile(fileName);
+        setStatus(tr("File %1 deleted").arg(fileName));
+        ++m_deleteCount;
+        Q_EMIT statisticsChanged();
+    });
+
+    connect(&m_process, &Process::fileUploaded, this, [this](const QString & fileName) {
+        setCurrentFile(fileName);
+        setStatus(tr("Uploading %1 ...").arg(fileName));
+        ++m_uploadCount;
+        Q_EMIT statisticsChanged();
+    });
+
+    connect(&m_process, &Process::fileDownloaded, this, [this](const QString & fileName) {
+        setCurrentFile(fileName);
+        setStatus(tr("Downloading %1 ...").arg(fileName));
+        ++m_downloadCount;
+        Q_EMIT statisticsChanged();
+    });
+
+    m_eventBus.subscribe(this, TransferEventTypes, {}, [this](const EventBus::Batch & events) {
+        if (!m_settings.notifyTransfers()) {
+            return;
+        }
+
+        for (const auto & event : events) {
+            m_notifier.addTransfer(transferFor(event.type), event.path);
+        }
+    });
+
+    // connected last so that the status has been updated by the time the receivers see the new state
+    connect(&m_process, &Process::started, this, &SynchronisationService::stateChanged);
+    connect(&m_process, &Process::stopped, this, &SynchronisationService::stateChanged);
+    connect(&m_process, &Process::paused, this, &SynchronisationService::stateChanged);
+    connect(&m_process, &Process::resumed, this, &SynchronisationService::stateChanged);
+    connect(&m_process, &Process::synchronisationStateChanged, this, &SynchronisationService::stateChanged);
+
+    connect(&m_supervisor, &ProcessSupervisor::restartScheduled, this, &SynchronisationService::onRestartScheduled);
+    connect(&m_supervisor, &ProcessSupervisor::crashLoopDetected, this, &SynchronisationService::onCrashLoopDetected);
+    connect(&m_supervisor, &ProcessSupervisor::hangDetected, this, &SynchronisationService::onHangDetected);
+    connect(&m_powerMonitor, &PowerMonitor::powerStateChanged, this, &SynchronisationService::applyPowerPolicy);
+    connect(&m_directoryScanner, &SyncDirectoryScanner::totalsChanged, this, &SynchronisationService::checkInotifyWatchBudget);
+}
+
+
+void SynchronisationService::onProcessStopped()
+{
+    m_resumeTimer.stop();
+    setCurrentFile({});
+    m_pausedForBattery = false;
+
+    // whenever it starts again it reads the config afresh
+    m_restartWhenIdle = false;
+
+    if (m_restartPending) {
+        m_restartPending = false;
+        setStatus(tr("Restarting"));
+        return;
+    }
+
+    setStatus(tr("Synchronization suspended"));
+}
+
+
+void SynchronisationService::onSynchronisationStateChanged(Process::SynchronisationState state)
+{
+    switch (state) {
+        case Process::SynchronisationState::Starting:
+        case Process::SynchronisationState::ScanningLocal:
+        case Process::SynchronisationState::FetchingRemote:
+        case Process::SynchronisationState::Error:
+            setStatus(Process::synchronisationStateName(state));
+            break;
+
+        case Process::SynchronisationState::Idle:
+            if (m_restartWhenIdle && !m_process.isPaused()) {
+                m_restartWhenIdle = false;
+                restart();
+            }
+            break;
+
+        case Process::SynchronisationState::Stopped:
+        case Process::SynchronisationState::Transferring:
+            // the transfer events and the start/stop/complete handlers provide more specific status
+            break;
+    }
+}
+
+
+void SynchronisationService::onProcessPaused()
+{
+    if (m_resumeTimer.isActive()) {
+        setStatus(tr("Synchronization paused until %1").arg(QLocale::system().toString(resumeTime().time(), QLocale::ShortFormat)));
+    } else {
+        setStatus(tr("Synchronization paused"));
+    }
+}
+
+
+void SynchronisationService::onProcessResumed()
+{
+    m_resumeTimer.stop();
+    m_pausedForBattery = false;
+    setStatus(tr("Synchronization resumed"));
+
+    if (m_restartWhenIdle) {
+        restartWhenIdle();
+    }
+}
+
+
+void SynchronisationService::onMonitorLevelChanged(MonitorIntervalTuner::Level level)
+{
+    const auto intervals = MonitorIntervalTuner::intervals(level);
+    applyMonitorIntervals(intervals.monitorInterval, intervals.monitorFullscanFrequency);
+}
+
+
+void SynchronisationService::applyMonitorIntervals(const std::optional<int> & monitorInterval, const std::optional<int> & monitorFullscanFrequency)
+{
+    OneDriveConfig config(configDirectory() + QStringLiteral("/config"));
+
+    if (!config.load()) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("could not read %1: %2").arg(config.path(), config.errorString()));
+        return;
+    }
+
+    auto settings = config.performanceSettings();
+    settings.monitorInterval = monitorInterval;
+    settings.monitorFullscanFrequency = monitorFullscanFrequency;
+
+    QString error;
+
+    if (!applyPerformanceSettings(settings, error)) {
+        Logger::log(LogLevel::Warning, LogCategory::Application, QStringLiteral("could not apply the check interval: %1").arg(error));
+    }
+}
+
+
+void SynchronisationService::onRestartScheduled(int attempt, int delay)
+{
+    setStatus(tr("OneDrive stopped unexpectedly, restarting in %1s (attempt %2)").arg((delay + 999) / 1000).arg(attempt));
+}
+
+
+void SynchronisationService::onCrashLoopDetected(int exitCount)
+{
+    setStatus(tr("OneDrive keeps stopping, automatic restart disabled"));
+    showNotification(tr("OneDrive stopped %1 times in quick succession and will not be restarted automatically. Use \"Restart synchronization\" once the problem has been fixed.").arg(exitCount), NotificationType::Error);
+}
+
+
+void SynchronisationService::onHangDetected(int idleSeconds)
+{
+    if (ProcessSupervisor::WatchdogAction::Restart == m_supervisor.watchdogAction()) {
+        setStatus(tr("OneDrive appears to be hung, restarting"));
+        return;
+    }
+
+    showNotification(tr("OneDrive has produced no output and used no CPU time for %1 minutes. It may be hung.").arg(idleSeconds / 60), NotificationType::Warning);
+}
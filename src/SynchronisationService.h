@@ -0,0 +1,560 @@
+/**
+ * SynchronisationService.h
+ *
+ * Declaration of SynchronisationService class.
+ */
+
+#ifndef ONEDRIVETRAY_SYNCHRONISATIONSERVICE_H
+#define ONEDRIVETRAY_SYNCHRONISATIONSERVICE_H
+
+#include <optional>
+#include <QtCore/QDateTime>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+#include "Settings.h"
+#include "Process.h"
+#include "ProcessSupervisor.h"
+#include "ResourceMonitor.h"
+#include "PowerMonitor.h"
+#include "ChangeLatencyTracker.h"
+#include "SyncDirectoryScanner.h"
+#include "ErrorClassifier.h"
+#include "EventBus.h"
+#include "EventHistory.h"
+#include "ThrottleMonitor.h"
+#include "MonitorIntervalTuner.h"
+#include "ControlServer.h"
+#include "StatusPagePublisher.h"
+#include "SessionSnapshot.h"
+#include "Notifier.h"
+#include "OneDriveConfig.h"
+
+namespace OneDrive
+{
+    class DBusAdaptor;
+
+    /**
+     * Runs and supervises the onedrive client, independently of any user interface.
+     *
+     * The service owns the client process and everything that monitors it, the settings, and the policies that act on
+     * the client (battery, priority, pausing). It maintains a one-line description of what the client is doing, which
+     * the tray and the headless mode publish, and counts the client's transfers. It uses no widgets, so it can run
+     * under a QCoreApplication.
+     */
+    class SynchronisationService
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        /** Enumeration of the types of notification the service can display. */
+        enum class NotificationType
+        {
+            Message,
+            Warning,
+            Error,
+        };
+
+        /** The defualt duration (in ms) for which notifications will be displayed.*/
+        static const int DefaultNotificationTimeout = 5000;
+
+        /** The duration (in ms) of a timed pause of synchronisation. */
+        static const int TimedPauseDuration = 60 * 60 * 1000;
+
+        explicit SynchronisationService(QObject * parent = nullptr);
+
+        /** Destructor. Shuts the service down if that hasn't already been done. */
+        ~SynchronisationService() override;
+
+        /** Fetch the path to the onedrive client. */
+        [[nodiscard]] inline const QString & oneDrivePath() const
+        {
+            return m_oneDrivePath;
+        }
+
+        /** Set the path to the onedrive client. Takes effect when the client is next started. */
+        void setOneDrivePath(const QString & path);
+
+        /** Fetch the arguments used to start the onedrive client. */
+        [[nodiscard]] inline const QStringList & oneDriveArgs() const
+        {
+            return m_oneDriveArguments;
+        }
+
+        /** Set the arguments used to start the onedrive client. Takes effect when the client is next started. */
+        void setOneDriveArgs(const QStringList & args);
+
+        /**
+         * Fetch the local directory the onedrive client synchronises.
+         *
+         * This is the sync_dir from the client's config file, which is located using the --confdir argument if there
+         * is one. It is determined when the service starts.
+         */
+        [[nodiscard]] inline const QString & syncDirectory() const
+        {
+            return m_syncDirectory;
+        }
+
+        /**
+         * Determine the onedrive client's config directory.
+         *
+         * This is the directory given with --confdir in the arguments, or the client's default if there isn't one.
+         */
+        [[nodiscard]] QString configDirectory() const;
+
+        /**
+         * The key that names this instance's socket, status page, session snapshot and D-Bus service.
+         *
+         * It is derived from the config directory, and is empty for the client's default config directory.
+         */
+        [[nodiscard]] QString instanceKey() const;
+
+        [[nodiscard]] inline const Settings & settings() const
+        {
+            return m_settings;
+        }
+
+        [[nodiscard]] inline Settings & settings()
+        {
+            return m_settings;
+        }
+
+        /** Load the settings and apply them. */
+        void loadSettings();
+
+        /** Save the current settings. */
+        void saveSettings() const;
+
+        [[nodiscard]] inline const Process & process() const
+        {
+            return m_process;
+        }
+
+        [[nodiscard]] inline Process & process()
+        {
+            return m_process;
+        }
+
+        [[nodiscard]] inline const ProcessSupervisor & supervisor() const
+        {
+            return m_supervisor;
+        }
+
+        [[nodiscard]] inline const ResourceMonitor & resourceMonitor() const
+        {
+            return m_resourceMonitor;
+        }
+
+        [[nodiscard]] inline const ChangeLatencyTracker & latencyTracker() const
+        {
+            return m_latencyTracker;
+        }
+
+        [[nodiscard]] inline const SyncDirectoryScanner & directoryScanner() const
+        {
+            return m_directoryScanner;
+        }
+
+        [[nodiscard]] inline const ErrorClassifier & errorClassifier() const
+        {
+            return m_errorClassifier;
+        }
+
+        [[nodiscard]] inline const ThrottleMonitor & throttleMonitor() const
+        {
+            return m_throttleMonitor;
+        }
+
+        /** The bus that carries the client's events to their consumers. */
+        [[nodiscard]] inline EventBus & eventBus()
+        {
+            return m_eventBus;
+        }
+
+        [[nodiscard]] inline const EventHistory & eventHistory() const
+        {
+            return m_eventHistory;
+        }
+
+        /**
+         * The status saved by the previous session, or nullopt if there is none.
+         *
+         * It is stale, so it is only for showing until the client reports afresh, and must be marked as out of date.
+         */
+        [[nodiscard]] inline const std::optional<SessionSnapshot::Session> & lastSession() const
+        {
+            return m_lastSession;
+        }
+
+        [[nodiscard]] inline Notifier & notifier()
+        {
+            return m_notifier;
+        }
+
+        /**
+         * An untranslated name for the synchronisation state, for scripts.
+         *
+         * One of stopped, idle, starting, scanning-local, fetching-remote, transferring or error.
+         */
+        [[nodiscard]] QString stateName() const;
+
+        /** A one-line description of what the onedrive client is doing. */
+        [[nodiscard]] inline const QString & status() const
+        {
+            return m_status;
+        }
+
+        /** The free space in the OneDrive account most recently reported by the client, or -1 if it hasn't been. */
+        [[nodiscard]] inline qint64 freeSpace() const
+        {
+            return m_freeSpace;
+        }
+
+        /** The number of files uploaded since the service was created. */
+        [[nodiscard]] inline quint64 uploadCount() const
+        {
+            return m_uploadCount;
+        }
+
+        /** The number of files downloaded since the service was created. */
+        [[nodiscard]] inline quint64 downloadCount() const
+        {
+            return m_downloadCount;
+        }
+
+        /** The number of items deleted since the service was created. */
+        [[nodiscard]] inline quint64 deleteCount() const
+        {
+            return m_deleteCount;
+        }
+
+        /** The file the client most recently transferred or deleted, or an empty string if it is idle. */
+        [[nodiscard]] inline const QString & currentFile() const
+        {
+            return m_currentFile;
+        }
+
+        /** The time at which a timed pause ends, or a null time if synchronisation is not on a timed pause. */
+        [[nodiscard]] QDateTime resumeTime() const;
+
+        /**
+         * Start the onedrive client and the monitoring of the sync directory.
+         *
+         * The service is also published on the session bus, the control socket and the shared-memory status page.
+         */
+        void start();
+
+        /** Stop the onedrive client. It is not restarted until start() or restart() is called. */
+        void stop();
+
+        /** Restart the onedrive client, stopping it first if it is running. */
+        void restart();
+
+        /**
+         * Restart the onedrive client once it isn't synchronising, so that no transfer is cut short.
+         *
+         * Nothing happens if the client isn't running. A paused client is restarted when it is resumed.
+         */
+        void restartWhenIdle();
+
+        /**
+         * Write performance settings to the onedrive client's config file, restarting the client to pick them up.
+         *
+         * The file is only written, and the client only restarted, if the settings differ from those in the file.
+         *
+         * @param error Receives a description of the problem if the settings can't be applied.
+         *
+         * @return Whether the settings were applied.
+         */
+        bool applyPerformanceSettings(const PerformanceSettings & settings, QString & error);
+
+        /**
+         * Stop the onedrive client for good, waiting a short while for it to exit.
+         *
+         * Call this before the application stops logging so that the outcome is logged.
+         */
+        void shutDown();
+
+        /**
+         * Pause synchronisation without stopping the onedrive client.
+         *
+         * If the client hasn't started yet, an indefinite pause takes effect as soon as it does.
+         *
+         * @param duration How long to pause for (ms), or 0 to pause until resumeSynchronisation() is called.
+         */
+        void pauseSynchronisation(int duration = 0);
+
+        /** Resume synchronisation after pauseSynchronisation(). */
+        void resumeSynchronisation();
+
+        /**
+         * Change the CPU and I/O priority of the onedrive process, and save it in the settings.
+         *
+         * @param niceValue The CPU nice value.
+         * @param ioClass The I/O scheduling class.
+         * @param ioLevel The I/O priority level within the best-effort class.
+         */
+        void setOneDrivePriority(int niceValue, IoPriorityClass ioClass, int ioLevel);
+
+        /** Change what happens to the onedrive process on battery, and save it in the settings. */
+        void setBatteryPolicy(BatteryPolicy policy);
+
+        /** Turn the notifications of transfers on or off, and save it in the settings. */
+        void setNotifyTransfers(bool notify);
+
+        /**
+         * Turn the adapting of the client's check interval on or off, and save it in the settings.
+         *
+         * Turning it on keeps the client's current intervals, and turning it off puts them back.
+         */
+        void setAdaptiveMonitorInterval(bool adapt);
+
+        /**
+         * Show a notification to the user.
+         *
+         * The notification is shown asynchronously. Notifications of the same type that arrive in quick succession
+         * replace each other.
+         *
+         * @param message The message to show.
+         * @param timeout How many ms to show the notification for.
+         * @param type The notification type.
+         */
+        void showNotification(const QString & message, int timeout = DefaultNotificationTimeout, NotificationType type = NotificationType::Message);
+
+        /**
+         * Show a notification to the user.
+         *
+         * @param message The message to show.
+         * @param type The notification type.
+         */
+        inline void showNotification(const QString & message, NotificationType type)
+        {
+            showNotification(message, DefaultNotificationTimeout, type);
+        }
+
+    Q_SIGNALS:
+        /** Emitted when the client starts, stops, is paused or resumed, or moves to a new synchronisation phase. */
+        void stateChanged();
+
+        /** Emitted when the description of what the onedrive client is doing changes. */
+        void statusChanged(const QString & status);
+
+        /** Emitted when the free space or the transfer counts change. */
+        void statisticsChanged();
+
+    private:
+        /**
+         * Helper to expand ~ and $HOME in a path to the full home path.
+         *
+         * @param path The path to expand.
+         *
+         * @return The expanded path.
+         */
+        static QString expandHomeShortcut(const QString & path);
+
+        /**
+         * Helper to locate the directory onedrive is synchronising.
+         *
+         * @return The path to the directory.
+         */
+        [[nodiscard]] QString locateSyncDirectory() const;
+
+        /** Helper to connect to signals on the onedrive process and its monitors. */
+        void connectProcess();
+
+        /** Helper to apply the current settings to the process supervisor. */
+        void applySupervisorSettings();
+
+        /**
+         * Apply the battery policy for the current power state to the onedrive process.
+         *
+         * The process's resource limits are set from the settings, or to the background priority while deprioritised.
+         * A running process's nice value can't be lowered again, so the process is restarted once it is idle when the
+         * deprioritisation is lifted. When the user lowers the nice value the rest of the limits are applied straight
+         * away and the user is told the nice value takes effect when the process is restarted.
+         * Pausing only happens when the machine goes on to battery (or the process starts while on battery) so that
+         * the user can still resume synchronisation manually.
+         */
+        void applyPowerPolicy();
+
+        /** Pause the onedrive process because of the battery policy. */
+        void pauseForBattery();
+
+        /**
+         * Warn the user if the sync directory has too many directories for inotify to watch them all.
+         *
+         * Each directory needs a watch for onedrive's --monitor mode and another for the change latency tracker. Once
+         * the per-user limit is reached, onedrive silently stops noticing local changes in the remaining directories.
+         */
+        void checkInotifyWatchBudget();
+
+        /** Update the status description. */
+        void setStatus(const QString & status);
+
+        /** The synchronisation state as stored in the status page. */
+        [[nodiscard]] std::uint32_t statusPageState() const;
+
+        /** Update the file the client is working on. */
+        void setCurrentFile(const QString & fileName);
+
+        /** The current state, status and statistics, as laid out in the status page. */
+        [[nodiscard]] StatusPage::Status currentStatus() const;
+
+        /** Write the current state, status and statistics to the shared-memory status page. */
+        void publishStatusPage();
+
+        /**
+         * Save the current status and the recent events for the next session to show at startup.
+         *
+         * Does nothing if nothing has changed since the last save.
+         */
+        void saveSessionSnapshot();
+
+        /** Receiver for when the process moves to a new synchronisation phase. */
+        void onSynchronisationStateChanged(Process::SynchronisationState state);
+
+        /** Receiver for when the process has been paused. */
+        void onProcessPaused();
+
+        /** Receiver for when the process has been resumed after being paused. */
+        void onProcessResumed();
+
+        /** Receiver for when the tuner has picked a different check interval. */
+        void onMonitorLevelChanged(MonitorIntervalTuner::Level level);
+
+        /**
+         * Write the client's check intervals to its config file, restarting it to pick them up.
+         *
+         * @param monitorInterval The monitor_interval, or nullopt for the client's default.
+         * @param monitorFullscanFrequency The monitor_fullscan_frequency, or nullopt for the client's default.
+         */
+        void applyMonitorIntervals(const std::optional<int> & monitorInterval, const std::optional<int> & monitorFullscanFrequency);
+
+        /** Receiver for when the process indicates it has stopped running */
+        void onProcessStopped();
+
+        /** Receiver for when the supervisor has scheduled a restart of a process that exited unexpectedly. */
+        void onRestartScheduled(int attempt, int delay);
+
+        /** Receiver for when the supervisor has given up restarting the process. */
+        void onCrashLoopDetected(int exitCount);
+
+        /** Receiver for when the supervisor's watchdog has detected that the process appears to be hung. */
+        void onHangDetected(int idleSeconds);
+
+        /** The path to the onedrive client. */
+        QString m_oneDrivePath;
+
+        /** The args for the onedrive client. */
+        QStringList m_oneDriveArguments;
+
+        /** The local directory onedrive synchronises. */
+        QString m_syncDirectory;
+
+        /** The settings. */
+        Settings m_settings;
+
+        /** The onedrive process. */
+        Process m_process;
+
+        /** Restarts the onedrive process if it exits unexpectedly or hangs. */
+        ProcessSupervisor m_supervisor;
+
+        /** Samples the onedrive process's CPU, memory and I/O usage. */
+        ResourceMonitor m_resourceMonitor;
+
+        /** Measures how long local changes take to be uploaded. */
+        ChangeLatencyTracker m_latencyTracker;
+
+        /** Counts the files, directories and bytes in the local sync directory. */
+        SyncDirectoryScanner m_directoryScanner;
+
+        /** Whether the user has been warned that there are too many directories to watch. */
+        bool m_watchBudgetWarned;
+
+        /** Classifies and counts the errors the onedrive process reports. */
+        ErrorClassifier m_errorClassifier;
+
+        /** Measures the server's throttling of the onedrive process. */
+        ThrottleMonitor m_throttleMonitor;
+
+        /** Carries the client's events to the consumers that subscribe to them. */
+        EventBus m_eventBus;
+
+        /** The recent file events. */
+        EventHistory m_eventHistory;
+
+        /** Picks the client's check interval from how often things change. */
+        MonitorIntervalTuner m_monitorTuner;
+
+        /** Tracks whether the machine is on battery. */
+        PowerMonitor m_powerMonitor;
+
+        /** Whether the battery policy currently applies. */
+        bool m_batteryRestricted;
+
+        /** Whether the process's nice value has been raised because of the battery policy. */
+        bool m_niceRaisedForBattery;
+
+        /** Whether the process is paused because of the battery policy rather than by the user. */
+        bool m_pausedForBattery;
+
+        /** Resumes synchronisation at the end of a timed pause. */
+        QTimer m_resumeTimer;
+
+        /** Shows desktop notifications. */
+        Notifier m_notifier;
+
+        /** What the onedrive client is doing. */
+        QString m_status;
+
+        /** The file the client is working on. */
+        QString m_currentFile;
+
+        /** The last free space reported, or -1. */
+        qint64 m_freeSpace;
+
+        /** The number of files uploaded. */
+        quint64 m_uploadCount;
+
+        /** The number of files downloaded. */
+        quint64 m_downloadCount;
+
+        /** The number of items deleted. */
+        quint64 m_deleteCount;
+
+        /** Whether the client is being restarted on request, so that its stopping is reported as a restart. */
+        bool m_restartPending;
+
+        /** Whether the client is to be paused as soon as it starts. */
+        bool m_pausePending;
+
+        /** Whether the client is to be restarted as soon as it stops synchronising. */
+        bool m_restartWhenIdle;
+
+        /** Publishes the service on the session bus. Owned by the service. */
+        DBusAdaptor * m_dbusAdaptor;
+
+        /** Answers onedrive-tray-ctl. */
+        ControlServer m_controlServer;
+
+        /** Publishes the status for readers that poll it. */
+        StatusPagePublisher m_statusPage;
+
+        /** Keeps the status on disk between sessions. */
+        SessionSnapshot m_sessionSnapshot;
+
+        /** The status the previous session saved. */
+        std::optional<SessionSnapshot::Session> m_lastSession;
+
+        /** Saves the snapshot periodically, so that it's reasonably fresh even if the program doesn't exit cleanly. */
+        QTimer m_snapshotTimer;
+
+        /** Whether anything in the snapshot has changed since it was last saved. */
+        bool m_snapshotChanged;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_SYNCHRONISATIONSERVICE_H
@@ -0,0 +1,123 @@
+/**
+ * ThrottleMonitor.cpp
+ *
+ * Implementation of ThrottleMonitor class.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <QtCore/QLocale>
+#include "ThrottleMonitor.h"
+#include "Formatting.h"
+#include "Logger.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /** The minimum time between statisticsChanged() signals (ms). */
+    constexpr const int ChangeNotificationDelay = 1000;
+}
+
+
+ThrottleMonitor::ThrottleMonitor(const Process & process, QObject * parent)
+        : QObject(parent),
+          m_currentCycle(),
+          m_lastCycle(),
+          m_totals(),
+          m_changeTimer()
+{
+    m_changeTimer.setSingleShot(true);
+    m_changeTimer.setInterval(ChangeNotificationDelay);
+    connect(&m_changeTimer, &QTimer::timeout, this, &ThrottleMonitor::statisticsChanged);
+
+    connect(&process, &Process::throttled, this, &ThrottleMonitor::onThrottled);
+    connect(&process, &Process::backingOff, this, &ThrottleMonitor::onBackingOff);
+    connect(&process, &Process::retrying, this, &ThrottleMonitor::onRetrying);
+    connect(&process, &Process::synchronisationCycleCompleted, this, &ThrottleMonitor::onSynchronisationCycleCompleted);
+}
+
+
+ThrottleMonitor::~ThrottleMonitor() = default;
+
+
+double ThrottleMonitor::throughputLoss(const Statistics & cycle)
+{
+    if (0 >= cycle.duration) {
+        return 0.0;
+    }
+
+    // the client may be told to wait longer than the cycle then lasts, if it's stopped while waiting
+    return static_cast<double>(std::min(cycle.backoffTime, cycle.duration)) / static_cast<double>(cycle.duration);
+}
+
+
+QString ThrottleMonitor::summary() const
+{
+    if (m_totals.isEmpty()) {
+        return {};
+    }
+
+    const auto locale = QLocale::system();
+
+    auto summary = tr("Throttled by OneDrive: %1 responses, %2 retries, %3 spent waiting").arg(
+            locale.toString(m_totals.throttleCount),
+            locale.toString(m_totals.retryCount),
+            formatDuration(m_totals.backoffTime)
+    );
+
+    if (!m_lastCycle.isEmpty()) {
+        summary += tr(" (%1% of the last sync)").arg(std::lround(throughputLoss(m_lastCycle) * 100.0));
+    }
+
+    return summary;
+}
+
+
+void ThrottleMonitor::onThrottled()
+{
+    if (0 == m_totals.throttleCount) {
+        Logger::log(LogLevel::Warning, LogCategory::Process, QStringLiteral("the server is throttling the onedrive client"));
+    }
+
+    ++m_currentCycle.throttleCount;
+    ++m_totals.throttleCount;
+
+    if (!m_changeTimer.isActive()) {
+        m_changeTimer.start();
+    }
+}
+
+
+void ThrottleMonitor::onBackingOff(qint64 delay)
+{
+    m_currentCycle.backoffTime += delay;
+    m_totals.backoffTime += delay;
+
+    if (!m_changeTimer.isActive()) {
+        m_changeTimer.start();
+    }
+}
+
+
+void ThrottleMonitor::onRetrying()
+{
+    ++m_currentCycle.retryCount;
+    ++m_totals.retryCount;
+
+    if (!m_changeTimer.isActive()) {
+        m_changeTimer.start();
+    }
+}
+
+
+void ThrottleMonitor::onSynchronisationCycleCompleted(const Process::SynchronisationCycle & cycle)
+{
+    m_lastCycle = m_currentCycle;
+    m_lastCycle.duration = cycle.duration;
+    m_currentCycle = {};
+
+    if (!m_changeTimer.isActive()) {
+        m_changeTimer.start();
+    }
+}
@@ -0,0 +1,105 @@
+/**
+ * ThrottleMonitor.h
+ *
+ * Declaration of ThrottleMonitor class.
+ */
+
+#ifndef ONEDRIVETRAY_THROTTLEMONITOR_H
+#define ONEDRIVETRAY_THROTTLEMONITOR_H
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include "Process.h"
+
+namespace OneDrive
+{
+    /**
+     * Measures how much the server's throttling slows the onedrive client.
+     *
+     * The client reports the HTTP 429 and 503 responses it gets, the Retry-After delays it is told to wait for and the
+     * requests it retries. The monitor counts them for the current synchronisation cycle, the last completed cycle and
+     * in total, so that throttling by the server can be told apart from a slow client.
+     */
+    class ThrottleMonitor
+            : public QObject
+    {
+    Q_OBJECT
+
+    public:
+        struct Statistics
+        {
+            /** The number of HTTP 429 and 503 responses. */
+            quint64 throttleCount = 0;
+
+            /** The number of retried requests. */
+            quint64 retryCount = 0;
+
+            /** The time the server told the client to wait for (ms). */
+            qint64 backoffTime = 0;
+
+            /** The duration of the synchronisation cycle (ms). 0 for the current cycle and the totals. */
+            qint64 duration = 0;
+
+            [[nodiscard]] inline bool isEmpty() const
+            {
+                return 0 == throttleCount && 0 == retryCount && 0 == backoffTime;
+            }
+        };
+
+        explicit ThrottleMonitor(const Process & process, QObject * parent = nullptr);
+
+        ~ThrottleMonitor() override;
+
+        /** The throttling in the synchronisation cycle in progress, or since the last one if none is. */
+        [[nodiscard]] inline const Statistics & currentCycle() const
+        {
+            return m_currentCycle;
+        }
+
+        /** The throttling in the last completed synchronisation cycle. */
+        [[nodiscard]] inline const Statistics & lastCycle() const
+        {
+            return m_lastCycle;
+        }
+
+        /** The throttling since the monitor was created. */
+        [[nodiscard]] inline const Statistics & totals() const
+        {
+            return m_totals;
+        }
+
+        /**
+         * The share of a cycle's time spent waiting to retry, which is the share of its throughput lost to throttling.
+         *
+         * @return The loss, from 0 to 1. 0 if the cycle's duration is unknown.
+         */
+        [[nodiscard]] static double throughputLoss(const Statistics & cycle);
+
+        /**
+         * Summarise the throttling for display.
+         *
+         * @return The summary, or an empty string if the client has not been throttled.
+         */
+        [[nodiscard]] QString summary() const;
+
+    Q_SIGNALS:
+        /** Emitted (at most once a second) when the statistics change. */
+        void statisticsChanged();
+
+    private:
+        void onThrottled();
+        void onBackingOff(qint64 delay);
+        void onRetrying();
+        void onSynchronisationCycleCompleted(const Process::SynchronisationCycle & cycle);
+
+        Statistics m_currentCycle;
+        Statistics m_lastCycle;
+        Statistics m_totals;
+
+        /** Coalesces statisticsChanged() signals. */
+        QTimer m_changeTimer;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_THROTTLEMONITOR_H
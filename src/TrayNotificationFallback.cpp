@@ -0,0 +1,43 @@
+/**
+ * TrayNotificationFallback.cpp
+ *
+ * Implementation of TrayNotificationFallback class.
+ */
+
+#include <QtWidgets/QSystemTrayIcon>
+#include "TrayNotificationFallback.h"
+
+using namespace OneDrive;
+
+
+TrayNotificationFallback::TrayNotificationFallback(QSystemTrayIcon & trayIcon)
+        : m_trayIcon(trayIcon)
+{
+}
+
+
+TrayNotificationFallback::~TrayNotificationFallback() = default;
+
+
+bool TrayNotificationFallback::showMessage(const QString & summary, const QString & body, Notifier::Urgency urgency, int timeout)
+{
+    if (!m_trayIcon.isVisible() || !QSystemTrayIcon::supportsMessages()) {
+        return false;
+    }
+
+    QSystemTrayIcon::MessageIcon icon;
+
+    switch (urgency) {
+        case Notifier::Urgency::Low:
+        case Notifier::Urgency::Normal:
+            icon = QSystemTrayIcon::Information;
+            break;
+
+        case Notifier::Urgency::Critical:
+            icon = QSystemTrayIcon::Critical;
+            break;
+    }
+
+    m_trayIcon.showMessage(summary, body, icon, timeout);
+    return true;
+}
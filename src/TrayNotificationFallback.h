@@ -0,0 +1,42 @@
+/**
+ * TrayNotificationFallback.h
+ *
+ * Declaration of TrayNotificationFallback class.
+ */
+
+#ifndef ONEDRIVETRAY_TRAYNOTIFICATIONFALLBACK_H
+#define ONEDRIVETRAY_TRAYNOTIFICATIONFALLBACK_H
+
+#include "Notifier.h"
+
+QT_BEGIN_NAMESPACE
+class QSystemTrayIcon;
+QT_END_NAMESPACE
+
+namespace OneDrive
+{
+    /**
+     * Shows notifications as balloon messages on the tray icon when the notification service isn't available.
+     *
+     * This is the only part of the notifications that needs Qt Widgets, so that the service and the headless program
+     * don't.
+     */
+    class TrayNotificationFallback
+            : public Notifier::Fallback
+    {
+    public:
+        /**
+         * @param trayIcon The tray icon to show the messages on. It must outlive the fallback.
+         */
+        explicit TrayNotificationFallback(QSystemTrayIcon & trayIcon);
+
+        ~TrayNotificationFallback() override;
+
+        bool showMessage(const QString & summary, const QString & body, Notifier::Urgency urgency, int timeout) override;
+
+    private:
+        QSystemTrayIcon & m_trayIcon;
+    };
+} // OneDrive
+
+#endif //ONEDRIVETRAY_TRAYNOTIFICATIONFALLBACK_H
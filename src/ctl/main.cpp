@@ -0,0 +1,194 @@
+/**
+ * main.cpp
+ *
+ * onedrive-tray-ctl: query and control a running onedrive-tray over its control socket.
+ *
+ * This deliberately doesn't use Qt so that it starts in a few milliseconds and can be called from shell prompts and
+ * monitoring agents as often as they like.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../ControlProtocol.h"
+
+namespace
+{
+    namespace ControlProtocol = OneDrive::ControlProtocol;
+
+    void showUsage(std::ostream & out)
+    {
+        out << "Usage: onedrive-tray-ctl [--confdir DIR] COMMAND\n"
+               "\n"
+               "Options:\n"
+               "  --confdir DIR          talk to the instance for the onedrive config directory DIR\n"
+               "\n"
+               "Commands:\n"
+               "  status                 show the synchronisation state\n"
+               "  watch                  show events and status changes as they happen\n"
+               "  pause [SECONDS]        pause synchronisation, indefinitely or for SECONDS\n"
+               "  resume                 resume paused synchronisation\n"
+               "  history [--path PATH]  show the recent events, optionally only those for PATH\n"
+               "  stats                  show the transfer, error, latency and throttling statistics\n";
+    }
+
+    /** Build the command line to send from the arguments. Returns an empty string if they're invalid. */
+    std::string buildCommand(int argc, char ** argv)
+    {
+        const std::string command = argv[1];
+
+        if (ControlProtocol::StatusCommand == command || ControlProtocol::WatchCommand == command
+            || ControlProtocol::ResumeCommand == command || ControlProtocol::StatsCommand == command) {
+            return 2 == argc ? command : std::string();
+        }
+
+        if (ControlProtocol::PauseCommand == command) {
+            if (2 == argc) {
+                return command;
+            }
+
+            return 3 == argc ? command + ' ' + argv[2] : std::string();
+        }
+
+        if (ControlProtocol::HistoryCommand == command) {
+            if (2 == argc) {
+                return command;
+            }
+
+            if (4 == argc && 0 == std::strcmp(argv[2], "--path") && !std::strchr(argv[3], '\n')) {
+                return command + ' ' + argv[3];
+            }
+        }
+
+        return {};
+    }
+
+    int connectToServer(const std::string & instanceKey)
+    {
+        const auto path = ControlProtocol::socketPath(instanceKey);
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+
+        if (sizeof(address.sun_path) <= path.size()) {
+            std::cerr << "onedrive-tray-ctl: socket path too long: " << path << "\n";
+            return -1;
+        }
+
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        const auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if (0 > fd) {
+            std::cerr << "onedrive-tray-ctl: " << std::strerror(errno) << "\n";
+            return -1;
+        }
+
+        if (0 != ::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address))) {
+            std::cerr << "onedrive-tray-ctl: onedrive-tray is not running (" << std::strerror(errno) << ")\n";
+            ::close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    bool sendAll(int fd, const std::string & data)
+    {
+        std::size_t sent = 0;
+
+        while (sent < data.size()) {
+            const auto count = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+
+            if (0 > count) {
+                if (EINTR == errno) {
+                    continue;
+                }
+
+                return false;
+            }
+
+            sent += static_cast<std::size_t>(count);
+        }
+
+        return true;
+    }
+}
+
+
+int main(int argc, char ** argv)
+{
+    std::string instanceKey;
+
+    if (3 <= argc && 0 == std::strcmp(argv[1], "--confdir")) {
+        instanceKey = ControlProtocol::instanceKey(argv[2]);
+
+        // the command is parsed as if the option weren't there
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (2 > argc || 0 == std::strcmp(argv[1], "--help") || 0 == std::strcmp(argv[1], "-h")) {
+        showUsage(2 > argc ? std::cerr : std::cout);
+        return 2 > argc ? 2 : 0;
+    }
+
+    const auto command = buildCommand(argc, argv);
+
+    if (command.empty()) {
+        showUsage(std::cerr);
+        return 2;
+    }
+
+    const auto fd = connectToServer(instanceKey);
+
+    if (0 > fd) {
+        return 1;
+    }
+
+    if (!sendAll(fd, command + '\n')) {
+        std::cerr << "onedrive-tray-ctl: " << std::strerror(errno) << "\n";
+        ::close(fd);
+        return 1;
+    }
+
+    // output is passed through a line at a time so that "watch" is shown as it arrives
+    const std::string errorPrefix = std::string(ControlProtocol::ErrorResponse) + ' ';
+    std::string line;
+    char buffer[4096];
+    int exitCode = 1;
+
+    while (true) {
+        const auto count = ::read(fd, buffer, sizeof(buffer));
+
+        if (0 > count && EINTR == errno) {
+            continue;
+        }
+
+        if (0 >= count) {
+            break;
+        }
+
+        for (auto index = 0; index < count; ++index) {
+            if ('\n' != buffer[index]) {
+                line += buffer[index];
+                continue;
+            }
+
+            if (ControlProtocol::OkResponse == line) {
+                exitCode = 0;
+            } else if (0 == line.compare(0, errorPrefix.size(), errorPrefix)) {
+                std::cerr << "onedrive-tray-ctl: " << line.substr(errorPrefix.size()) << "\n";
+            } else {
+                std::cout << line << '\n' << std::flush;
+            }
+
+            line.clear();
+        }
+    }
+
+    ::close(fd);
+    return exitCode;
+}
@@ -0,0 +1,27 @@
+/**
+ * main.cpp
+ *
+ * onedrive-tray-headless: run the onedrive client under supervision without a system tray.
+ *
+ * This is the same as onedrive-tray --headless, but it doesn't link Qt Gui or Qt Widgets, so it can be installed and
+ * run on a machine that has no display libraries.
+ */
+
+#include <iostream>
+#include "../HeadlessApplication.h"
+#include "../Startup.h"
+
+using OneDrive::HeadlessApplication;
+
+int main(int argc, char * argv[])
+{
+    OneDrive::setApplicationDetails();
+
+    try {
+        HeadlessApplication app(argc, argv);
+        return app.exec();
+    } catch (std::exception & err) {
+        std::cerr << err.what() << "\n" << std::flush;
+        return 1;
+    }
+}
@@ -1,23 +1,33 @@
-#include <QApplication>
-#include <iostream>
-
-#include "Application.h"
-
-#ifdef QT_NO_SYSTEMTRAYICON
-#error QSystemTrayIcon is not supported on the target platform.
-#endif
-
-using OneDrive::Application;
-
-int main(int argc, char * argv[])
-{
-    Q_INIT_RESOURCE(systray);
-
-    try {
-        Application app(argc, argv);
-        return app.exec();
-    } catch (std::exception & err) {
-        std::cerr << err.what() << "\n" << std::flush;
-        return 1;
-    }
-}
+#include <QApplication>
+#include <iostream>
+
+#include "Application.h"
+#include "HeadlessApplication.h"
+#include "Startup.h"
+
+#ifdef QT_NO_SYSTEMTRAYICON
+#error QSystemTrayIcon is not supported on the target platform.
+#endif
+
+using OneDrive::Application;
+using OneDrive::HeadlessApplication;
+
+int main(int argc, char * argv[])
+{
+    OneDrive::setApplicationDetails();
+
+    try {
+        // the headless mode must not create a QApplication, which would connect to the display server
+        if (OneDrive::isHeadlessRequested(argc, argv)) {
+            HeadlessApplication app(argc, argv);
+            return app.exec();
+        }
+
+        Q_INIT_RESOURCE(systray);
+        Application app(argc, argv);
+        return app.exec();
+    } catch (std::exception & err) {
+        std::cerr << err.what() << "\n" << std::flush;
+        return 1;
+    }
+}
@@ -0,0 +1,149 @@
+/**
+ * OutputParserTimingTest.cpp
+ *
+ * Checks that the worst lines the onedrive client could write are framed and parsed in bounded time.
+ *
+ * For every rule of every grammar, lines of MaximumLineLength bytes are built that nearly match the rule's needle over
+ * and over, and that match it only at the very end. Each is parsed a few times and the slowest parse must be within
+ * MaximumParseTime. The framer is then fed output with no newlines, and output that is nothing but newlines.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <QtCore/QByteArray>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QVersionNumber>
+#include "../src/OutputGrammar.h"
+#include "../src/Process.h"
+
+using namespace OneDrive;
+
+namespace
+{
+    /**
+     * The longest a line may take to parse (ms).
+     *
+     * Parsing is linear in the length of the line, which takes well under a millisecond for the longest line on any
+     * machine the tray runs on. The limit is generous so that slow builders and sanitizer builds pass, while a parse
+     * that is quadratic in the length of the line takes seconds.
+     */
+    constexpr const qint64 MaximumParseTime = 50;
+
+    /** The longest framing the output may take, per MiB (ms). */
+    constexpr const qint64 MaximumFramingTime = 200;
+
+    /** How many times each line is parsed. The slowest is compared with the limit. */
+    constexpr const int Repetitions = 5;
+
+    /** Start a line with a prefix and repeat a pattern to fill it to MaximumLineLength bytes, ending with a suffix. */
+    QByteArray fill(const QByteArray & prefix, const QByteArray & pattern, const QByteArray & suffix = {})
+    {
+        const auto length = Process::MaximumLineLength - suffix.size();
+        auto line = prefix.left(length);
+        line.reserve(Process::MaximumLineLength);
+
+        while (line.size() < length) {
+            line.append(pattern.left(length - line.size()));
+        }
+
+        return line + suffix;
+    }
+
+    /**
+     * The worst lines for a rule.
+     *
+     * The needle without its last byte is repeated, with and without the needle at the end, so that the search finds
+     * a partial match at every step. Then the needle is followed by a long capture, in which a path capture has to find
+     * its separator and a number capture its digits.
+     */
+    QList<QByteArray> adversarialLines(const OutputGrammar::Rule & rule)
+    {
+        const auto nearMiss = (1 < rule.needle.size() ? rule.needle.left(rule.needle.size() - 1) : QByteArrayLiteral("x"));
+
+        return {
+                fill({}, nearMiss),
+                fill({}, nearMiss, rule.needle),
+                fill({}, nearMiss + ' '),
+                fill(rule.needle, QByteArrayLiteral(" to ")),
+                fill(rule.needle, QByteArrayLiteral(" ...")),
+                fill(rule.needle, QByteArrayLiteral("9")),
+                fill(rule.needle, QByteArrayLiteral("\xe2\x80")),
+        };
+    }
+
+    qint64 slowestParse(const OutputGrammar & grammar, const QByteArray & line)
+    {
+        qint64 slowest = 0;
+        QElapsedTimer timer;
+
+        for (auto repetition = 0; repetition < Repetitions; ++repetition) {
+            timer.start();
+            static_cast<void>(grammar.parse(line));
+            slowest = std::max(slowest, timer.elapsed());
+        }
+
+        return slowest;
+    }
+
+    bool checkGrammar(const OutputGrammar & grammar)
+    {
+        auto passed = true;
+        const auto rules = grammar.rules();
+
+        for (std::size_t index = 0; index < rules.size(); ++index) {
+            for (const auto & line : adversarialLines(rules[index])) {
+                const auto time = slowestParse(grammar, line);
+
+                if (MaximumParseTime < time) {
+                    std::cerr << "grammar " << grammar.name().toStdString() << ", rule " << index << " (\"" << rules[index].needle.constData() << "\"): parsing took " << time << "ms, more than " << MaximumParseTime << "ms\n";
+                    passed = false;
+                }
+            }
+        }
+
+        return passed;
+    }
+
+    /** Feed the framer a MiB of output in 4 KiB reads. */
+    bool checkFraming(const char * description, char byte)
+    {
+        constexpr const int ReadSize = 4096;
+        constexpr const int OutputSize = 1024 * 1024;
+        const QByteArray read(ReadSize, byte);
+        QByteArray buffer;
+        bool discarding = false;
+        QElapsedTimer timer;
+        timer.start();
+
+        for (auto total = 0; total < OutputSize; total += ReadSize) {
+            buffer.append(read);
+            static_cast<void>(Process::takeLines(buffer, discarding));
+
+            if (Process::MaximumLineLength < buffer.size()) {
+                std::cerr << "framing " << description << ": " << buffer.size() << " bytes buffered, more than " << Process::MaximumLineLength << "\n";
+                return false;
+            }
+        }
+
+        const auto time = timer.elapsed();
+
+        if (MaximumFramingTime < time) {
+            std::cerr << "framing " << description << " took " << time << "ms, more than " << MaximumFramingTime << "ms\n";
+            return false;
+        }
+
+        return true;
+    }
+}
+
+
+int main()
+{
+    auto passed = checkGrammar(OutputGrammar::forVersion({}));
+    passed = checkGrammar(OutputGrammar::forVersion(QVersionNumber(2, 5))) && passed;
+    passed = checkFraming("output with no newlines", 'x') && passed;
+    passed = checkFraming("output of empty lines", '\n') && passed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}